@@ -0,0 +1,34 @@
+// (c) Sam Donow 2018
+#include "bench/Benchmark.h"
+#include "bench/BigIntBench.h"
+#include "bench/ParserBench.h"
+#include "bench/RationalBench.h"
+
+#include <unistd.h>
+int main(int argc, char **argv) {
+    int opt;
+    auto it = BenchmarkSuite::benchmarks->end();
+    while ((opt = getopt(argc, argv, "lb:")) != -1) {
+        switch (opt) {
+            case 'b':
+                it = BenchmarkSuite::benchmarks->find(optarg);
+                if (it == BenchmarkSuite::benchmarks->end()) {
+                    std::cout << "No benchmark named " << optarg << "\n";
+                    return 1;
+                }
+                break;
+            case 'l':
+                for (const auto& entry : *BenchmarkSuite::benchmarks) {
+                    std::cout << entry.first << "\n";
+                }
+                return 0;
+        }
+    }
+    if (it == BenchmarkSuite::benchmarks->end()) {
+        for (const auto& entry : *BenchmarkSuite::benchmarks) {
+            entry.second();
+        }
+    } else {
+        it->second();
+    }
+}
@@ -0,0 +1,46 @@
+// (c) 2018 Sam Donow
+#pragma once
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+
+// Lightweight benchmark runners, registered in the same way as the Testers in
+// test/TestSuite.h
+struct BenchmarkSuite {
+    static inline std::optional<std::unordered_map<std::string, std::function<void(void)>>> benchmarks;
+};
+
+template<typename T>
+struct Benchmark : BenchmarkSuite {
+    __attribute__((constructor)) static void initialize() {
+        static bool once = false;
+        if (once) { return; }
+        if (benchmarks == std::nullopt) { benchmarks.emplace(); }
+        once = true;
+        benchmarks->emplace(typeid(T).name(), []() {
+            T benchmark;
+            benchmark.run();
+        });
+    }
+
+  protected:
+    /// The average time in seconds of a call to func, repeated for at least
+    /// minTime seconds
+    template<typename Func>
+    static double timeOf(Func&& func, double minTime = 0.05) {
+        using Clock = std::chrono::steady_clock;
+        size_t iterations = 0;
+        const Clock::time_point start = Clock::now();
+        double elapsed = 0;
+        do {
+            func();
+            ++iterations;
+            elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        } while (elapsed < minTime);
+        return elapsed / static_cast<double>(iterations);
+    }
+};
@@ -0,0 +1,160 @@
+// (c) Sam Donow 2018
+#pragma once
+#include "bench/Benchmark.h"
+#include "data/BigInt.h"
+
+#include <iomanip>
+#include <limits>
+#include <optional>
+#include <random>
+#include <utility>
+
+/// Times multiplication of n-digit BigInts with each algorithm, to find the
+/// crossovers used for BigInt::defaultKaratsubaThreshold and
+/// BigInt::defaultToom3Threshold. Each of Karatsuba and Toom-3 is timed with a
+/// single level of splitting above the algorithm below it, so the crossover is
+/// the size from which one split pays for itself
+struct BigIntMulBench : Benchmark<BigIntMulBench> {
+    std::mt19937 rng{12345};
+
+    BigInt randomBigInt(size_t digits) {
+        const BigInt base{uint64_t{1} << 32};
+        BigInt ret{static_cast<uint32_t>(rng() | 1)};
+        for (size_t i = 1; i < digits; ++i) {
+            ret = ret * base + BigInt{static_cast<uint32_t>(rng())};
+        }
+        return ret;
+    }
+
+    void run() {
+        initialize();
+        constexpr size_t never = std::numeric_limits<size_t>::max();
+        const size_t sizes[] = {8, 16, 24, 32, 40, 48, 64, 96, 128, 160, 192,
+                                256, 384, 512, 768, 1024, 2048, 4096};
+        std::optional<size_t> karatsubaCrossover;
+        std::optional<size_t> toom3Crossover;
+        std::cout << "BigInt multiplication, microseconds per product\n"
+                  << std::setw(8) << "digits" << std::setw(14) << "schoolbook"
+                  << std::setw(14) << "karatsuba" << std::setw(16) << "karatsuba-all"
+                  << std::setw(14) << "toom-3" << "\n";
+        for (size_t n : sizes) {
+            const BigInt a = randomBigInt(n);
+            const BigInt b = randomBigInt(n);
+            BigInt result;
+            auto multiply = [&] { result = a * b; };
+
+            BigInt::setMulThresholds(never, never);
+            const double schoolbook = timeOf(multiply);
+            const BigInt expected = result;
+            BigInt::setMulThresholds(n, never);
+            const double karatsuba = timeOf(multiply);
+            const bool karatsubaOk = result == expected;
+            BigInt::setMulThresholds(BigInt::defaultKaratsubaThreshold, n);
+            const double toom3 = timeOf(multiply);
+            const bool toom3Ok = result == expected;
+            BigInt::setMulThresholds(BigInt::defaultKaratsubaThreshold, never);
+            const double karatsubaBelow = timeOf(multiply);
+
+            if (!karatsubaCrossover && karatsuba < schoolbook) {
+                karatsubaCrossover = n;
+            }
+            if (!toom3Crossover && toom3 < karatsubaBelow) {
+                toom3Crossover = n;
+            }
+            std::cout << std::setw(8) << n << std::fixed << std::setprecision(2)
+                      << std::setw(14) << schoolbook * 1e6 << std::setw(14) << karatsuba * 1e6
+                      << std::setw(16) << karatsubaBelow * 1e6 << std::setw(14) << toom3 * 1e6
+                      << (karatsubaOk && toom3Ok ? "" : "  MISMATCH") << "\n";
+        }
+        BigInt::setMulThresholds(BigInt::defaultKaratsubaThreshold, BigInt::defaultToom3Threshold);
+        std::cout << "karatsuba beats schoolbook from " << karatsubaCrossover.value_or(0)
+                  << " digits (default " << BigInt::defaultKaratsubaThreshold << ")\n"
+                  << "toom-3 beats karatsuba from " << toom3Crossover.value_or(0)
+                  << " digits (default " << BigInt::defaultToom3Threshold << ")\n";
+    }
+};
+
+/// Times conversion of n-digit decimal strings to BigInts and back, which
+/// divides and conquers with the cached powers of 10^9 from
+/// decimalThreshold digits (of 32 bits) up
+struct BigIntDecimalBench : Benchmark<BigIntDecimalBench> {
+    void run() {
+        initialize();
+        std::mt19937 rng{12345};
+        const size_t sizes[] = {100, 300, 1000, 3000, 10000, 30000, 100000, 300000, 1000000};
+        std::cout << "BigInt decimal conversion, milliseconds per conversion\n"
+                  << std::setw(10) << "decimals" << std::setw(14) << "fromString"
+                  << std::setw(14) << "toString" << "\n";
+        for (size_t n : sizes) {
+            std::string digits(n, '0');
+            digits[0] = '1';
+            for (size_t i = 1; i < n; ++i) {
+                digits[i] = static_cast<char>('0' + rng() % 10);
+            }
+            BigInt value;
+            std::string text;
+            const double parse = timeOf([&] { value = BigInt::fromString(digits); });
+            const double print = timeOf([&] { text = value.toString(); });
+            std::cout << std::setw(10) << n << std::fixed << std::setprecision(3)
+                      << std::setw(14) << parse * 1e3 << std::setw(14) << print * 1e3
+                      << (text == digits ? "" : "  MISMATCH") << "\n";
+        }
+    }
+};
+
+/// Times the kernels at the bottom of BigInt arithmetic with each supported
+/// implementation (see BigInt::Kernels): nanoseconds per digit of an addition
+/// and subtraction, and per digit squared of a schoolbook product
+struct BigIntKernelBench : Benchmark<BigIntKernelBench> {
+    std::mt19937 rng{12345};
+
+    BigInt randomBigInt(size_t digits) {
+        const BigInt base{uint64_t{1} << 32};
+        BigInt ret{static_cast<uint32_t>(rng() | 1)};
+        for (size_t i = 1; i < digits; ++i) {
+            ret = ret * base + BigInt{static_cast<uint32_t>(rng())};
+        }
+        return ret;
+    }
+
+    void run() {
+        initialize();
+        constexpr size_t never = std::numeric_limits<size_t>::max();
+        const std::pair<BigInt::Kernels, const char*> kinds[] = {
+            {BigInt::Kernels::Digit32, "digit32"},
+            {BigInt::Kernels::Word64, "word64"},
+            {BigInt::Kernels::Adx, "adx"}};
+        const BigInt::Kernels defaultKernels = BigInt::activeKernels();
+        const size_t sizes[] = {4, 16, 64, 256, 1024, 4096};
+        BigInt::setMulThresholds(never, never);
+        std::cout << "BigInt kernels, nanoseconds per digit (add and subtract) and per\n"
+                  << "digit squared (schoolbook multiply)\n"
+                  << std::setw(8) << "digits" << std::setw(10) << "kernels"
+                  << std::setw(12) << "add+sub" << std::setw(12) << "multiply" << "\n";
+        for (size_t n : sizes) {
+            const BigInt a = randomBigInt(n);
+            const BigInt b = randomBigInt(n);
+            std::optional<BigInt> expected;
+            for (const auto& [kind, name] : kinds) {
+                if (!BigInt::setKernels(kind)) {
+                    continue;
+                }
+                BigInt acc = a;
+                const double addSub = timeOf([&] {
+                    acc += b;
+                    acc -= b;
+                });
+                BigInt product;
+                const double multiply = timeOf([&] { product = a * b; });
+                const bool ok = acc == a && (!expected || product == *expected);
+                expected = product;
+                std::cout << std::setw(8) << n << std::setw(10) << name << std::fixed
+                          << std::setprecision(3) << std::setw(12) << addSub * 1e9 / (2 * n)
+                          << std::setw(12) << multiply * 1e9 / (n * n)
+                          << (ok ? "" : "  MISMATCH") << "\n";
+            }
+        }
+        BigInt::setKernels(defaultKernels);
+        BigInt::setMulThresholds(BigInt::defaultKaratsubaThreshold, BigInt::defaultToom3Threshold);
+    }
+};
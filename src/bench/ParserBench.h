@@ -0,0 +1,126 @@
+// (c) Sam Donow 2018
+#pragma once
+#include "bench/Benchmark.h"
+#include "core/Lexer.h"
+#include "core/Parser.h"
+#include "core/StreamParser.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// Times lexing and parsing generated data files of a few sizes. Parsing
+/// tokens already lexed is close to flat in the size, as is the stream parser,
+/// fed pieces as load reads files. Lexing a whole file into one token vector
+/// (about six times the size of the text) is not: it slows as the vector
+/// outgrows the caches, and lex+parse with it
+struct ParserBench : Benchmark<ParserBench> {
+    static std::string dataFile(size_t bytes) {
+        std::string text;
+        text.reserve(bytes + 64);
+        for (size_t i = 0; text.size() < bytes; ++i) {
+            text += "(record " + std::to_string(i) + " \"name-" + std::to_string(i) +
+                    "\" (tags alpha beta) '(1.5 " + std::to_string(i % 97) + "/7))\n";
+        }
+        return text;
+    }
+
+    // The best of a few timings, as the large files are only run once each
+    template<typename Func>
+    static double bestTimeOf(Func&& func) {
+        double best = timeOf(func);
+        for (int i = 0; i < 2; ++i) {
+            best = std::min(best, timeOf(func));
+        }
+        return best;
+    }
+
+    void run() {
+        initialize();
+        std::cout << "Lexing and parsing, MB/s\n"
+                  << std::setw(8) << "MB" << std::setw(12) << "lex" << std::setw(12) << "parse"
+                  << std::setw(12) << "lex+parse" << std::setw(12) << "stream" << "\n";
+        for (size_t mb : {1, 4, 16}) {
+            const std::string text = dataFile(mb << 20);
+            Lexer lex;
+            const double lexTime = bestTimeOf([&] { lex.getTokens(text); });
+            const std::vector<Token> allTokens = lex.getTokens(text);
+            const double parseTime = bestTimeOf([&] {
+                Parser parser;
+                size_t pos = 0;
+                while (parser.parse(allTokens, pos)) {
+                }
+            });
+            const double bothTime = bestTimeOf([&] {
+                Parser parser;
+                const std::vector<Token> tokens = lex.getTokens(text);
+                size_t pos = 0;
+                while (parser.parse(tokens, pos)) {
+                }
+            });
+            const double streamTime = bestTimeOf([&] {
+                StreamParser parser;
+                const std::string_view input = text;
+                for (size_t i = 0; i < input.size(); i += 1 << 16) {
+                    parser.feed(input.substr(i, 1 << 16));
+                    while (parser.next()) {
+                    }
+                }
+                parser.finish();
+            });
+            const double size = static_cast<double>(text.size()) / (1 << 20);
+            std::cout << std::setw(8) << mb << std::fixed << std::setprecision(1)
+                      << std::setw(12) << size / lexTime << std::setw(12) << size / parseTime
+                      << std::setw(12) << size / bothTime << std::setw(12) << size / streamTime
+                      << "\n";
+        }
+    }
+};
+
+/// Times lexing a large generated program with each supported scanner (see
+/// Lexer::Scanner), in MB/s
+struct LexerBench : Benchmark<LexerBench> {
+    static std::string sourceFile(size_t bytes) {
+        std::string text;
+        text.reserve(bytes + 256);
+        for (size_t i = 0; text.size() < bytes; ++i) {
+            const std::string n = std::to_string(i);
+            text += "(define (compute-the-running-total-of-item-" + n + " accumulated-value)\n"
+                    "        (string-append \"a fairly long string literal, as in messages \\\"" +
+                    n + "\\\"\"\n"
+                    "                       (number->string (+ accumulated-value " + n + "))))\n\n";
+        }
+        return text;
+    }
+
+    void run() {
+        initialize();
+        const std::pair<Lexer::Scanner, const char*> kinds[] = {
+            {Lexer::Scanner::Scalar, "scalar"},
+            {Lexer::Scanner::Sse2, "sse2"},
+            {Lexer::Scanner::Avx2, "avx2"}};
+        const Lexer::Scanner defaultScanner = Lexer::activeScanner();
+        const std::string text = sourceFile(16 << 20);
+        const double size = static_cast<double>(text.size()) / (1 << 20);
+        std::cout << "Lexing a " << std::fixed << std::setprecision(1) << size
+                  << " MB program, MB/s\n"
+                  << std::setw(10) << "scanner" << std::setw(12) << "MB/s" << "\n";
+        std::optional<size_t> expectedTokens;
+        for (const auto& [kind, name] : kinds) {
+            if (!Lexer::setScanner(kind)) {
+                continue;
+            }
+            Lexer lex;
+            size_t tokens = 0;
+            const double time = timeOf([&] { tokens = lex.getTokens(text).size(); });
+            const bool ok = !expectedTokens || tokens == *expectedTokens;
+            expectedTokens = tokens;
+            std::cout << std::setw(10) << name << std::setw(12) << size / time
+                      << (ok ? "" : "  MISMATCH") << "\n";
+        }
+        Lexer::setScanner(defaultScanner);
+    }
+};
@@ -0,0 +1,68 @@
+// (c) Sam Donow 2018
+#pragma once
+#include "bench/Benchmark.h"
+#include "data/BigInt.h"
+#include "data/Rational.h"
+
+#include <iomanip>
+#include <utility>
+
+/// Times exact sums of the harmonic series, reducing each partial sum eagerly
+/// and with reduction deferred up to a few sizes of denominator, and times the
+/// gcd of consecutive Fibonacci numbers against Euclid's algorithm
+struct RationalBench : Benchmark<RationalBench> {
+    using BR = Rational<BigInt>;
+
+    static BR harmonic(size_t n) {
+        BR sum{};
+        for (size_t k = 1; k <= n; ++k) {
+            sum += BR{BigInt{1u}, BigInt{static_cast<uint32_t>(k)}};
+        }
+        return sum;
+    }
+
+    static BigInt euclid(BigInt a, BigInt b) {
+        while (b != BigInt{0}) {
+            a = std::exchange(b, a % b);
+        }
+        return a;
+    }
+
+    void run() {
+        initialize();
+        const size_t limits[] = {0, 4, 16, 64};
+        std::cout << "Harmonic numbers, milliseconds per sum\n" << std::setw(8) << "terms";
+        for (size_t limit : limits) {
+            std::cout << std::setw(12) << ("lazy " + std::to_string(limit));
+        }
+        std::cout << "\n";
+        for (size_t n : {100, 300, 1000, 3000}) {
+            std::cout << std::setw(8) << n << std::fixed << std::setprecision(2);
+            for (size_t limit : limits) {
+                BR::setLazyLimit(limit);
+                BR result;
+                std::cout << std::setw(12) << timeOf([&] { result = harmonic(n); }) * 1e3;
+                // Observe the result, so that its reduction is timed too
+                static_cast<void>(result.denominator());
+            }
+            std::cout << "\n";
+        }
+        BR::setLazyLimit(0);
+
+        std::cout << "GCD of Fibonacci numbers, microseconds\n"
+                  << std::setw(8) << "digits" << std::setw(12) << "euclid"
+                  << std::setw(12) << "lehmer" << "\n";
+        BigInt fib{1u};
+        BigInt fibNext{1u};
+        for (size_t i = 1; i <= 8000; ++i) {
+            fib = std::exchange(fibNext, fib + fibNext);
+            if (i % 2000 == 0) {
+                BigInt result;
+                const double slow = timeOf([&] { result = euclid(fibNext, fib); });
+                const double fast = timeOf([&] { result = BigInt::gcd(fibNext, fib); });
+                std::cout << std::setw(8) << fibNext.digitCount() << std::setw(12) << slow * 1e6
+                          << std::setw(12) << fast * 1e6 << "\n";
+            }
+        }
+    }
+};
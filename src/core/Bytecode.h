@@ -0,0 +1,103 @@
+// (c) 2018 Sam Donow
+#pragma once
+#include "data/Data.h"
+#include "util/Enum.h"
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Instruction set of the VM. Unless noted otherwise, the operand arg is an index
+// into one of the tables of the enclosing CodeObject. Variables of the function
+// being run live either on the stack, or when they may be captured by a closure,
+// in a frame on the heap; variables of enclosing functions are addressed by
+// the number of frames to go up from the defining scope, and a slot
+//  Const:            push constants[arg]
+//  LoadLocal:        push the value of variable number arg, from the stack
+//  LoadEnv:          push the value of variable number arg, from the heap frame
+//  LoadFree:         push the value of variable number arg of the frame arg2
+//                    levels above the defining scope
+//  LoadGlobal:       push the value of names[arg], looked up by name in the
+//                    defining scope
+//  StoreLocal:       pop the top of the stack into variable number arg, on the stack
+//  StoreEnv:         pop the top of the stack into variable number arg, in the heap frame
+//  DefineFunction:   store a new function built from lambdas[arg2] into variable
+//                    number arg of the heap frame
+//  Pop:              discard the top of the stack
+//  Jump:             continue at instruction arg
+//  JumpIfFalse:      pop the top of the stack, and jump to arg if it is false
+//  JumpIfTrue:       pop the top of the stack, and jump to arg if it is true
+//  JumpIfFalseOrPop: if the top of the stack is false, jump to arg, otherwise pop
+//  JumpIfTrueOrPop:  if the top of the stack is true, jump to arg, otherwise pop
+//  MatchConst:       push whether the top of the stack is equal to constants[arg]
+//  MakeClosure:      push a new function built from lambdas[arg]
+//  Call:             call the function below the top arg values with those values
+//  TailCall:         as Call, but replacing the current frame
+//  Return:           return the top of the stack to the caller
+ENUM(OpCode, uint8_t, Const, LoadLocal, LoadEnv, LoadFree, LoadGlobal, StoreLocal,
+     StoreEnv, DefineFunction, Pop, Jump, JumpIfFalse, JumpIfTrue, JumpIfFalseOrPop,
+     JumpIfTrueOrPop, MatchConst, MakeClosure, Call, TailCall, Return)
+
+struct Instruction {
+    OpCode op;
+    uint16_t arg2;
+    uint32_t arg;
+
+    Instruction(OpCode o, uint32_t a, uint16_t a2 = 0) : op(o), arg2(a2), arg(a) {}
+};
+
+struct CodeObject;
+
+// The information needed to create a closure for a lambda expression nested
+// inside a compiled function; the body is compiled along with its parent
+struct LambdaTemplate {
+    std::vector<Symbol> formals;
+    Datum definition;
+    // null if the body could not be compiled
+    std::shared_ptr<const CodeObject> code;
+};
+
+/// The compiled form of the definition of a LispFunction
+struct CodeObject {
+    std::vector<Instruction> instructions{};
+    std::vector<Datum> constants{};
+    std::vector<Symbol> names{};
+    std::vector<LambdaTemplate> lambdas{};
+    // The variables of the function: its parameters followed by any internal
+    // definitions, in slot order
+    std::shared_ptr<const std::vector<Symbol>> locals{};
+    // Whether the variables live in a frame on the heap rather than the stack,
+    // as they may be captured by closures
+    bool needsEnv = false;
+
+    // Bindings of names[i], filled in by the VM on first use. Only bindings in
+    // the global scope are cached: a define there assigns to the existing
+    // binding, and bindings are never removed
+    mutable std::vector<SymbolTable::value_type*> globalCache{};
+
+    friend std::ostream& operator<<(std::ostream& os, const CodeObject& code) {
+        for (size_t i = 0; i < code.instructions.size(); ++i) {
+            const Instruction& ins = code.instructions[i];
+            os << i << ": " << ins.op << " " << ins.arg;
+            switch (ins.op) {
+            case OpCode::Const:
+            case OpCode::MatchConst:
+                os << " (" << code.constants[ins.arg] << ")";
+                break;
+            case OpCode::LoadFree:
+            case OpCode::DefineFunction:
+                os << " " << ins.arg2;
+                break;
+            case OpCode::LoadGlobal:
+                os << " (" << code.names[ins.arg] << ")";
+                break;
+            default:
+                break;
+            }
+            os << "\n";
+        }
+        return os;
+    }
+};
@@ -0,0 +1,392 @@
+// (c) 2018 Sam Donow
+#include "Compiler.h"
+#include "library/SpecialForms.h"
+
+#include <algorithm>
+
+std::shared_ptr<const CodeObject>
+Compiler::compileImpl(const std::vector<Symbol>& formals, const Datum& definition,
+                      SymbolTable& scope, const Compiler* parent) {
+    auto code = std::make_shared<CodeObject>();
+    Compiler compiler{formals, scope, parent, *code};
+    try {
+        compiler.declareDefinitions(definition);
+        compiler.compileExpr(definition, true);
+    } catch (const Unsupported&) {
+        return nullptr;
+    } catch (const LispError&) {
+        // Malformed code; let the evaluator report the error if it is ever run
+        return nullptr;
+    }
+    if (!code->lambdas.empty()) {
+        // The closures refer to this frame, so it must be on the heap
+        code->needsEnv = true;
+        for (Instruction& ins : code->instructions) {
+            if (ins.op == OpCode::LoadLocal) {
+                ins.op = OpCode::LoadEnv;
+            } else if (ins.op == OpCode::StoreLocal) {
+                ins.op = OpCode::StoreEnv;
+            }
+        }
+    }
+    code->locals = std::make_shared<const std::vector<Symbol>>(std::move(compiler.locals));
+    code->globalCache.resize(code->names.size());
+    return code;
+}
+
+size_t Compiler::emit(OpCode op, uint32_t arg) {
+    out.instructions.emplace_back(op, arg);
+    return out.instructions.size() - 1;
+}
+
+void Compiler::patch(size_t jumpPos) {
+    out.instructions[jumpPos].arg = static_cast<uint32_t>(out.instructions.size());
+}
+
+uint32_t Compiler::addConstant(const Datum& datum) {
+    out.constants.push_back(datum);
+    return static_cast<uint32_t>(out.constants.size() - 1);
+}
+
+uint32_t Compiler::addName(Symbol name) {
+    auto it = std::find(out.names.begin(), out.names.end(), name);
+    if (it == out.names.end()) {
+        out.names.push_back(name);
+        return static_cast<uint32_t>(out.names.size() - 1);
+    }
+    return static_cast<uint32_t>(it - out.names.begin());
+}
+
+std::optional<size_t> Compiler::localSlot(Symbol name) const {
+    // Search from the back so that the last of any duplicate parameters wins,
+    // as it would when binding them into a SymbolTable
+    for (size_t i = locals.size(); i > 0; --i) {
+        if (locals[i - 1] == name) {
+            return i - 1;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<std::pair<size_t, size_t>>
+Compiler::lexicalAddress(Symbol name) const {
+    size_t depth = 0;
+    for (const Compiler* comp = this; comp != nullptr; comp = comp->parent, ++depth) {
+        if (std::optional<size_t> slot = comp->localSlot(name)) {
+            return std::make_pair(depth, *slot);
+        }
+    }
+    return std::nullopt;
+}
+
+const std::string* Compiler::specialForm(const SExpr& expr) const {
+    std::optional<Symbol> sym = expr.car.getAtomicValue<Symbol>();
+    if (!sym || lexicalAddress(*sym)) {
+        return nullptr;
+    }
+    SymbolTable::value_type* binding = scope.find(*sym);
+    if (binding == nullptr || !std::holds_alternative<SpecialForm>(*binding)) {
+        return nullptr;
+    }
+    return &+*sym;
+}
+
+void Compiler::declareDefinitions(const Datum& body) {
+    if (body.isAtomic() || body.getSExpr() == nullptr) {
+        return;
+    }
+    const SExpr& expr = *body.getSExpr();
+    const std::string* form = specialForm(expr);
+    if (form == nullptr) {
+        return;
+    }
+    LispArgs args{expr.cdr.getSExpr()};
+    if (*form == "begin") {
+        for (const Datum& datum : args) {
+            declareDefinitions(datum);
+        }
+    } else if (*form == "define" && !args.empty()) {
+        const Datum& target = *args.begin();
+        std::optional<Symbol> name;
+        if (target.isAtomic()) {
+            name = target.getAtomicValue<Symbol>();
+        } else if (target.getSExpr() != nullptr) {
+            name = target.getSExpr()->car.getAtomicValue<Symbol>();
+        }
+        if (name && !localSlot(*name)) {
+            locals.push_back(std::move(*name));
+        }
+    }
+}
+
+void Compiler::compileExpr(const Datum& expr, bool tail) {
+    if (expr.isAtomic()) {
+        if (std::optional<Symbol> sym = expr.getAtomicValue<Symbol>()) {
+            compileSymbol(*sym, tail);
+            return;
+        }
+        emit(OpCode::Const, addConstant(expr));
+    } else if (const SExpr* sexpr = expr.getSExpr(); sexpr == nullptr) {
+        emit(OpCode::Const, addConstant(expr));
+    } else {
+        compileCall(*sexpr, tail);
+        return;
+    }
+    if (tail) {
+        emit(OpCode::Return);
+    }
+}
+
+void Compiler::compileSymbol(const Symbol& sym, bool tail) {
+    if (auto address = lexicalAddress(sym); !address) {
+        emit(OpCode::LoadGlobal, addName(sym));
+    } else if (address->first == 0) {
+        emit(OpCode::LoadLocal, static_cast<uint32_t>(address->second));
+    } else {
+        out.instructions.emplace_back(OpCode::LoadFree, static_cast<uint32_t>(address->second),
+                                      static_cast<uint16_t>(address->first - 1));
+    }
+    if (tail) {
+        emit(OpCode::Return);
+    }
+}
+
+void Compiler::compileCall(const SExpr& expr, bool tail) {
+    LispArgs args{expr.cdr.getSExpr()};
+    if (const std::string* form = specialForm(expr)) {
+        const std::string& name = *form;
+        if (name == "quote") {
+            compileQuote(std::move(args), tail);
+        } else if (name == "if") {
+            compileIf(std::move(args), tail);
+        } else if (name == "lambda") {
+            compileLambda(std::move(args), tail);
+        } else if (name == "define") {
+            compileDefine(std::move(args), tail);
+        } else if (name == "begin") {
+            compileBody(std::move(args), tail);
+        } else if (name == "and" || name == "or") {
+            compileAndOr(std::move(args), tail, name == "and");
+        } else if (name == "cond") {
+            compileCond(std::move(args), tail);
+        } else if (name == "case") {
+            compileCase(std::move(args), tail);
+        } else {
+            throw Unsupported{};
+        }
+        return;
+    }
+
+    compileExpr(expr.car, false);
+    uint32_t argc = 0;
+    for (const Datum& arg : args) {
+        compileExpr(arg, false);
+        ++argc;
+    }
+    emit(tail ? OpCode::TailCall : OpCode::Call, argc);
+}
+
+void Compiler::compileBody(LispArgs body, bool tail) {
+    if (body.empty()) {
+        emit(OpCode::Const, addConstant(Datum{}));
+        if (tail) {
+            emit(OpCode::Return);
+        }
+        return;
+    }
+    for (auto it = body.begin(); it != body.end();) {
+        const Datum& expr = *it;
+        if (++it == body.end()) {
+            compileExpr(expr, tail);
+        } else {
+            compileExpr(expr, false);
+            emit(OpCode::Pop);
+        }
+    }
+}
+
+void Compiler::compileQuote(LispArgs args, bool tail) {
+    if (args.size() != 1) {
+        throw Unsupported{};
+    }
+    emit(OpCode::Const, addConstant(*args.begin()));
+    if (tail) {
+        emit(OpCode::Return);
+    }
+}
+
+void Compiler::compileIf(LispArgs args, bool tail) {
+    if (args.size() != 3) {
+        throw Unsupported{};
+    }
+    auto it = args.begin();
+    compileExpr(*it++, false);
+    const size_t elseJump = emit(OpCode::JumpIfFalse);
+    compileExpr(*it++, tail);
+    size_t endJump = 0;
+    if (!tail) {
+        endJump = emit(OpCode::Jump);
+    }
+    patch(elseJump);
+    compileExpr(*it, tail);
+    if (!tail) {
+        patch(endJump);
+    }
+}
+
+void Compiler::emitClosure(std::vector<Symbol> formals, const Datum& definition) {
+    LambdaTemplate tmpl{std::move(formals), definition, nullptr};
+    tmpl.code = compileImpl(tmpl.formals, tmpl.definition, scope, this);
+    out.lambdas.push_back(std::move(tmpl));
+}
+
+void Compiler::compileLambda(LispArgs args, bool tail) {
+    auto [formals, defn] = SpecialForms::parseFuncDefn(std::move(args));
+    emitClosure(std::move(formals), defn);
+    emit(OpCode::MakeClosure, static_cast<uint32_t>(out.lambdas.size() - 1));
+    if (tail) {
+        emit(OpCode::Return);
+    }
+}
+
+void Compiler::compileDefine(LispArgs args, bool tail) {
+    // Only names found by declareDefinitions have a slot; definitions anywhere
+    // else are left to the evaluator
+    if (args.empty()) {
+        throw Unsupported{};
+    }
+    const Datum& target = *args.begin();
+    if (target.isAtomic()) {
+        std::optional<Symbol> name = target.getAtomicValue<Symbol>();
+        std::optional<size_t> slot = name ? localSlot(*name) : std::nullopt;
+        if (!slot || args.size() != 2) {
+            throw Unsupported{};
+        }
+        compileExpr(*++args.begin(), false);
+        emit(OpCode::StoreLocal, static_cast<uint32_t>(*slot));
+    } else {
+        auto [formals, defn] = SpecialForms::parseFuncDefn(std::move(args));
+        std::optional<size_t> slot = formals.empty() ? std::nullopt : localSlot(formals.front());
+        if (!slot) {
+            throw Unsupported{};
+        }
+        formals.erase(formals.begin());
+        emitClosure(std::move(formals), defn);
+        // Functions are stored in the frame directly, as for a define in a
+        // SymbolTable, so that they do not keep their own scope alive
+        out.instructions.emplace_back(OpCode::DefineFunction, static_cast<uint32_t>(*slot),
+                                      static_cast<uint16_t>(out.lambdas.size() - 1));
+    }
+    emit(OpCode::Const, addConstant(Datum{}));
+    if (tail) {
+        emit(OpCode::Return);
+    }
+}
+
+void Compiler::compileAndOr(LispArgs args, bool tail, bool isAnd) {
+    if (args.empty()) {
+        emit(OpCode::Const, addConstant(Datum{Atom{isAnd}}));
+    } else {
+        std::vector<size_t> jumps;
+        for (auto it = args.begin(); it != args.end();) {
+            compileExpr(*it, false);
+            if (++it != args.end()) {
+                jumps.push_back(emit(isAnd ? OpCode::JumpIfFalseOrPop
+                                           : OpCode::JumpIfTrueOrPop));
+            }
+        }
+        for (size_t jump : jumps) {
+            patch(jump);
+        }
+    }
+    if (tail) {
+        emit(OpCode::Return);
+    }
+}
+
+void Compiler::compileCond(LispArgs args, bool tail) {
+    std::vector<size_t> endJumps;
+    bool hasElse = false;
+    for (const Datum& clause : args) {
+        if (clause.isAtomic() || clause.getSExpr() == nullptr) {
+            throw Unsupported{};
+        }
+        const SExpr* condPair = clause.getSExpr();
+        LispArgs body{condPair->cdr.getSExpr()};
+        if (auto sym = condPair->car.getAtomicValue<Symbol>(); sym && +*sym == "else") {
+            compileBody(std::move(body), tail);
+            hasElse = true;
+            break;
+        }
+        compileExpr(condPair->car, false);
+        const size_t nextJump = emit(OpCode::JumpIfFalse);
+        compileBody(std::move(body), tail);
+        if (!tail) {
+            endJumps.push_back(emit(OpCode::Jump));
+        }
+        patch(nextJump);
+    }
+    if (!hasElse) {
+        // ret value unspecified if all conds false and no else
+        emit(OpCode::Const, addConstant(Datum{}));
+        if (tail) {
+            emit(OpCode::Return);
+        }
+    }
+    for (size_t jump : endJumps) {
+        patch(jump);
+    }
+}
+
+void Compiler::compileCase(LispArgs args, bool tail) {
+    if (args.empty()) {
+        throw Unsupported{};
+    }
+    auto it = args.begin();
+    // The key stays on the stack while we search for a matching clause
+    compileExpr(*it, false);
+    std::vector<size_t> endJumps;
+    bool hasElse = false;
+    for (++it; it != args.end(); ++it) {
+        if (it->isAtomic() || it->getSExpr() == nullptr) {
+            throw Unsupported{};
+        }
+        const SExpr* clause = it->getSExpr();
+        LispArgs body{clause->cdr.getSExpr()};
+        if (clause->car.isAtomic()) {
+            if (auto sym = clause->car.getAtomicValue<Symbol>(); sym && +*sym == "else") {
+                emit(OpCode::Pop);
+                compileBody(std::move(body), tail);
+                hasElse = true;
+                break;
+            }
+            continue;
+        }
+        std::vector<size_t> bodyJumps;
+        for (const Datum& datum : LispArgs{clause->car.getSExpr()}) {
+            emit(OpCode::MatchConst, addConstant(datum));
+            bodyJumps.push_back(emit(OpCode::JumpIfTrue));
+        }
+        const size_t nextJump = emit(OpCode::Jump);
+        for (size_t jump : bodyJumps) {
+            patch(jump);
+        }
+        emit(OpCode::Pop);
+        compileBody(std::move(body), tail);
+        if (!tail) {
+            endJumps.push_back(emit(OpCode::Jump));
+        }
+        patch(nextJump);
+    }
+    if (!hasElse) {
+        // ret value unspecified if no matches and no else
+        emit(OpCode::Pop);
+        emit(OpCode::Const, addConstant(Datum{}));
+        if (tail) {
+            emit(OpCode::Return);
+        }
+    }
+    for (size_t jump : endJumps) {
+        patch(jump);
+    }
+}
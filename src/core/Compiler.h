@@ -0,0 +1,75 @@
+// (c) 2018 Sam Donow
+#pragma once
+#include "core/Bytecode.h"
+#include "data/Data.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/// The Compiler translates the definition of a LispFunction into bytecode to be
+/// run by the VM. Only the core special forms are supported; compile returns
+/// nullptr for definitions using anything else, and those functions are run by
+/// the tree-walking evaluator instead.
+/// Variables are resolved at compile time: parameters and internal definitions
+/// of the function and its enclosing functions become slot indices, and only
+/// the remaining (global) names are looked up at run time
+class Compiler {
+    // Thrown internally when encountering a form that cannot be compiled
+    struct Unsupported {};
+
+    // The variables of the function, in slot order: the parameters, followed
+    // by any names defined in the body
+    std::vector<Symbol> locals;
+    SymbolTable& scope;
+    // The compiler of the enclosing function, when compiling a nested lambda
+    const Compiler* parent;
+    CodeObject& out;
+
+    Compiler(const std::vector<Symbol>& f, SymbolTable& s, const Compiler* p,
+             CodeObject& o)
+        : locals(f), scope(s), parent(p), out(o) {}
+    Compiler(const Compiler&) = delete;
+    Compiler& operator=(const Compiler&) = delete;
+
+    static std::shared_ptr<const CodeObject>
+    compileImpl(const std::vector<Symbol>& formals, const Datum& definition,
+                SymbolTable& scope, const Compiler* parent);
+
+    size_t emit(OpCode op, uint32_t arg = 0);
+    // Set the target of the jump instruction at the given position to the
+    // next instruction to be emitted
+    void patch(size_t jumpPos);
+    uint32_t addConstant(const Datum& datum);
+    uint32_t addName(Symbol name);
+
+    // The number of enclosing functions to go out to find the variable name
+    // (0 for a variable of this function), and its slot there
+    std::optional<std::pair<size_t, size_t>> lexicalAddress(Symbol name) const;
+    std::optional<size_t> localSlot(Symbol name) const;
+    // The name of the special form that expr is an application of, if any
+    const std::string* specialForm(const SExpr& expr) const;
+    // Add the names defined at the top level of the body to the locals
+    void declareDefinitions(const Datum& body);
+    void emitClosure(std::vector<Symbol> formals, const Datum& definition);
+
+    void compileExpr(const Datum& expr, bool tail);
+    void compileSymbol(const Symbol& sym, bool tail);
+    void compileCall(const SExpr& expr, bool tail);
+    void compileBody(LispArgs body, bool tail);
+
+    void compileQuote(LispArgs args, bool tail);
+    void compileIf(LispArgs args, bool tail);
+    void compileLambda(LispArgs args, bool tail);
+    void compileDefine(LispArgs args, bool tail);
+    void compileAndOr(LispArgs args, bool tail, bool isAnd);
+    void compileCond(LispArgs args, bool tail);
+    void compileCase(LispArgs args, bool tail);
+
+  public:
+    static std::shared_ptr<const CodeObject>
+    compile(const std::vector<Symbol>& formals, const Datum& definition,
+            SymbolTable& scope) {
+        return compileImpl(formals, definition, scope, nullptr);
+    }
+};
@@ -1,112 +1,149 @@
 // (c) 2017 Sam Donow
 #include "Evaluator.h"
+#include "core/Compiler.h"
 #include "util/Util.h"
 #include "library/SpecialForms.h"
 #include "library/SystemMethods.h"
+#include "library/HashTableMethods.h"
+#include "library/ListMethods.h"
+#include "library/SortMethods.h"
+#include "library/VectorMethods.h"
 
-Evaluator::Evaluator() : globalScope(std::make_shared<SymbolTable>(nullptr)) {
-    // TODO: have a distinciton between true "special forms" (i.e if, quote)
-    // and library-defined functions (like "+")
-
+Evaluator::Evaluator() : globalScope(makeGC<SymbolTable>(nullptr)), vm(*this) {
     SystemMethods::insertIntoScope(*globalScope);
+    ListMethods::insertIntoScope(*globalScope);
+    SortMethods::insertIntoScope(*globalScope);
+    VectorMethods::insertIntoScope(*globalScope);
+    HashTableMethods::insertIntoScope(*globalScope);
     SpecialForms::insertIntoScope(*globalScope);
 
     // Special Globals
-    globalScope->emplace("#t", Datum{Atom{true}});
-    globalScope->emplace("#f", Datum{Atom{false}});
+    globalScope->emplace(Symbol{"#t"}, Datum{Atom{true}});
+    globalScope->emplace(Symbol{"#f"}, Datum{Atom{false}});
 }
 
 EvalResult Evaluator::computeArgResult(const Datum& datum, SymbolTable& st) {
     if (datum.isAtomic()) {
         const Atom& val = datum.getAtom();
         if (val.contains<Symbol>()) {
-            // Note: this is where we need the SpecialForm/BuiltinFunc distinction;
-            // this should be able to return, e.g "+", but not "if"
-            return computeArgResult(std::get<Datum>(st.get(val)), st);
+            return st.lookup(val.get<Symbol>());
         }
         return Datum{val};
     } else {
-        const SExprPtr& expr = datum.getSExpr();
+        const SExpr* expr = datum.getSExpr();
         if (expr == nullptr) {
-            return Datum{expr};
+            return datum;
         } else {
-            return eval(expr, st);
+            return eval(*expr, st);
         }
     }
 }
 
-Datum
-Evaluator::evalFunction(const std::shared_ptr<LispFunction>& func, const SExprPtr& args,
-                        SymbolTable& scope) {
-    if (func->formalParameters.size() != args->size()) {
-        throw ArityError(func->formalParameters.size(), args->size());
+std::vector<Datum> Evaluator::computeArgs(const LispArgs& args, SymbolTable& st) {
+    std::vector<Datum> values;
+    for (const Datum& datum : args) {
+        values.push_back(computeArg(datum, st));
     }
-    return evalFunction(FunctionCall{func, LispArgs{args}, scope});
+    return values;
 }
 
 Datum Evaluator::evalFunction(const FunctionCall &fc) {
-    const FunctionCall *call = &fc;
-    EvalResult result;
-    std::shared_ptr<SymbolTable> origFuncScope = call->func->funcScope();
-    while (true) {
-        auto formalIt = call->func->formalParameters.begin();
-        auto actualIt = call->args.begin();
-        std::shared_ptr<SymbolTable> funcScope = &call->func == &fc.func ? origFuncScope : call->func->funcScope();
+    const std::vector<Datum> args = computeArgs(fc.args, *fc.scope);
+    return apply(fc.func, args);
+}
 
-        for (; formalIt != call->func->formalParameters.end() && actualIt != call->args.end();
-            ++formalIt, ++actualIt) {
-            Datum argResult = computeArg(*actualIt, *call->scope);
-            funcScope->emplace(+*formalIt, argResult);
-        }
+Datum Evaluator::apply(const Datum& func, ArgSpan args) {
+    if (auto builtin = func.getAtomicValue<BuiltInFunc*>()) {
+        return (*builtin)(args, *this);
+    } else if (auto lf = func.getAtomicValue<GCPtr<LispFunction>>()) {
+        return apply(*lf, args);
+    }
+    throw LispError("Can't evaluate non function");
+}
 
-        if (call->func->definition->cdr.getSExpr() == nullptr) {
-            // Workaround to support things like lambda (x) x...this is probably not
-            // fully compliant with the spec
-            auto sym = call->func->definition->car.getAtomicValue<Symbol>();
-            if (sym) {
-                return std::get<Datum>(funcScope->get(*sym));
-            }
-            return computeArg(call->func->definition->car, *funcScope);
-        } else {
-            result = eval(call->func->definition, *funcScope);
-            if (std::holds_alternative<Datum>(result)) {
-                return std::get<Datum>(result);
-            }
-            call = &std::get<FunctionCall>(result);
+Datum Evaluator::apply(const GCPtr<LispFunction>& func, ArgSpan args) {
+    if (func->formalParameters.size() != args.size()) {
+        throw ArityError(func->formalParameters.size(), args.size());
+    }
+    if (compiledCode(*func) != nullptr) {
+        return vm.run(func, args);
+    }
+    return interpret(func, std::vector<Datum>(args.begin(), args.end()));
+}
+
+Evaluator::Procedure::Procedure(Evaluator& e, const Datum& f, size_t arity)
+    : ev{e}, builtin{nullptr}, func{nullptr}, compiled{false} {
+    if (auto bi = f.getAtomicValue<BuiltInFunc*>()) {
+        builtin = *bi;
+    } else if (auto lf = f.getAtomicValue<GCPtr<LispFunction>>()) {
+        func = *lf;
+        if (func->formalParameters.size() != arity) {
+            throw ArityError(func->formalParameters.size(), arity);
         }
+        compiled = ev.compiledCode(*func) != nullptr;
+    } else {
+        throw LispError("Can't evaluate non function");
     }
 }
 
-EvalResult
-Evaluator::eval(const SExprPtr& expr, SymbolTable& scope) {
-    auto sym = expr->car.getAtomicValue<Symbol>();
-    if (sym) {
-        return std::visit(Visitor {
-            [&](SpecialForm sf) -> EvalResult { return sf(expr->cdr.getSExpr(), scope, *this); },
-            [&](LispFunction& lf) -> EvalResult { return FunctionCall{
-                std::shared_ptr<LispFunction>(scope.shared_from_this(), &lf),
-                LispArgs{expr->cdr.getSExpr()}, scope};
-            },
-            [&](const Datum& datum) -> EvalResult {
-                const auto& func = datum.getAtomicValue<std::shared_ptr<LispFunction>>();
-                if (!func) { throw LispError("Can't find function ", *sym); }
-                else { return FunctionCall{*func, LispArgs{expr->cdr.getSExpr()}, scope}; }
-            }
-        }, scope[+*sym]);
+const CodeObject* Evaluator::compiledCode(LispFunction& func) {
+    if (!bytecodeEnabled) {
+        return nullptr;
+    }
+    if (!func.compiled) {
+        func.code = Compiler::compile(func.formalParameters, func.definition, *func.scope());
+        func.compiled = true;
     }
+    return func.code.get();
+}
 
-    if (!expr->car.isAtomic()) {
-        const Datum& carFunc = std::visit(Visitor{
-            [](const Datum& d) { return d; },
-            [this](const FunctionCall& f) { return evalFunction(f); }
-        }, eval(expr->car.getSExpr(), scope));
-        const auto& func = carFunc.getAtomicValue<std::shared_ptr<LispFunction>>();
-        if (!func) {
-            throw LispError("Can't evaluate non function");
+Datum Evaluator::interpret(GCPtr<LispFunction> func, std::vector<Datum> args) {
+    while (true) {
+        GCPtr<SymbolTable> funcScope = func->funcScope();
+        for (size_t i = 0; i < args.size(); ++i) {
+            funcScope->emplace(func->formalParameters[i], args[i]);
         }
 
-        return FunctionCall{*func, expr->cdr.getSExpr(), scope};
-    } else {
-        throw LispError("Can't evaluate non function");
+        EvalResult result = computeArgResult(func->definition, *funcScope);
+        if (std::holds_alternative<Datum>(result)) {
+            return std::get<Datum>(result);
+        }
+        // Tail call: evaluate the arguments while their scope is still alive, and
+        // loop rather than recursing
+        const FunctionCall& call = std::get<FunctionCall>(result);
+        args = computeArgs(call.args, *call.scope);
+        func = call.func;
+        if (func->formalParameters.size() != args.size()) {
+            throw ArityError(func->formalParameters.size(), args.size());
+        }
+        if (compiledCode(*func) != nullptr) {
+            return vm.run(func, args);
+        }
+    }
+}
+
+EvalResult
+Evaluator::eval(const SExpr& expr, SymbolTable& scope) {
+    LispArgs args{expr.cdr.getSExpr()};
+    Datum func;
+    if (auto sym = expr.car.getAtomicValue<Symbol>()) {
+        SymbolTable::value_type* binding = scope.find(*sym);
+        if (binding == nullptr) {
+            throw LispError("Undefined Symbol: ", *sym);
+        }
+        if (SpecialForm* sf = std::get_if<SpecialForm>(binding)) {
+            return (*sf)(std::move(args), scope, *this);
+        }
+        func = std::get<Datum>(*binding);
+    } else if (!expr.car.isAtomic()) {
+        func = computeArg(expr.car, scope);
+    }
+
+    if (auto lf = func.getAtomicValue<GCPtr<LispFunction>>()) {
+        return FunctionCall{*lf, std::move(args), scope};
+    } else if (auto builtin = func.getAtomicValue<BuiltInFunc*>()) {
+        const std::vector<Datum> argValues = computeArgs(args, scope);
+        return (*builtin)(argValues, *this);
     }
+    throw LispError("Can't evaluate non function");
 }
@@ -1,21 +1,20 @@
 // (c) 2017 Sam Donow
 #pragma once
+#include "core/VM.h"
 #include "data/Data.h"
 
-#include <memory>
+#include <vector>
 class Evaluator {
-    std::shared_ptr<SymbolTable> globalScope;
+    GCPtr<SymbolTable> globalScope;
+    VM vm;
+    // When false, all functions are run by the tree-walking evaluator; this is
+    // kept around as a reference implementation for the compiler and VM
+    bool bytecodeEnabled = true;
 
-  public:
-      /// If the given datum is atomic, get the value of the desired type (if it
-    /// exists) otherwise, recursively evaluate until we return something of the
-    /// desired type.
-    /// return nullopt if there is a failure at any point
-    template <typename T>
-    std::optional<T> getOrEvaluate(const Datum& datum, SymbolTable& st);
+    /// Run a function by walking its definition
+    Datum interpret(GCPtr<LispFunction> func, std::vector<Datum> args);
 
-    template <typename T>
-    T getOrEvaluateE(const Datum& datum, SymbolTable& st);
+  public:
     /// Evaluate an argument in the context of expanding an argument to a function in an
     /// SExpr. As the context is a run-time needed computation, throw if the evaluation fails
     /// instead of returning an optional
@@ -28,13 +27,44 @@ class Evaluator {
 
     EvalResult computeArgResult(const Datum& datum, SymbolTable& st);
 
-    /// Evaluate a lisp function on the given args
-    Datum evalFunction(const std::shared_ptr<LispFunction>& func,
-                       const SExprPtr& args,
-                       SymbolTable& st);
+    /// Evaluate each of the given arguments in order
+    std::vector<Datum> computeArgs(const LispArgs& args, SymbolTable& st);
 
     Datum evalFunction(const FunctionCall &fc);
 
+    /// Call a function (either a LispFunction or a builtin) on already evaluated
+    /// arguments
+    Datum apply(const Datum& func, ArgSpan args);
+    Datum apply(const GCPtr<LispFunction>& func, ArgSpan args);
+
+    /// A function to be called repeatedly by a builtin with a fixed number of
+    /// arguments. The type dispatch, arity check and compilation that apply
+    /// does on each call are done once, on construction
+    class Procedure {
+        Evaluator& ev;
+        BuiltInFunc* builtin;
+        GCPtr<LispFunction> func;
+        bool compiled;
+
+      public:
+        Procedure(Evaluator& e, const Datum& f, size_t arity);
+
+        Datum operator()(ArgSpan args) const {
+            if (builtin != nullptr) {
+                return builtin(args, ev);
+            } else if (compiled) {
+                return ev.vm.run(func, args);
+            }
+            return ev.interpret(func, std::vector<Datum>(args.begin(), args.end()));
+        }
+    };
+
+    /// The bytecode for the given function, compiling it if this is the first
+    /// call. Returns nullptr if the function is to be interpreted
+    const CodeObject* compiledCode(LispFunction& func);
+
+    void setBytecodeEnabled(bool enabled) { bytecodeEnabled = enabled; }
+
     /// On construction, we populate the global scope with all of the special
     /// forms and language-level functions
     Evaluator();
@@ -43,42 +73,17 @@ class Evaluator {
     Evaluator operator=(const Evaluator&) = delete;
     Evaluator operator==(Evaluator&&) = delete;
     /// Main public interface: evaluates an expression in a given scope
-    EvalResult eval(const SExprPtr& expr, SymbolTable& scope);
+    EvalResult eval(const SExpr& expr, SymbolTable& scope);
     Datum evalDatum(const SExprPtr& expr, SymbolTable& scope) {
         return std::visit(Visitor{
             [](const Datum& datum) { return datum; },
             [this](const FunctionCall& fc) { return evalFunction(fc); }
-        }, eval(expr, scope));
+        }, eval(*expr, scope));
     }
 
+    SymbolTable& getGlobalScope() { return *globalScope; }
+
     Datum eval(const SExprPtr& expr) {
         return evalDatum(expr, *globalScope);
     }
 };
-
-template <typename T>
-std::optional<T>
-Evaluator::getOrEvaluate(const Datum& datum, SymbolTable& st) {
-    if (datum.isAtomic()) {
-        const Atom& val = datum.getAtom();
-        if constexpr (!std::is_same_v<T, Symbol>) {
-            if (val.contains<Symbol>()) {
-                return getOrEvaluate<T>(std::get<Datum>(st.get(val)), st);
-            }
-        }
-        return val.get<T>();
-    } else {
-        const auto& expr = datum.getSExpr();
-        const Datum result = evalDatum(expr, st);
-        return getOrEvaluate<T>(result, st);
-    }
-}
-
-template <typename T>
-T Evaluator::getOrEvaluateE(const Datum& datum, SymbolTable& st) {
-    std::optional<T> val = getOrEvaluate<T>(datum, st);
-    if (!val) {
-        throw LispError("Type Error, TODO description");
-    }
-    return *val;
-}
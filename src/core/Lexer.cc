@@ -1,63 +1,71 @@
 // (c) 2017-2018 Sam Donow
 #include "Lexer.h"
+#include "core/LexerScan.h"
+#include "core/NumberScanner.h"
 #include "util/Util.h"
-#include <cstdlib>
 #include <tuple>
 
-std::pair<Token, std::string_view> Lexer::getWhile(TokenType type, std::string_view input,
-                                                   bool (*pred)(char)) {
-    auto it = input.begin();
-    for (; it < input.end() && pred(*it); ++it)
-        ;
-    size_t len = static_cast<size_t>(std::distance(input.begin(), it));
-    return {{type, input.substr(0, len)}, input.substr(len)};
-}
-
 // TODO: use some sort of real parsing/lexing framework
 std::pair<Token, std::string_view> Lexer::next(std::string_view input) {
-    auto it = input.begin();
-    for (; it < input.end() && !isDelimeter(*it); ++it)
-        ;
-    if (it == input.begin()) {
+    using lexscan::CharClass;
+    size_t len = lexscan::find(input, 0, CharClass::Delimiter);
+    if (len == 0) {
         // We start with a delimeter.
-        if (isParen(*it)) {
+        const char c = input.front();
+        if (isParen(c)) {
             return {{TokenType::Paren, input.substr(0, 1)}, input.substr(1)};
         }
-        if (isSpace(*it)) {
-            return getWhile(TokenType::Trivia, input, &Lexer::isSpace);
+        if (isSpace(c)) {
+            const size_t end = lexscan::findNot(input, 1, CharClass::Space);
+            return {{TokenType::Trivia, input.substr(0, end)}, input.substr(end)};
         }
-        if (isDoubleQuote(*it)) {
-            bool isEscaped = false;
-            for (++it; it < input.end() && !(!isEscaped && isDoubleQuote(*it)); ++it)
-                isEscaped = !isEscaped && *it == '\\';
-            if (it == input.end()) {
-                throw "Unterminated String";
+        if (isDoubleQuote(c)) {
+            // Skip to the closing quote, stepping over escaped characters
+            size_t end = lexscan::find(input, 1, CharClass::StringSpecial);
+            while (end < input.size() && input[end] == '\\') {
+                end = lexscan::find(input, end + 2, CharClass::StringSpecial);
             }
-            const size_t len = static_cast<size_t>(std::distance(input.begin(), it));
-            return {{TokenType::String, input.substr(1, len - 1)}, input.substr(len + 1)};
+            if (end >= input.size()) {
+                // The rest of the input may yet be followed by the closing quote
+                return {{TokenType::Error, input}, {}};
+            }
+            return {{TokenType::String, input.substr(1, end - 1)}, input.substr(end + 1)};
         }
-        if (*it == '\'') {
+        if (c == '\'') {
             return {{TokenType::Quote, input.substr(0, 1)}, input.substr(1)};
         }
-        if (++it == input.end()) {
+        if (input.size() == 1) {
             return {{TokenType::Trivia, {}}, {}};
         }
+        len = 1;
+    }
+    const std::string_view tokenText = input.substr(0, len);
+    // Only numbers start with a digit, a sign or a point, so most symbols are
+    // known to be symbols from their first character
+    const char first = tokenText.front();
+    const bool mayBeNumber = (first >= '0' && first <= '9') || first == '+' || first == '-' ||
+                             first == '.';
+    if (!mayBeNumber || NumberScanner::classify(tokenText) == NumberScanner::Kind::NotANumber) {
+        return {{TokenType::Symbol, tokenText}, input.substr(len)};
     }
-    std::string_view tokenText{
-        &*input.begin(), static_cast<size_t>(std::distance(input.begin(), it))};
-    std::string tokenString{tokenText};
-    char* endptr;
-    const char *cstr = +tokenString;
-    std::strtod(cstr, &endptr);
-    if (endptr < cstr + tokenString.size()) {
-        // It's not a number
-        return {{TokenType::Symbol, tokenText}, input.substr(tokenText.size())};
+    return {{TokenType::Number, tokenText}, input.substr(len)};
+}
+
+bool Lexer::setScanner(Scanner kind) {
+    if (!lexscan::supported(kind)) {
+        return false;
     }
-    return {{TokenType::Number, tokenText}, input.substr(tokenText.size())};
+    lexscan::select(kind);
+    return true;
+}
+
+Lexer::Scanner Lexer::activeScanner() {
+    return lexscan::activeKind;
 }
 
 std::vector<Token> Lexer::getTokens(std::string_view input) {
     std::vector<Token> tokens;
+    tokens.reserve(input.size() / 8);
     while (!input.empty()) {
         auto [token, nextInput] = next(input);
         if (token.getType() != TokenType::Trivia) {
@@ -14,21 +14,22 @@
 class Lexer {
     static constexpr bool isParen(char c) { return c == '(' || c == ')'; }
 
-    static constexpr bool isDelimeter(char c) {
-        return isSpace(c) || isParen(c) || isDoubleQuote(c) || c == ';' ||
-               c == '\'' || c == '`' || c == '|' || c == '[' || c == ']' ||
-               c == '{' || c == '}';
-    }
     static constexpr bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\0'; }
 
     static constexpr bool isDoubleQuote(char c) { return c == '"'; }
 
-    std::pair<Token, std::string_view>
-    getWhile(TokenType type, std::string_view input, bool (*pred)(char));
-
   public:
     std::pair<Token, std::string_view> next(std::string_view input);
 
     std::vector<Token> getTokens(std::string_view input);
 
+    /// Symbols, numbers, whitespace and the bodies of strings are skipped over
+    /// by scanning for the character that ends them, either one character at
+    /// a time, or a block of 16 (SSE2) or 32 (AVX2) characters at a time. The
+    /// fastest the CPU supports is chosen at startup
+    enum class Scanner { Scalar, Sse2, Avx2 };
+    /// Switch scanners, e.g. to benchmark them; false if unsupported here
+    static bool setScanner(Scanner kind);
+    static Scanner activeScanner();
+
 };
@@ -0,0 +1,200 @@
+// (c) Sam Donow 2018
+#include "LexerScan.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace lexscan {
+namespace {
+constexpr bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\0';
+}
+
+constexpr bool isDelimiter(char c) {
+    return isSpace(c) || c == '(' || c == ')' || c == '"' || c == ';' || c == '\'' ||
+           c == '`' || c == '|' || c == '[' || c == ']' || c == '{' || c == '}';
+}
+
+constexpr bool isStringSpecial(char c) {
+    return c == '"' || c == '\\';
+}
+
+bool isOf(char c, CharClass cls) {
+    switch (cls) {
+    case CharClass::Space:
+        return isSpace(c);
+    case CharClass::Delimiter:
+        return isDelimiter(c);
+    case CharClass::StringSpecial:
+        break;
+    }
+    return isStringSpecial(c);
+}
+
+// One character at a time; also finishes the blocked scans, over the
+// characters after the last whole block
+size_t findScalar(std::string_view text, size_t from, CharClass cls, bool negate) {
+    for (; from < text.size(); ++from) {
+        if (isOf(text[from], cls) != negate) {
+            return from;
+        }
+    }
+    return text.size();
+}
+
+#if defined(__x86_64__)
+// The characters of a class are found by comparing a block against each
+// character of the class and combining the results; movemask then gathers a
+// bit per character, with the first character in the low bit. The classes
+// nest, so the delimiter comparisons extend the whitespace ones
+__m128i matchesSse2(__m128i block, CharClass cls) {
+    const auto eq = [block](char c) { return _mm_cmpeq_epi8(block, _mm_set1_epi8(c)); };
+    if (cls == CharClass::StringSpecial) {
+        return _mm_or_si128(eq('"'), eq('\\'));
+    }
+    __m128i matches =
+        _mm_or_si128(_mm_or_si128(eq(' '), eq('\t')), _mm_or_si128(eq('\n'), eq('\0')));
+    if (cls == CharClass::Delimiter) {
+        for (char c : {'(', ')', '"', ';', '\'', '`', '|', '[', ']', '{', '}'}) {
+            matches = _mm_or_si128(matches, eq(c));
+        }
+    }
+    return matches;
+}
+
+// Sixteen characters at a time, with SSE2, which every x86-64 CPU has
+size_t findSse2(std::string_view text, size_t from, CharClass cls, bool negate) {
+    const uint32_t flip = negate ? 0xffff : 0;
+    for (; from + 16 <= text.size(); from += 16) {
+        const __m128i block =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + from));
+        const uint32_t mask =
+            static_cast<uint32_t>(_mm_movemask_epi8(matchesSse2(block, cls))) ^ flip;
+        if (mask != 0) {
+            return from + static_cast<size_t>(__builtin_ctz(mask));
+        }
+    }
+    return findScalar(text, from, cls, negate);
+}
+
+__attribute__((target("avx2")))
+__m256i eqAvx2(__m256i block, char c) {
+    return _mm256_cmpeq_epi8(block, _mm256_set1_epi8(c));
+}
+
+// Delimiters are found with a table lookup of each half of each character,
+// with vpshufb: each bit stands for a range of 16 characters (a value of the
+// high half) holding some delimiters, and a character is a delimiter if the
+// entry for its low half has the bit of its high half
+__attribute__((target("avx2")))
+__m256i delimitersAvx2(__m256i block) {
+    // Bits for the characters 0x00-0x0f, 0x20-0x2f, 0x30-0x3f, 0x50-0x5f,
+    // 0x60-0x6f and 0x70-0x7f
+    const __m256i highBits = _mm256_setr_epi8(1, 0, 2, 4, 0, 8, 16, 32, 0, 0, 0, 0, 0, 0, 0, 0,
+                                              1, 0, 2, 4, 0, 8, 16, 32, 0, 0, 0, 0, 0, 0, 0, 0);
+    // By low half: 0 '\0' ' ' '`', 2 '"', 7 '\'', 8 '(', 9 '\t' ')', a '\n',
+    // b ';' '[' '{', c '|', d ']' '}'
+    const __m256i lowBits = _mm256_setr_epi8(1 | 2 | 16, 0, 2, 0, 0, 0, 0, 2,
+                                             2, 1 | 2, 1, 4 | 8 | 32, 32, 8 | 32, 0, 0,
+                                             1 | 2 | 16, 0, 2, 0, 0, 0, 0, 2,
+                                             2, 1 | 2, 1, 4 | 8 | 32, 32, 8 | 32, 0, 0);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    const __m256i high = _mm256_and_si256(_mm256_srli_epi16(block, 4), nibble);
+    const __m256i low = _mm256_and_si256(block, nibble);
+    const __m256i bits = _mm256_and_si256(_mm256_shuffle_epi8(highBits, high),
+                                          _mm256_shuffle_epi8(lowBits, low));
+    return _mm256_xor_si256(_mm256_cmpeq_epi8(bits, _mm256_setzero_si256()),
+                            _mm256_set1_epi8(-1));
+}
+
+__attribute__((target("avx2")))
+__m256i matchesAvx2(__m256i block, CharClass cls) {
+    switch (cls) {
+    case CharClass::Space:
+        return _mm256_or_si256(_mm256_or_si256(eqAvx2(block, ' '), eqAvx2(block, '\t')),
+                               _mm256_or_si256(eqAvx2(block, '\n'), eqAvx2(block, '\0')));
+    case CharClass::Delimiter:
+        return delimitersAvx2(block);
+    case CharClass::StringSpecial:
+        break;
+    }
+    return _mm256_or_si256(eqAvx2(block, '"'), eqAvx2(block, '\\'));
+}
+
+// Thirty-two characters at a time, with AVX2. Only selected once the CPU is
+// known to support it
+__attribute__((target("avx2")))
+size_t findAvx2(std::string_view text, size_t from, CharClass cls, bool negate) {
+    const uint32_t flip = negate ? 0xffffffff : 0;
+    for (; from + 32 <= text.size(); from += 32) {
+        const __m256i block =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text.data() + from));
+        const uint32_t mask =
+            static_cast<uint32_t>(_mm256_movemask_epi8(matchesAvx2(block, cls))) ^ flip;
+        if (mask != 0) {
+            return from + static_cast<size_t>(__builtin_ctz(mask));
+        }
+    }
+    return findSse2(text, from, cls, negate);
+}
+#endif
+
+FindFunc* findOf(Lexer::Scanner kind) {
+    switch (kind) {
+    case Lexer::Scanner::Scalar:
+        break;
+#if defined(__x86_64__)
+    case Lexer::Scanner::Sse2:
+        return &findSse2;
+    case Lexer::Scanner::Avx2:
+        return &findAvx2;
+#else
+    case Lexer::Scanner::Sse2:
+    case Lexer::Scanner::Avx2:
+        break;
+#endif
+    }
+    return &findScalar;
+}
+
+Lexer::Scanner best() {
+    return supported(Lexer::Scanner::Avx2)   ? Lexer::Scanner::Avx2
+           : supported(Lexer::Scanner::Sse2) ? Lexer::Scanner::Sse2
+                                             : Lexer::Scanner::Scalar;
+}
+}
+
+FindFunc* activeFind = &findScalar;
+Lexer::Scanner activeKind = Lexer::Scanner::Scalar;
+
+namespace {
+[[maybe_unused]] const bool bestSelected = (select(best()), true);
+}
+
+bool supported(Lexer::Scanner kind) {
+    switch (kind) {
+    case Lexer::Scanner::Scalar:
+        return true;
+    case Lexer::Scanner::Sse2:
+#if defined(__x86_64__)
+        return true;
+#else
+        return false;
+#endif
+    case Lexer::Scanner::Avx2:
+#if defined(__x86_64__)
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+void select(Lexer::Scanner kind) {
+    activeFind = findOf(kind);
+    activeKind = kind;
+}
+}
@@ -0,0 +1,42 @@
+// (c) Sam Donow 2018
+#pragma once
+#include "core/Lexer.h"
+
+#include <cstddef>
+#include <string_view>
+
+/// The loops by which the Lexer skips over runs of characters, classifying a
+/// block of 16 or 32 characters at a time where the CPU allows. The fastest
+/// implementation the CPU supports is chosen at startup; see Lexer::Scanner
+namespace lexscan {
+enum class CharClass : uint8_t {
+    /// Whitespace
+    Space,
+    /// Anything that ends a symbol or number: whitespace, parens, quotes, ...
+    Delimiter,
+    /// What ends a run of a string's body: a double quote or a backslash
+    StringSpecial,
+};
+
+/// The index of the first character of text, from from onwards, that is (or,
+/// if negate, is not) of the given class; text.size() if there is none
+using FindFunc = size_t(std::string_view text, size_t from, CharClass cls, bool negate);
+
+/// The implementation in use
+extern FindFunc* activeFind;
+extern Lexer::Scanner activeKind;
+
+inline size_t find(std::string_view text, size_t from, CharClass cls) {
+    return activeFind(text, from, cls, false);
+}
+
+inline size_t findNot(std::string_view text, size_t from, CharClass cls) {
+    return activeFind(text, from, cls, true);
+}
+
+/// Whether the given implementation can run here
+bool supported(Lexer::Scanner kind);
+
+/// Switch to the given implementation, which must be supported
+void select(Lexer::Scanner kind);
+}
@@ -0,0 +1,74 @@
+// (c) Sam Donow 2018
+#include "Loader.h"
+#include "core/Evaluator.h"
+#include "core/StreamParser.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <optional>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw LispError("Cannot open ", path, ": ", std::strerror(errno));
+    }
+    struct stat info {};
+    if (::fstat(fd, &info) != 0) {
+        const int err = errno;
+        ::close(fd);
+        throw LispError("Cannot read ", path, ": ", std::strerror(err));
+    }
+    size = static_cast<size_t>(info.st_size);
+    // Empty files cannot be mapped, but have no text to map
+    if (size != 0) {
+        void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        const int err = errno;
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            throw LispError("Cannot map ", path, ": ", std::strerror(err));
+        }
+        ::madvise(mapping, size, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(mapping);
+    } else {
+        ::close(fd);
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (data != nullptr) {
+        ::munmap(const_cast<char*>(data), size);
+    }
+}
+
+Datum Loader::loadText(std::string_view text, SymbolTable& scope, Evaluator& ev) {
+    // The text is parsed a piece at a time, evaluating the forms of each piece
+    // before parsing the next
+    constexpr size_t pieceSize = 1 << 16;
+    StreamParser parser;
+    Datum result;
+    const auto evalForms = [&] {
+        while (std::optional<Datum> form = parser.next()) {
+            result = ev.computeArg(*form, scope);
+        }
+    };
+    while (!text.empty()) {
+        const size_t size = std::min(pieceSize, text.size());
+        parser.feed(text.substr(0, size));
+        text.remove_prefix(size);
+        evalForms();
+    }
+    parser.finish();
+    evalForms();
+    return result;
+}
+
+Datum Loader::loadFile(const std::string& path, SymbolTable& scope, Evaluator& ev) {
+    const MappedFile file{path};
+    return loadText(file.text(), scope, ev);
+}
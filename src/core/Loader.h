@@ -0,0 +1,30 @@
+// (c) Sam Donow 2018
+#pragma once
+#include "data/Data.h"
+
+#include <string>
+#include <string_view>
+
+/// A file mapped read-only into memory for the lifetime of the object, so that
+/// it can be lexed in place without being copied
+class MappedFile {
+    const char* data = nullptr;
+    size_t size = 0;
+
+  public:
+    explicit MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    std::string_view text() const { return {data, size}; }
+};
+
+/// Evaluates source text one top level form at a time, evaluating the forms
+/// read from each piece of the text before the next piece is lexed
+class Loader {
+  public:
+    /// Evaluate the forms of text in scope, returning the value of the last
+    static Datum loadText(std::string_view text, SymbolTable& scope, Evaluator& ev);
+    static Datum loadFile(const std::string& path, SymbolTable& scope, Evaluator& ev);
+};
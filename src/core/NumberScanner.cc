@@ -0,0 +1,145 @@
+// (c) 2018 Sam Donow
+#include "NumberScanner.h"
+
+#include <charconv>
+#include <cstdlib>
+#include <string>
+
+namespace {
+using Kind = NumberScanner::Kind;
+
+constexpr bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+// A run of digits, with its value while that fits in 64 bits
+struct Digits {
+    std::string_view text{};
+    uint64_t value = 0;
+    bool overflow = false;
+};
+
+// Scan the digits starting at pos, advancing pos past them
+Digits scanDigits(std::string_view text, size_t& pos) noexcept {
+    Digits digits;
+    const size_t start = pos;
+    for (; pos < text.size() && isDigit(text[pos]); ++pos) {
+        const uint64_t digit = static_cast<uint64_t>(text[pos] - '0');
+        digits.overflow = digits.overflow ||
+                          __builtin_mul_overflow(digits.value, 10, &digits.value) ||
+                          __builtin_add_overflow(digits.value, digit, &digits.value);
+    }
+    digits.text = text.substr(start, pos - start);
+    return digits;
+}
+
+struct Literal {
+    Kind kind = Kind::NotANumber;
+    bool negative = false;
+    // The integer, the numerator of a rational, or the integer part of a decimal
+    Digits integer{};
+    Digits denominator{};
+};
+
+// Classify a literal, accumulating the values of its integers as they are
+// scanned, so that small integers need no further work
+Literal scan(std::string_view text) noexcept {
+    Literal literal;
+    size_t pos = 0;
+    if (!text.empty() && (text[0] == '+' || text[0] == '-')) {
+        literal.negative = text[0] == '-';
+        ++pos;
+    }
+    literal.integer = scanDigits(text, pos);
+    const bool hasInteger = !literal.integer.text.empty();
+    if (pos == text.size()) {
+        literal.kind = hasInteger ? Kind::Integer : Kind::NotANumber;
+        return literal;
+    }
+    if (text[pos] == '/') {
+        ++pos;
+        literal.denominator = scanDigits(text, pos);
+        if (hasInteger && !literal.denominator.text.empty() && pos == text.size()) {
+            literal.kind = Kind::Rational;
+        }
+        return literal;
+    }
+    bool hasFraction = false;
+    if (text[pos] == '.') {
+        ++pos;
+        hasFraction = !scanDigits(text, pos).text.empty();
+    }
+    if (!hasInteger && !hasFraction) {
+        return literal;
+    }
+    if (pos < text.size() && (text[pos] == 'e' || text[pos] == 'E')) {
+        ++pos;
+        if (pos < text.size() && (text[pos] == '+' || text[pos] == '-')) {
+            ++pos;
+        }
+        if (scanDigits(text, pos).text.empty()) {
+            return literal;
+        }
+    }
+    if (pos == text.size()) {
+        literal.kind = Kind::Decimal;
+    }
+    return literal;
+}
+
+BigInt bigValue(const Digits& digits) {
+    return digits.overflow ? BigInt::fromString(digits.text) : BigInt{digits.value};
+}
+
+Number integerValue(const Digits& digits, bool negative) {
+    constexpr uint64_t minMagnitude = uint64_t{1} << 63;
+    if (!digits.overflow && (digits.value < minMagnitude || (negative && digits.value == minMagnitude))) {
+        return Number{static_cast<long>(negative ? 0 - digits.value : digits.value)};
+    }
+    const BigInt magnitude = BigInt::fromString(digits.text);
+    return Number{negative ? -magnitude : magnitude};
+}
+
+Number rationalValue(const Literal& literal) {
+    const BigInt numerator = bigValue(literal.integer);
+    const BigInt denominator = bigValue(literal.denominator);
+    if (unlikely(denominator == BigInt{0})) {
+        throw LispError("Division by zero");
+    }
+    const Rational<BigInt> rat{literal.negative ? -numerator : numerator, denominator};
+    if (rat.denominator() == BigInt{1}) {
+        return Number{rat.numerator()};
+    }
+    return Number{rat};
+}
+
+Number decimalValue(std::string_view text) {
+    // from_chars does not accept a leading plus sign
+    if (text.front() == '+') {
+        text.remove_prefix(1);
+    }
+    double value{};
+    if (std::from_chars(text.data(), text.data() + text.size(), value).ec == std::errc{}) {
+        return Number{value};
+    }
+    // Out of range: let strtod find the infinity or zero
+    return Number{std::strtod(std::string{text}.c_str(), nullptr)};
+}
+}
+
+Kind NumberScanner::classify(std::string_view text) noexcept {
+    return scan(text).kind;
+}
+
+Number NumberScanner::parse(std::string_view text) {
+    const Literal literal = scan(text);
+    switch (literal.kind) {
+    case Kind::Integer:
+        return integerValue(literal.integer, literal.negative);
+    case Kind::Rational:
+        return rationalValue(literal);
+    case Kind::Decimal:
+        return decimalValue(text);
+    case Kind::NotANumber:
+        break;
+    }
+    throw LispError("Invalid number: ", text);
+}
@@ -0,0 +1,20 @@
+// (c) 2018 Sam Donow
+#pragma once
+#include "data/Number.h"
+
+#include <string_view>
+
+/// Scanner for numeric literals, shared by the Lexer, which only needs to know
+/// whether a token is a number, and the Parser, which needs its value.
+/// Literals are integers of any length and n/d rationals, which are exact, and
+/// decimals with an optional exponent, which are inexact. All may be signed
+class NumberScanner {
+  public:
+    enum class Kind { NotANumber, Integer, Rational, Decimal };
+
+    /// Classify the text of a token in a single pass, without computing its value
+    static Kind classify(std::string_view text) noexcept;
+
+    /// The value of a numeric literal; throws if text is not one
+    static Number parse(std::string_view text);
+};
@@ -1,25 +1,71 @@
 // (c) 2017 Sam Donow
 #include "Parser.h"
+#include "core/NumberScanner.h"
+
+#include <utility>
+
+namespace {
+// A list being read: its first and last cells, and the number of quotes
+// before its open paren
+struct Frame {
+    SExprPtr head{nullptr};
+    SExpr* tail = nullptr;
+    size_t quotes = 0;
+};
+}
 
-#include <math.h>
 std::optional<SExprPtr>
-Parser::parse(std::vector<Token> &tokens) {
-    if (tokens.empty() ||
-        !(tokens.begin()->isOpenParen() ||
-          tokens.begin()->getType() == TokenType::Quote)) {
+Parser::parse(const std::vector<Token>& tokens, size_t& pos) {
+    if (pos >= tokens.size() ||
+        !(tokens[pos].isOpenParen() || tokens[pos].getType() == TokenType::Quote)) {
         return std::nullopt;
     }
-    auto[ret, it] = parseImpl(tokens.begin(), tokens.end());
-    if (ret) {
-        tokens.erase(tokens.begin(), it);
+    std::vector<Frame> stack;
+    // The number of quotes read since the last datum, to be applied to the next
+    size_t quotes = 0;
+    for (size_t i = pos; i < tokens.size(); ++i) {
+        const Token& token = tokens[i];
+        Datum datum;
+        if (token.getType() == TokenType::Trivia) {
+            continue;
+        } else if (token.getType() == TokenType::Quote) {
+            ++quotes;
+            continue;
+        } else if (token.isOpenParen()) {
+            stack.push_back(Frame{nullptr, nullptr, std::exchange(quotes, 0)});
+            continue;
+        } else if (token.isCloseParen()) {
+            if (quotes != 0 || stack.empty()) {
+                // Nothing to quote
+                return std::nullopt;
+            }
+            Frame frame = std::move(stack.back());
+            stack.pop_back();
+            datum = quote(Datum{frame.head}, frame.quotes);
+        } else {
+            datum = quote(Datum{atomFromToken(token)}, std::exchange(quotes, 0));
+        }
+
+        if (stack.empty()) {
+            pos = i + 1;
+            return SExprPtr{datum.getSExpr()};
+        }
+        Frame& frame = stack.back();
+        auto cell = makeGC<SExpr>(datum);
+        if (frame.tail == nullptr) {
+            frame.head = cell;
+        } else {
+            frame.tail->cdr = Datum{cell};
+        }
+        frame.tail = cell.get();
     }
-    return ret;
+    return std::nullopt;
 }
 
 Atom Parser::atomFromToken(const Token& token) {
     switch (token.getType()) {
     case TokenType::Symbol: {
-        return Atom{Symbol{std::string{token.getText()}}};
+        return Atom{Symbol{token.getText()}};
     }
     case TokenType::String: {
         std::string transformed;
@@ -46,6 +92,7 @@ Atom Parser::atomFromToken(const Token& token) {
                         throw LispError("Unsupported Escaped sequence \\", c);
                 }
                 isEscaped = false;
+                continue;
             }
             if (c == '\\') {
                 isEscaped = true;
@@ -56,18 +103,13 @@ Atom Parser::atomFromToken(const Token& token) {
         return Atom{std::move(transformed)};
     }
     case TokenType::Number: {
-        // TODO handle this properly for more general inputs
-        double d;
-        sscanf(token.getText().data(), "%lf", &d);
-        if (fmod(d, 1.0) != 0.0) {
-            return Atom{Number{d}};
-        }
-        return Atom{Number{static_cast<long>(d)}};
+        return Atom{NumberScanner::parse(token.getText())};
     }
 
+    case TokenType::Error:
+        throw LispError("Unterminated string: ", token.getText());
     case TokenType::Paren:
     case TokenType::Trivia:
-    case TokenType::Error:
     case TokenType::Unset:
     case TokenType::Quote:
         break;
@@ -75,69 +117,13 @@ Atom Parser::atomFromToken(const Token& token) {
     return Atom{};
 }
 
-template <typename Iterator>
-std::pair<std::optional<SExprPtr>, Iterator>
-Parser::parseImpl(Iterator first, Iterator last) {
-    Iterator curr = first;
-    if (curr->isOpenParen()) {
-        // Consume open paren if it is there
-        ++curr;
-    }
-
-    SExprPtr sexpr = nullptr;
-    SExpr* currSexpr = nullptr;
-    while (curr != last) {
-        if (curr->isCloseParen()) {
-            return {sexpr, ++curr};
-        } else if (curr->getType() == TokenType::Quote) {
-            // The Quote character is really just syntactic sugar for the
-            // special form quote
-            SExprPtr newSexpr = std::make_shared<SExpr>(Atom{Symbol{"quote"}});
-            const bool isEntire = sexpr == nullptr;
-            if (isEntire) {
-                sexpr = std::move(newSexpr);
-                currSexpr = sexpr.get();
-            } else {
-                currSexpr->cdr = std::make_shared<SExpr>(std::move(newSexpr));
-                currSexpr = currSexpr->cdr.getSExpr()->car.getSExpr().get();
-            }
-            auto[cdr, next] = parseImpl(++curr, last);
-            if (!cdr) {
-                return {std::nullopt, first};
-            }
-            currSexpr->cdr = std::make_shared<SExpr>(std::move(*cdr));
-            currSexpr = currSexpr->cdr.getSExpr().get();
-            curr = next;
-            if (isEntire) {
-                return {sexpr, curr};
-            }
-        } else if (curr->isOpenParen()) {
-            auto[ret, next] = parseImpl(curr, last);
-            if (!ret) {
-                return {std::nullopt, first};
-            }
-            const SExprPtr& ptr = *ret;
-            if (sexpr == nullptr) {
-                sexpr = std::make_shared<SExpr>(ptr);
-                currSexpr = sexpr.get();
-            } else {
-                currSexpr->cdr = std::make_shared<SExpr>(ptr);
-                currSexpr = currSexpr->cdr.getSExpr().get();
-            }
-            curr = next;
-        } else if (curr->getType() != TokenType::Trivia) {
-            Atom atom = atomFromToken(*curr);
-            if (!sexpr) {
-                sexpr = std::make_shared<SExpr>(std::move(atom));
-                currSexpr = sexpr.get();
-            } else {
-                currSexpr->cdr = std::make_shared<SExpr>(std::move(atom));
-                currSexpr = currSexpr->cdr.getSExpr().get();
-            }
-            ++curr;
-        } else {
-            ++curr;
-        }
+Datum Parser::quote(Datum datum, size_t count) {
+    // The Quote character is really just syntactic sugar for the special form
+    // quote
+    for (; count != 0; --count) {
+        auto quoteForm = makeGC<SExpr>(Atom{Symbol{"quote"}});
+        quoteForm->cdr = Datum{makeGC<SExpr>(datum)};
+        datum = Datum{quoteForm};
     }
-    return {std::nullopt, first};
+    return datum;
 }
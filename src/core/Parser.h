@@ -4,23 +4,26 @@
 #include "data/Token.h"
 #include "data/Data.h"
 
-#include <list>
 #include <memory>
 #include <vector>
 #include <optional>
-#include <utility>
 
 
 /// The parser takes in a stream of tokens, and parses their structure; it always
-/// returns an SExpr, as that is the only fundamental structure in Lisp
+/// returns an SExpr, as that is the only fundamental structure in Lisp.
+///
+/// The lists being read are kept as an explicit stack on the heap rather than
+/// by recursion, so how deeply forms may nest is only limited by memory
 class Parser {
   public:
-    std::optional<SExprPtr> parse(std::vector<Token>& tokens);
+    /// Parse the form starting at tokens[pos], advancing pos past it. Returns
+    /// nullopt, leaving pos where it was, if the tokens end within the form
+    std::optional<SExprPtr> parse(const std::vector<Token>& tokens, size_t& pos);
 
-  private:
+    /// The atom a token of a string, symbol or number denotes
     static Atom atomFromToken(const Token& token);
 
-    template<typename Iterator>
-    std::pair<std::optional<SExprPtr>, Iterator>
-    static parseImpl(Iterator first, Iterator last);
+    /// datum wrapped in count quote forms, as a datum preceded by that many
+    /// quote characters reads
+    static Datum quote(Datum datum, size_t count);
  };
@@ -0,0 +1,136 @@
+// (c) Sam Donow 2018
+#include "StreamParser.h"
+#include "core/LexerScan.h"
+#include "core/Parser.h"
+
+#include <utility>
+
+void StreamParser::consume(std::string_view input, bool last) {
+    while (!input.empty()) {
+        auto [token, rest] = lex.next(input);
+        const TokenType type = token.getType();
+        if (!last && rest.empty() &&
+            (type == TokenType::Symbol || type == TokenType::Number || type == TokenType::Error)) {
+            partial.assign(input);
+            partialEscaped = false;
+            if (type == TokenType::Error) {
+                scanString(input.substr(1), partialEscaped);
+            }
+            return;
+        }
+        push(token);
+        input = rest;
+    }
+}
+
+void StreamParser::push(const Token& token) {
+    if (token.getType() == TokenType::Trivia) {
+        return;
+    } else if (token.getType() == TokenType::Quote) {
+        ++quotes;
+    } else if (token.isOpenParen()) {
+        stack.push_back(Frame{nullptr, nullptr, std::exchange(quotes, 0)});
+    } else if (token.isCloseParen()) {
+        if (stack.empty()) {
+            throw LispError("Unexpected ')'");
+        } else if (quotes != 0) {
+            throw LispError("Expected a datum to quote before ')'");
+        }
+        Frame frame = std::move(stack.back());
+        stack.pop_back();
+        complete(Datum{frame.head}, frame.quotes);
+    } else {
+        complete(Datum{Parser::atomFromToken(token)}, std::exchange(quotes, 0));
+    }
+}
+
+void StreamParser::complete(Datum datum, size_t quoteCount) {
+    datum = Parser::quote(std::move(datum), quoteCount);
+    if (stack.empty()) {
+        forms.push_back(std::move(datum));
+        return;
+    }
+    Frame& frame = stack.back();
+    auto cell = makeGC<SExpr>(datum);
+    if (frame.tail == nullptr) {
+        frame.head = cell;
+    } else {
+        frame.tail->cdr = Datum{cell};
+    }
+    frame.tail = cell.get();
+}
+
+size_t StreamParser::partialEnd(std::string_view text) {
+    if (partial.front() == '"') {
+        return scanString(text, partialEscaped);
+    }
+    const size_t end = lexscan::find(text, 0, lexscan::CharClass::Delimiter);
+    return end < text.size() ? end : std::string_view::npos;
+}
+
+size_t StreamParser::scanString(std::string_view body, bool& escaped) {
+    size_t i = escaped ? 1 : 0;
+    while (i < body.size()) {
+        i = lexscan::find(body, i, lexscan::CharClass::StringSpecial);
+        if (i >= body.size()) {
+            break;
+        } else if (body[i] == '"') {
+            escaped = false;
+            return i + 1;
+        }
+        // Step over the escaped character
+        i += 2;
+    }
+    escaped = i == body.size() + 1;
+    return std::string_view::npos;
+}
+
+void StreamParser::feed(std::string_view text) {
+    if (partial.empty()) {
+        consume(text, false);
+        return;
+    } else if (text.empty()) {
+        return;
+    }
+    // The token held back continues into this piece
+    const size_t end = partialEnd(text);
+    if (end == std::string_view::npos) {
+        partial.append(text);
+        return;
+    }
+    partial.append(text.substr(0, end));
+    const std::string token = std::exchange(partial, {});
+    partialEscaped = false;
+    consume(token, true);
+    consume(text.substr(end), false);
+}
+
+void StreamParser::finish() {
+    const std::string last = std::exchange(partial, {});
+    try {
+        consume(last, true);
+        if (inForm()) {
+            throw LispError("Unexpected end of input");
+        }
+    } catch (const LispError&) {
+        reset();
+        throw;
+    }
+}
+
+std::optional<Datum> StreamParser::next() {
+    if (forms.empty()) {
+        return std::nullopt;
+    }
+    Datum form = std::move(forms.front());
+    forms.pop_front();
+    return form;
+}
+
+void StreamParser::reset() {
+    stack.clear();
+    quotes = 0;
+    partial.clear();
+    partialEscaped = false;
+    forms.clear();
+}
@@ -0,0 +1,70 @@
+// (c) Sam Donow 2018
+#pragma once
+#include "core/Lexer.h"
+#include "data/Data.h"
+
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// A parser that is pushed source text in pieces, such as the lines typed at
+/// the REPL or the reads of a pipe, and from which each top level form can be
+/// pulled once it is complete.
+///
+/// The lists being read are kept as a stack of partly built lists between
+/// pieces, so each token is lexed and parsed once however many pieces its form
+/// spans. Only a token that may continue into the next piece is held back, as
+/// text; each later piece is only scanned for where that token ends, so the
+/// input is read in linear time however many pieces a token spans. Every
+/// datum completed at top level is a form, atoms included
+class StreamParser {
+    struct Frame {
+        SExprPtr head{nullptr};
+        SExpr* tail = nullptr;
+        // The number of quotes before the list's open paren
+        size_t quotes = 0;
+    };
+
+    Lexer lex{};
+    std::vector<Frame> stack{};
+    // The number of quotes read since the last datum, to be applied to the next
+    size_t quotes = 0;
+    std::string partial{};
+    // Whether partial is a string ending within an escape, whose next
+    // character is escaped
+    bool partialEscaped = false;
+    std::deque<Datum> forms{};
+
+    /// Lex and parse input; unless it is the last of the input, a token that
+    /// runs to its end is held back as partial
+    void consume(std::string_view input, bool last);
+    void push(const Token& token);
+    /// Where the token held back in partial ends within text, the piece that
+    /// follows it, or npos if it runs past the end of text too
+    size_t partialEnd(std::string_view text);
+    /// Scan the body of a string for its closing quote, as the Lexer does,
+    /// starting within an escape if escaped is set: the index just past the
+    /// quote, or npos, setting escaped to whether the body ends within an escape
+    static size_t scanString(std::string_view body, bool& escaped);
+    /// Add a datum, wrapped in the given number of quotes, to the list being
+    /// read, or to the completed forms if it is at top level
+    void complete(Datum datum, size_t quoteCount);
+
+  public:
+    void feed(std::string_view text);
+
+    /// Mark the end of the input, completing any token held back; throws if a
+    /// form is left incomplete
+    void finish();
+
+    /// The next complete form, if there is one
+    std::optional<Datum> next();
+
+    /// Whether the input so far ends within a form
+    bool inForm() const { return !stack.empty() || quotes != 0 || !partial.empty(); }
+
+    /// Discard all input, such as after an error
+    void reset();
+};
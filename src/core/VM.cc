@@ -0,0 +1,198 @@
+// (c) 2018 Sam Donow
+#include "VM.h"
+#include "core/Evaluator.h"
+#include "util/Util.h"
+
+void VM::enter(Frame& frame, std::vector<Datum>& stack) {
+    const CodeObject& code = *frame.code;
+    if (code.needsEnv) {
+        frame.env = makeGC<SymbolTable>(frame.func->scope(), code.locals);
+        const size_t argc = frame.func->formalParameters.size();
+        for (size_t i = 0; i < argc; ++i) {
+            frame.env->slot(i) = std::move(stack[frame.base + i]);
+        }
+    } else {
+        stack.resize(frame.base + code.locals->size());
+    }
+}
+
+const Datum& VM::loadGlobal(const CodeObject& code, uint32_t index, SymbolTable& scope) {
+    SymbolTable::value_type*& cache = code.globalCache[index];
+    if (cache != nullptr) {
+        return SymbolTable::valueOf(*cache, code.names[index]);
+    }
+    const Symbol name = code.names[index];
+    // The frames of compiled functions cannot gain new names, so if the name
+    // is found in the global scope with only frames in between, it will be
+    // found there on every later lookup
+    bool onlyFrames = true;
+    for (SymbolTable* table = &scope; table != nullptr; table = table->parentScope()) {
+        if (SymbolTable::value_type* binding = table->findHere(name)) {
+            if (onlyFrames && table->parentScope() == nullptr) {
+                cache = binding;
+            }
+            return SymbolTable::valueOf(*binding, name);
+        }
+        onlyFrames = onlyFrames && table->isFrame();
+    }
+    throw LispError("Undefined Symbol: ", name);
+}
+
+GCPtr<LispFunction> VM::makeClosure(const LambdaTemplate& tmpl, const GCPtr<SymbolTable>& env) {
+    std::vector<Symbol> formals = tmpl.formals;
+    GCPtr<LispFunction> closure = makeGC<LispFunction>(std::move(formals), tmpl.definition, env);
+    closure->code = tmpl.code;
+    closure->compiled = true;
+    return closure;
+}
+
+Datum VM::run(const GCPtr<LispFunction>& func, ArgSpan args) {
+    if (depth == contexts.size()) {
+        contexts.emplace_back();
+    }
+    Context& ctx = contexts[depth];
+    std::vector<Datum>& stack = ctx.stack;
+    std::vector<Frame>& frames = ctx.frames;
+    ++depth;
+    ScopeGuard guard{[&] {
+        stack.clear();
+        frames.clear();
+        --depth;
+    }};
+
+    // The stack holds the function being called below its arguments
+    stack.emplace_back(Atom{func});
+    stack.insert(stack.end(), args.begin(), args.end());
+    frames.push_back(Frame{func, func->code.get(), func->scope().get(), 1, 0, nullptr});
+    enter(frames.back(), stack);
+
+    while (true) {
+        Frame& frame = frames.back();
+        const CodeObject& code = *frame.code;
+        const Instruction& ins = code.instructions[frame.pc++];
+        switch (ins.op) {
+        case OpCode::Const:
+            stack.push_back(code.constants[ins.arg]);
+            break;
+        case OpCode::LoadLocal: {
+            Datum val = stack[frame.base + ins.arg];
+            stack.push_back(std::move(val));
+            break;
+        }
+        case OpCode::LoadEnv:
+            stack.push_back(std::get<Datum>(frame.env->slot(ins.arg)));
+            break;
+        case OpCode::LoadFree: {
+            SymbolTable* env = frame.scope;
+            for (uint16_t i = 0; i < ins.arg2; ++i) {
+                env = env->parentScope();
+            }
+            stack.push_back(std::get<Datum>(env->slot(ins.arg)));
+            break;
+        }
+        case OpCode::LoadGlobal:
+            stack.push_back(loadGlobal(code, ins.arg, *frame.scope));
+            break;
+        case OpCode::StoreLocal:
+            stack[frame.base + ins.arg] = std::move(stack.back());
+            stack.pop_back();
+            break;
+        case OpCode::StoreEnv:
+            frame.env->slot(ins.arg) = std::move(stack.back());
+            stack.pop_back();
+            break;
+        case OpCode::DefineFunction:
+            frame.env->slot(ins.arg) = Datum{Atom{makeClosure(code.lambdas[ins.arg2], frame.env)}};
+            break;
+        case OpCode::Pop:
+            stack.pop_back();
+            break;
+        case OpCode::Jump:
+            frame.pc = ins.arg;
+            break;
+        case OpCode::JumpIfFalse:
+        case OpCode::JumpIfTrue: {
+            const bool jumpIf = ins.op == OpCode::JumpIfTrue;
+            const bool cond = stack.back().isTrue();
+            stack.pop_back();
+            if (cond == jumpIf) {
+                frame.pc = ins.arg;
+            }
+            break;
+        }
+        case OpCode::JumpIfFalseOrPop:
+        case OpCode::JumpIfTrueOrPop:
+            if (stack.back().isTrue() == (ins.op == OpCode::JumpIfTrueOrPop)) {
+                frame.pc = ins.arg;
+            } else {
+                stack.pop_back();
+            }
+            break;
+        case OpCode::MatchConst: {
+            const bool match = stack.back().eqv(code.constants[ins.arg]);
+            stack.emplace_back(Atom{match});
+            break;
+        }
+        case OpCode::MakeClosure:
+            stack.emplace_back(Atom{makeClosure(code.lambdas[ins.arg], frame.env)});
+            break;
+        case OpCode::Call:
+        case OpCode::TailCall: {
+            const bool isTail = ins.op == OpCode::TailCall;
+            const size_t argc = ins.arg;
+            const size_t calleePos = stack.size() - argc - 1;
+            const ArgSpan callArgs{&stack[calleePos + 1], argc};
+            const Datum& callee = stack[calleePos];
+            Datum result;
+            if (auto builtin = callee.getAtomicValue<BuiltInFunc*>()) {
+                result = (*builtin)(callArgs, ev);
+            } else if (auto lf = callee.getAtomicValue<GCPtr<LispFunction>>()) {
+                if ((*lf)->formalParameters.size() != argc) {
+                    throw ArityError((*lf)->formalParameters.size(), argc);
+                }
+                const CodeObject* calleeCode = ev.compiledCode(**lf);
+                if (calleeCode == nullptr) {
+                    result = ev.apply(*lf, callArgs);
+                } else if (isTail) {
+                    // Slide the callee and its arguments down over the current frame
+                    const size_t dest = frame.base - 1;
+                    for (size_t i = 0; i <= argc; ++i) {
+                        stack[dest + i] = std::move(stack[calleePos + i]);
+                    }
+                    stack.erase(stack.begin() + static_cast<ptrdiff_t>(dest + argc + 1),
+                                stack.end());
+                    frame = Frame{*lf, calleeCode, (*lf)->scope().get(), frame.base, 0, nullptr};
+                    enter(frame, stack);
+                    break;
+                } else {
+                    frames.push_back(Frame{*lf, calleeCode, (*lf)->scope().get(),
+                                           calleePos + 1, 0, nullptr});
+                    enter(frames.back(), stack);
+                    break;
+                }
+            } else {
+                throw LispError("Can't evaluate non function");
+            }
+            stack.erase(stack.begin() + static_cast<ptrdiff_t>(calleePos), stack.end());
+            stack.push_back(std::move(result));
+            if (!isTail) {
+                break;
+            }
+        }
+        // fallthrough: a tail call of a builtin returns its result
+        [[fallthrough]];
+        case OpCode::Return: {
+            Datum result = std::move(stack.back());
+            stack.erase(stack.begin() + static_cast<ptrdiff_t>(frame.base - 1), stack.end());
+            frames.pop_back();
+            if (frames.empty()) {
+                return result;
+            }
+            stack.push_back(std::move(result));
+            break;
+        }
+        case OpCode::Unset:
+            throw LispError("Invalid instruction");
+        }
+    }
+}
@@ -0,0 +1,52 @@
+// (c) 2018 Sam Donow
+#pragma once
+#include "core/Bytecode.h"
+#include "data/Data.h"
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+/// The VM runs functions that have been compiled to bytecode. Calls between
+/// compiled functions (including tail calls) are handled within the VM loop
+/// without recursion; builtins are called directly on the values on the stack
+class VM {
+    struct Frame {
+        GCPtr<LispFunction> func;
+        const CodeObject* code;
+        // Scope the function was defined in, kept alive by func
+        SymbolTable* scope;
+        // Index into the stack of the first argument
+        size_t base;
+        size_t pc;
+        // Frame holding the variables, for functions whose variables may be
+        // captured by closures; otherwise they are on the stack
+        GCPtr<SymbolTable> env;
+    };
+
+    // A builtin may call back into the evaluator while its arguments are
+    // still on the stack, so each nested run gets its own stack. These are
+    // kept around to be reused by later runs
+    struct Context {
+        std::vector<Datum> stack{};
+        std::vector<Frame> frames{};
+    };
+
+    Evaluator& ev;
+    std::deque<Context> contexts{};
+    size_t depth = 0;
+
+    // Set up the variables of a frame whose arguments have just been pushed
+    static void enter(Frame& frame, std::vector<Datum>& stack);
+    static GCPtr<LispFunction> makeClosure(const LambdaTemplate& tmpl,
+                                           const GCPtr<SymbolTable>& env);
+    static const Datum& loadGlobal(const CodeObject& code, uint32_t index, SymbolTable& scope);
+
+  public:
+    explicit VM(Evaluator& e) : ev(e) {}
+    VM(const VM&) = delete;
+    VM& operator=(const VM&) = delete;
+
+    /// Call a compiled function with the given (already evaluated) arguments
+    Datum run(const GCPtr<LispFunction>& func, ArgSpan args);
+};
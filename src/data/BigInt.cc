@@ -1,150 +1,894 @@
 // (c) Sam Donow 2017
 #include "BigInt.h"
+#include "data/BigIntKernels.h"
+#include "data/Error.h"
 #include "util/Util.h"
 
 #include <algorithm>
+#include <cctype>
+#include <deque>
+#include <functional>
+#include <utility>
+#include <vector>
 
-void BigInt::sumAbsVal(const BigInt& a, const BigInt& b, BigInt& sum) {
+namespace {
+using Digit = uint32_t;
+
+// Operand sizes (in digits) at which multiplication switches from schoolbook to
+// Karatsuba, and from Karatsuba to Toom-3. See bench/BigIntBench.h
+size_t karatsubaThreshold = BigInt::defaultKaratsubaThreshold;
+size_t toom3Threshold = BigInt::defaultToom3Threshold;
+
+// Decimal conversion works 9 decimal digits at a time. Below decimalThreshold
+// digits (of 32 bits), converting one chunk at a time by single digit
+// operations beats dividing and conquering; below newtonThreshold digits, a
+// reciprocal is found by long division. See bench/BigIntBench.h
+constexpr Digit decimalBase = 1'000'000'000;
+constexpr size_t decimalChunk = 9;
+constexpr size_t decimalThreshold = 48;
+constexpr size_t newtonThreshold = 48;
+
+// Append a chunk of exactly 9 decimal digits
+void appendChunk(std::string& out, Digit chunk) {
+    char buf[decimalChunk];
+    for (size_t i = decimalChunk; i-- > 0;) {
+        buf[i] = static_cast<char>('0' + chunk % 10);
+        chunk /= 10;
+    }
+    out.append(buf, decimalChunk);
+}
+
+// Stein's binary GCD
+uint64_t binaryGcd(uint64_t a, uint64_t b) {
+    if (a == 0 || b == 0) {
+        return a | b;
+    }
+    const int shift = __builtin_ctzll(a | b);
+    a >>= __builtin_ctzll(a);
+    do {
+        b >>= __builtin_ctzll(b);
+        if (a > b) {
+            std::swap(a, b);
+        }
+        b -= a;
+    } while (b != 0);
+    return a << shift;
+}
+
+// (a, b) = (x a + y b, z a + w b) in place for a, b of n digits, where the
+// cofactors come from a Lehmer step, so that both results are non-negative
+void lehmerStep(Digit* a, Digit* b, size_t n, int64_t x, int64_t y, int64_t z, int64_t w) {
+    __extension__ using Wide = __int128;
+    Wide aCarry = 0;
+    Wide bCarry = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const Wide aDigit = a[i];
+        const Wide bDigit = b[i];
+        aCarry += x * aDigit + y * bDigit;
+        bCarry += z * aDigit + w * bDigit;
+        a[i] = static_cast<Digit>(aCarry);
+        b[i] = static_cast<Digit>(bCarry);
+        aCarry >>= 32;
+        bCarry >>= 32;
+    }
+}
+
+Digit parseChunk(std::string_view digits) {
+    Digit chunk = 0;
+    for (char c : digits) {
+        chunk = chunk * 10 + static_cast<Digit>(c - '0');
+    }
+    return chunk;
+}
+
+// -m^-1 mod 2^32 for odd m, by Newton's method, which doubles the number of
+// correct low bits each step from the 3 of m itself (m m = 1 mod 8)
+Digit montgomeryInverse(Digit m) {
+    Digit inverse = m;
+    for (int i = 0; i < 4; ++i) {
+        inverse *= 2 - m * inverse;
+    }
+    return 0 - inverse;
+}
+
+// Montgomery reduction (REDC): for t[0, 2n + 1) less than m 2^(32n), add
+// multiples of m to clear the low n digits, leaving t[n, 2n + 1) congruent to
+// t 2^(-32n) mod m and less than 2m
+void montgomeryReduce(Digit* t, const Digit* m, size_t n, Digit mInv) {
+    for (size_t i = 0; i < n; ++i) {
+        const uint64_t u = static_cast<Digit>(t[i] * mInv);
+        uint64_t carry = 0;
+        for (size_t j = 0; j < n; ++j) {
+            const uint64_t digitProd = m[j] * u + t[i + j] + carry;
+            t[i + j] = static_cast<Digit>(digitProd);
+            carry = digitProd >> 32;
+        }
+        for (size_t j = i + n; carry != 0; ++j) {
+            const uint64_t digitSum = uint64_t{t[j]} + carry;
+            t[j] = static_cast<Digit>(digitSum);
+            carry = digitSum >> 32;
+        }
+    }
+}
+
+// a[0, an) += b[0, bn) for bn <= an, returning the carry out of the top digit
+Digit addInto(Digit* a, size_t an, const Digit* b, size_t bn) {
+    return kernels::active.addInto(a, an, b, bn);
+}
+
+// a[0, an) -= b[0, bn) for bn <= an, returning the borrow out of the top digit
+Digit subInto(Digit* a, size_t an, const Digit* b, size_t bn) {
+    return kernels::active.subInto(a, an, b, bn);
+}
+
+// a[0, n) = b[0, n) - a[0, n), where a < b
+void subFromInto(Digit* a, const Digit* b, size_t n) {
+    uint64_t borrow = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const uint64_t digitDiff = uint64_t{b[i]} - a[i] - borrow;
+        a[i] = static_cast<Digit>(digitDiff);
+        borrow = digitDiff >> 63;
+    }
+}
+
+// a[0, n) *= m, returning the carry out of the top digit
+Digit mulDigitInto(Digit* a, size_t n, Digit m) {
     uint64_t carry = 0;
-    if (a.data.size() < b.data.size()) {
-        sumAbsVal(b, a, sum);
+    for (size_t i = 0; i < n; ++i) {
+        const uint64_t digitProd = uint64_t{a[i]} * m + carry;
+        a[i] = static_cast<Digit>(digitProd);
+        carry = digitProd >> 32;
+    }
+    return static_cast<Digit>(carry);
+}
+
+// out[0, an + 1) = a[0, an) + b[0, bn) for bn <= an
+void addDigits(const Digit* a, size_t an, const Digit* b, size_t bn, Digit* out) {
+    std::copy(a, a + an, out);
+    out[an] = addInto(out, an, b, bn);
+}
+
+// out[0, an + bn) = a[0, an) * b[0, bn), accumulating each row in place
+void mulSchoolbook(const Digit* a, size_t an, const Digit* b, size_t bn, Digit* out) {
+    kernels::active.mulSchoolbook(a, an, b, bn, out);
+}
+
+// The scratch space needed by mulKaratsuba for operands of n digits
+size_t karatsubaScratch(size_t n) {
+    size_t total = 0;
+    while (n >= karatsubaThreshold) {
+        const size_t high = n - n / 2;
+        total += 4 * (high + 1);
+        n = high + 1;
+    }
+    return total;
+}
+
+// out[0, 2n) = a[0, n) * b[0, n)
+void mulKaratsuba(const Digit* a, const Digit* b, size_t n, Digit* out, Digit* scratch) {
+    if (n < karatsubaThreshold) {
+        mulSchoolbook(a, n, b, n, out);
         return;
     }
-    sum.data.reserve(a.data.size() + 1);
-    auto aIt = a.data.begin();
-    for (auto bIt = b.data.begin(); bIt != b.data.end(); ++aIt, ++bIt) {
-        const uint64_t digitSum =
-            static_cast<uint64_t>(*aIt) + static_cast<uint64_t>(*bIt) + carry;
-        sum.data.emplace_back(digitSum & MAX_DIGIT);
-        carry = digitSum / MAX_DIGIT;
+    // With x = 2^(32 low): a = a1 x + a0, b = b1 x + b0, and
+    // ab = a1 b1 x^2 + ((a0 + a1)(b0 + b1) - a0 b0 - a1 b1) x + a0 b0
+    const size_t low = n / 2;
+    const size_t high = n - low;
+    mulKaratsuba(a, b, low, out, scratch);
+    mulKaratsuba(a + low, b + low, high, out + 2 * low, scratch);
+
+    Digit* aSum = scratch;
+    Digit* bSum = aSum + high + 1;
+    Digit* middle = bSum + high + 1;
+    addDigits(a + low, high, a, low, aSum);
+    addDigits(b + low, high, b, low, bSum);
+    mulKaratsuba(aSum, bSum, high + 1, middle, middle + 2 * (high + 1));
+    subInto(middle, 2 * (high + 1), out, 2 * low);
+    subInto(middle, 2 * (high + 1), out + 2 * low, 2 * high);
+    addInto(out + low, 2 * n - low, middle, 2 * (high + 1));
+}
+
+// out[0, an + bn) = a[0, an) * b[0, bn), by schoolbook or Karatsuba
+void mulDigits(const Digit* a, size_t an, const Digit* b, size_t bn, Digit* out) {
+    if (an < bn) {
+        mulDigits(b, bn, a, an, out);
+        return;
+    } else if (bn < karatsubaThreshold) {
+        mulSchoolbook(a, an, b, bn, out);
+        return;
     }
-    uint32_t bExt = b.isNegative ? 0U : MAX_DIGIT;
-    for (; aIt != a.data.end(); ++aIt) {
-        const uint64_t digitSum = static_cast<uint64_t>(*aIt) + bExt + carry;
-        sum.data.emplace_back(digitSum & MAX_DIGIT);
-        carry = digitSum >> 32;
+    const size_t scratchSize = karatsubaScratch(bn);
+    std::vector<Digit> scratch(scratchSize + (an == bn ? 0 : 2 * bn));
+    if (an == bn) {
+        mulKaratsuba(a, b, bn, out, scratch.data());
+        return;
+    }
+    // Multiply b by each bn-digit chunk of a, adding the chunks up in place
+    Digit* chunk = scratch.data() + scratchSize;
+    std::fill(out, out + an + bn, 0);
+    size_t i = 0;
+    for (; i + bn <= an; i += bn) {
+        mulKaratsuba(a + i, b, bn, chunk, scratch.data());
+        addInto(out + i, an + bn - i, chunk, 2 * bn);
     }
-    if (carry != 0) {
-        sum.data.emplace_back(carry);
+    if (i < an) {
+        std::vector<Digit> tail(an - i + bn);
+        mulDigits(b, bn, a + i, an - i, tail.data());
+        addInto(out + i, an + bn - i, tail.data(), tail.size());
     }
 }
 
-void BigInt::mulAbsVal(const BigInt& a, const BigInt& b, BigInt& prod) {
-    if (a.data.size() < b.data.size()) {
-        mulAbsVal(b, a, prod);
-        return;
+// Divide u[0, n) by the single digit v, storing the quotient in q[0, n) and
+// returning the remainder
+Digit divDigit(const Digit* u, size_t n, Digit v, Digit* q) {
+    uint64_t remainder = 0;
+    for (size_t i = n; i-- > 0;) {
+        const uint64_t current = (remainder << 32) | u[i];
+        q[i] = static_cast<Digit>(current / v);
+        remainder = current % v;
     }
-    std::vector<BigInt> parts;
-    for (auto bIt = b.data.begin(); bIt != b.data.end(); ++bIt) {
-        BigInt& current = parts.emplace_back(BigInt{empty_construct{}});
-        for (auto cIt = b.data.begin(); cIt != bIt; ++cIt) {
-            current.data.push_back(0);
+    return static_cast<Digit>(remainder);
+}
+
+// Knuth's Algorithm D (TAOCP 4.3.1): divide u[0, un) by v[0, n), where n >= 2,
+// un >= n and v[n - 1] != 0. Stores the quotient in q[0, un - n + 1) and the
+// remainder in r[0, n)
+void divKnuth(const Digit* u, size_t un, const Digit* v, size_t n, Digit* q, Digit* r) {
+    constexpr uint64_t base = uint64_t{1} << 32;
+    // Normalize, so that the top digit of the divisor has its high bit set and
+    // the estimates of each quotient digit from the top two digits are at
+    // most 2 too large
+    const int shift = __builtin_clz(v[n - 1]);
+    auto shifted = [shift](Digit high, Digit low) {
+        return shift == 0 ? high : static_cast<Digit>((high << shift) | (low >> (32 - shift)));
+    };
+    std::vector<Digit> vn(n);
+    std::vector<Digit> un_(un + 1);
+    for (size_t i = n - 1; i > 0; --i) {
+        vn[i] = shifted(v[i], v[i - 1]);
+    }
+    vn[0] = v[0] << shift;
+    un_[un] = shifted(0, u[un - 1]);
+    for (size_t i = un - 1; i > 0; --i) {
+        un_[i] = shifted(u[i], u[i - 1]);
+    }
+    un_[0] = u[0] << shift;
+
+    for (size_t j = un - n + 1; j-- > 0;) {
+        const uint64_t top = (uint64_t{un_[j + n]} << 32) | un_[j + n - 1];
+        uint64_t qhat = top / vn[n - 1];
+        uint64_t rhat = top % vn[n - 1];
+        while (qhat >= base || qhat * vn[n - 2] > ((rhat << 32) | un_[j + n - 2])) {
+            --qhat;
+            rhat += vn[n - 1];
+            if (rhat >= base) {
+                break;
+            }
         }
+
+        // Subtract qhat times the divisor from the current digits
         uint64_t carry = 0;
-        for (auto aIt = a.data.begin(); aIt != a.data.end(); ++aIt) {
-            const uint64_t digitProd =
-                (static_cast<uint64_t>(*aIt) * static_cast<uint64_t>(*bIt)) + carry;
-            current.data.emplace_back(digitProd % MAX_DIGIT);
-            carry = digitProd / MAX_DIGIT;
+        uint64_t borrow = 0;
+        for (size_t i = 0; i < n; ++i) {
+            const uint64_t prod = qhat * vn[i] + carry;
+            carry = prod >> 32;
+            const uint64_t digitDiff =
+                uint64_t{un_[i + j]} - static_cast<Digit>(prod) - borrow;
+            un_[i + j] = static_cast<Digit>(digitDiff);
+            borrow = digitDiff >> 63;
+        }
+        const uint64_t topDiff = uint64_t{un_[j + n]} - carry - borrow;
+        un_[j + n] = static_cast<Digit>(topDiff);
+
+        // Rarely, qhat is still one too large: add the divisor back
+        if ((topDiff >> 63) != 0) {
+            --qhat;
+            addInto(un_.data() + j, n + 1, vn.data(), n);
         }
+        q[j] = static_cast<Digit>(qhat);
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        r[i] = shift == 0 ? un_[i]
+                          : static_cast<Digit>((un_[i] >> shift) | (un_[i + 1] << (32 - shift)));
+    }
+}
+}
+
+bool BigInt::setKernels(Kernels kind) {
+    if (!kernels::supported(kind)) {
+        return false;
+    }
+    kernels::select(kind);
+    return true;
+}
+
+BigInt::Kernels BigInt::activeKernels() {
+    return kernels::activeKind;
+}
+
+void BigInt::setMulThresholds(size_t karatsuba, size_t toom3) {
+    // Karatsuba only shrinks the operands from 4 digits up
+    karatsubaThreshold = std::max<size_t>(karatsuba, 4);
+    toom3Threshold = std::max<size_t>(toom3, 3);
+}
+
+void BigInt::sumAbsVal(const BigInt& a, const BigInt& b, BigInt& sum) {
+    if (a.data.size() < b.data.size()) {
+        sumAbsVal(b, a, sum);
+        return;
+    }
+    sum.data.resize(a.data.size() + 1);
+    addDigits(a.data.begin(), a.data.size(), b.data.begin(), b.data.size(), sum.data.data());
+}
+
+void BigInt::addInPlace(const BigInt& other, bool otherNegative) {
+    const size_t n = data.size();
+    const size_t otherSize = other.data.size();
+    if (isNegative == otherNegative) {
+        // If other is this, resizing extends it with zeroes as well
+        data.resize(std::max(n, otherSize) + 1);
+        addInto(data.data(), data.size(), other.data.begin(), otherSize);
+    } else if (compareAbsVal(*this, other) >= 0) {
+        subInto(data.data(), n, other.data.begin(), otherSize);
+    } else {
+        data.resize(otherSize);
+        subFromInto(data.data(), other.data.begin(), otherSize);
+        isNegative = otherNegative;
+    }
+    canonicalize();
+}
+
+BigInt& BigInt::operator*=(const BigInt& other) {
+    const bool negative = !sameSign(other);
+    if (other.data.size() == 1) {
+        // Multiply by a single digit in place
+        const Digit carry = mulDigitInto(data.data(), data.size(), other.data[0]);
         if (carry != 0) {
-            current.data.emplace_back(carry);
+            data.push_back(carry);
+        }
+    } else if (data.size() == 1) {
+        const Digit digit = data[0];
+        data = other.data;
+        const Digit carry = mulDigitInto(data.data(), data.size(), digit);
+        if (carry != 0) {
+            data.push_back(carry);
+        }
+    } else {
+        BigInt prod{empty_construct{}};
+        mulAbsVal(*this, other, prod);
+        data = std::move(prod.data);
+    }
+    canonicalize();
+    isNegative = negative && !isZero();
+    return *this;
+}
+
+void BigInt::mulAbsVal(const BigInt& a, const BigInt& b, BigInt& prod) {
+    const size_t an = a.data.size();
+    const size_t bn = b.data.size();
+    if (std::min(an, bn) >= toom3Threshold && std::max(an, bn) < 2 * std::min(an, bn)) {
+        toom3AbsVal(a, b, prod);
+        return;
+    }
+    prod.data.resize(an + bn);
+    mulDigits(a.data.begin(), an, b.data.begin(), bn, prod.data.data());
+}
+
+BigInt BigInt::digitRange(size_t start, size_t count) const {
+    BigInt ret{empty_construct{}};
+    const size_t end = std::min(start + count, data.size());
+    if (start < end) {
+        ret.data.insert(ret.data.end(), data.begin() + start, data.begin() + end);
+    }
+    ret.canonicalize();
+    return ret;
+}
+
+template<uint32_t divisor>
+BigInt BigInt::divExact(BigInt value) {
+    uint64_t remainder = 0;
+    for (auto it = value.data.rbegin(); it != value.data.rend(); ++it) {
+        const uint64_t current = (remainder << 32) | *it;
+        *it = static_cast<uint32_t>(current / divisor);
+        remainder = current % divisor;
+    }
+    value.canonicalize();
+    return value;
+}
+
+void BigInt::toom3AbsVal(const BigInt& a, const BigInt& b, BigInt& prod) {
+    // Split both into three parts of k digits: with x = 2^(32k),
+    // a = a2 x^2 + a1 x + a0, and likewise for b. The product is a degree 4
+    // polynomial in x, found from its values at 0, 1, -1, -2 and infinity
+    const size_t k = (std::max(a.data.size(), b.data.size()) + 2) / 3;
+    const BigInt a0 = a.digitRange(0, k), a1 = a.digitRange(k, k), a2 = a.digitRange(2 * k, k);
+    const BigInt b0 = b.digitRange(0, k), b1 = b.digitRange(k, k), b2 = b.digitRange(2 * k, k);
+
+    const BigInt aEven = a0 + a2;
+    const BigInt aAt1 = aEven + a1;
+    const BigInt aAtMinus1 = aEven - a1;
+    const BigInt aAtMinus2 = (aAtMinus1 + a2) + (aAtMinus1 + a2) - a0;
+    const BigInt bEven = b0 + b2;
+    const BigInt bAt1 = bEven + b1;
+    const BigInt bAtMinus1 = bEven - b1;
+    const BigInt bAtMinus2 = (bAtMinus1 + b2) + (bAtMinus1 + b2) - b0;
+
+    const BigInt r0 = a0 * b0;
+    const BigInt r1 = aAt1 * bAt1;
+    const BigInt rMinus1 = aAtMinus1 * bAtMinus1;
+    const BigInt rMinus2 = aAtMinus2 * bAtMinus2;
+    const BigInt rInf = a2 * b2;
+
+    // Interpolation, following Bodrato's sequence
+    BigInt c3 = divExact<3>(rMinus2 - r1);
+    BigInt c1 = divExact<2>(r1 - rMinus1);
+    BigInt c2 = rMinus1 - r0;
+    c3 = divExact<2>(c2 - c3) + rInf + rInf;
+    c2 = c2 + c1 - rInf;
+    c1 = c1 - c3;
+
+    // The coefficients are all non-negative; add them up in place at their
+    // offsets
+    const size_t size = a.data.size() + b.data.size();
+    prod.data.clear();
+    prod.data.resize(size);
+    const BigInt* coefficients[] = {&r0, &c1, &c2, &c3, &rInf};
+    for (size_t i = 0; i < 5; ++i) {
+        const BigInt& coefficient = *coefficients[i];
+        if (coefficient.isZero()) {
+            continue;
         }
+        addInto(prod.data.data() + i * k, size - i * k, coefficient.data.begin(),
+                coefficient.data.size());
     }
-    prod = std::accumulate(parts.begin(), parts.end(), BigInt{});
 }
 
 void BigInt::diffAbsVal(const BigInt& a, const BigInt& b, BigInt& diff) {
-    if (auto cmp = a.compare(-b); cmp == 0) {
+    if (auto cmp = compareAbsVal(a, b); cmp == 0) {
         return;
     } else if (cmp < 0) {
         diffAbsVal(b, a, diff);
         diff.isNegative = true;
         return;
     }
+    diff.data.resize(a.data.size());
+    std::copy(a.data.begin(), a.data.end(), diff.data.begin());
+    subInto(diff.data.data(), a.data.size(), b.data.begin(), b.data.size());
+}
 
-    uint32_t carry = 0;
-    auto aIt = a.data.begin();
-    for (auto bIt = b.data.begin(); bIt != b.data.end(); ++aIt, ++bIt) {
-        const uint32_t aDig = *aIt - carry;
-        if (aDig >= *bIt) {
-            diff.data.emplace_back(aDig - *bIt);
-            carry = carry == 1 && *aIt == 0 ? 1 : 0;
-        } else {
-            carry = 1;
-            // Parentheses prevent overflow; wrapping would yield the correct answer, but
-            // this is nicer at least conceptually
-            diff.data.emplace_back((MAX_DIGIT - *bIt) + *aIt);
+void BigInt::divModAbsVal(const BigInt& dividend, const BigInt& divisor, BigInt& quot,
+                          BigInt& rem) {
+    const size_t n = divisor.data.size();
+    if (unlikely(n == 1 && divisor.data[0] == 0)) {
+        throw LispError("Division by zero");
+    }
+    if (compareAbsVal(dividend, divisor) < 0) {
+        quot = BigInt{};
+        rem = dividend.abs();
+        return;
+    }
+    const size_t un = dividend.data.size();
+    quot.data.clear();
+    rem.data.clear();
+    quot.isNegative = false;
+    rem.isNegative = false;
+    if (n == 1) {
+        // A single digit divisor needs no quotient digit estimates
+        quot.data.resize(un);
+        rem.data.push_back(divDigit(dividend.data.begin(), un, divisor.data[0], quot.data.data()));
+    } else {
+        quot.data.resize(un - n + 1);
+        rem.data.resize(n);
+        divKnuth(dividend.data.begin(), un, divisor.data.begin(), n, quot.data.data(),
+                 rem.data.data());
+        rem.canonicalize();
+    }
+    quot.canonicalize();
+}
+
+struct BigInt::DecimalPower {
+    BigInt value;
+    // floor(2^(64m) / value), where value has m digits; found on first use
+    std::optional<BigInt> reciprocal;
+};
+
+BigInt::DecimalPower& BigInt::decimalPower(size_t level) {
+    // A deque, so that references to the powers stay valid as more are added
+    static std::deque<DecimalPower> powers;
+    if (powers.empty()) {
+        powers.push_back(DecimalPower{BigInt{decimalBase}, std::nullopt});
+    }
+    while (powers.size() <= level) {
+        const BigInt& last = powers.back().value;
+        powers.push_back(DecimalPower{last * last, std::nullopt});
+    }
+    return powers[level];
+}
+
+BigInt BigInt::shiftedDigits(size_t count) const {
+    BigInt ret = *this;
+    if (count != 0 && !isZero()) {
+        ret.data.insert(ret.data.begin(), count, 0);
+    }
+    return ret;
+}
+
+BigInt BigInt::reciprocal(const BigInt& d) {
+    const size_t m = d.data.size();
+    const BigInt scale = BigInt{1U}.shiftedDigits(2 * m);
+    if (m <= newtonThreshold) {
+        return scale / d;
+    }
+    // Start from the reciprocal of the top digits of d. With two guard digits,
+    // one Newton step leaves x within a few units of the result
+    const size_t h = m / 2 + 2;
+    BigInt x = reciprocal(d.digitRange(m - h, h)).shiftedDigits(m - h);
+    const BigInt error = scale - d * x;
+    const BigInt step = (x * error.abs()).digitRange(2 * m, x.data.size() + error.data.size());
+    x = error.isNegative ? x - step : x + step;
+
+    BigInt rem = scale - d * x;
+    while (rem.isNegative) {
+        x -= BigInt{1U};
+        rem += d;
+    }
+    while (rem >= d) {
+        x += BigInt{1U};
+        rem -= d;
+    }
+    return x;
+}
+
+void BigInt::divModPower(const BigInt& value, DecimalPower& power, BigInt& quot,
+                         BigInt& rem) {
+    const BigInt& d = power.value;
+    const size_t m = d.data.size();
+    if (!power.reciprocal) {
+        power.reciprocal = reciprocal(d);
+    }
+    // As value < 2^(64m), this estimate is at most 2 too small
+    const BigInt estimate = value.digitRange(m - 1, value.data.size()) * *power.reciprocal;
+    quot = estimate.digitRange(m + 1, estimate.data.size());
+    rem = value - quot * d;
+    while (rem >= d) {
+        rem -= d;
+        quot += BigInt{1U};
+    }
+}
+
+void BigInt::appendDecimal(const BigInt& value, size_t level, bool pad, std::string& out) {
+    if (level == 0 || value.data.size() <= decimalThreshold) {
+        // Peel off 9 decimal digits at a time, taking each chunk straight from
+        // the remainder of the single digit division
+        std::vector<Digit> digits(value.data.begin(), value.data.end());
+        std::vector<Digit> chunks;
+        size_t n = digits.size();
+        do {
+            chunks.push_back(divDigit(digits.data(), n, decimalBase, digits.data()));
+            while (n > 1 && digits[n - 1] == 0) {
+                --n;
+            }
+        } while (n > 1 || digits[0] != 0);
+
+        const std::string top = std::to_string(chunks.back());
+        if (pad) {
+            const size_t length = top.size() + decimalChunk * (chunks.size() - 1);
+            out.append((decimalChunk << (level + 1)) - length, '0');
+        }
+        out += top;
+        for (size_t i = chunks.size() - 1; i-- > 0;) {
+            appendChunk(out, chunks[i]);
+        }
+        return;
+    }
+    BigInt high{empty_construct{}};
+    BigInt low{empty_construct{}};
+    divModPower(value, decimalPower(level), high, low);
+    if (high.isZero()) {
+        if (pad) {
+            out.append(decimalChunk << level, '0');
         }
+    } else {
+        appendDecimal(high, level - 1, pad, out);
+        pad = true;
+    }
+    appendDecimal(low, level - 1, pad, out);
+}
+
+std::string BigInt::toString() const {
+    std::string out;
+    if (isNegative) {
+        out += '-';
     }
-    for (; aIt != a.data.end(); ++aIt) {
-        const uint32_t aDig = *aIt - carry;
-        diff.data.emplace_back(aDig);
-        carry = carry == 1 && *aIt == 0 ? 1 : 0;
+    if (data.size() <= decimalThreshold) {
+        appendDecimal(*this, 0, false, out);
+        return out;
     }
+    // Split by the smallest power whose square is larger than the value
+    size_t level = 0;
+    while (data.size() + 2 > 2 * decimalPower(level).value.data.size()) {
+        ++level;
+    }
+    appendDecimal(abs(), level, false, out);
+    return out;
 }
 
-uint32_t BigInt::divisionDigit(const BigInt& dividend, const BigInt& divisor) {
-    return util::binSearch<uint32_t>([&](uint32_t value) {
-        // TODO: define operator*(uint32_t) so this doesn't involve an
-        // unnecssary vector construction?
-        BigInt c{value};
-        BigInt r = dividend - (divisor * c);
-        if (r.isNegative) {
-            return 1;
-        } else if (r < divisor) {
-            return 0;
-        } else {
-            return -1;
+BigInt BigInt::parseDecimal(std::string_view digits) {
+    if (digits.size() <= decimalChunk * decimalThreshold) {
+        // Multiply in 9 decimal digits at a time, in place
+        BigInt ret{empty_construct{}};
+        ret.data.push_back(0);
+        size_t chunkLength = digits.size() % decimalChunk;
+        if (chunkLength == 0) {
+            chunkLength = decimalChunk;
         }
-    });
+        for (size_t pos = 0; pos < digits.size(); pos += chunkLength, chunkLength = decimalChunk) {
+            uint64_t carry = parseChunk(digits.substr(pos, chunkLength));
+            for (Digit& digit : ret.data) {
+                const uint64_t digitProd = uint64_t{digit} * decimalBase + carry;
+                digit = static_cast<Digit>(digitProd);
+                carry = digitProd >> 32;
+            }
+            if (carry != 0) {
+                ret.data.push_back(static_cast<Digit>(carry));
+            }
+        }
+        ret.canonicalize();
+        return ret;
+    }
+    // Split off the low 9 * 2^k digits, for the largest such length below the
+    // total, and combine the halves with the cached power
+    size_t level = 0;
+    while ((decimalChunk << (level + 1)) < digits.size()) {
+        ++level;
+    }
+    const size_t lowLength = decimalChunk << level;
+    const BigInt high = parseDecimal(digits.substr(0, digits.size() - lowLength));
+    const BigInt low = parseDecimal(digits.substr(digits.size() - lowLength));
+    return high * decimalPower(level).value + low;
 }
 
-void BigInt::divAbsVal(const BigInt& dividend, const BigInt& divisor_, BigInt& ret) {
-    BigInt currentGrouping{empty_construct{}};
-    const BigInt divisor = divisor_.abs();
-    for (uint32_t digit : dividend.data) {
-        currentGrouping.data.insert(currentGrouping.data.begin(), digit);
-        if (divisor > currentGrouping) {
-            if (!ret.data.empty()) {
-                // Don't add leading zeroes
-                ret.data.push_back(0);
+BigInt BigInt::fromString(std::string_view str) {
+    bool negative = false;
+    std::string_view digits = str;
+    if (!digits.empty() && (digits.front() == '-' || digits.front() == '+')) {
+        negative = digits.front() == '-';
+        digits.remove_prefix(1);
+    }
+    if (digits.empty() || !std::all_of(digits.begin(), digits.end(),
+                                       [](char c) { return std::isdigit(c) != 0; })) {
+        throw LispError("Invalid integer: ", str);
+    }
+    BigInt ret = parseDecimal(digits);
+    return negative ? -ret : ret;
+}
+
+BigInt BigInt::gcd(BigInt a, BigInt b) {
+    a.isNegative = false;
+    b.isNegative = false;
+    if (compareAbsVal(a, b) < 0) {
+        std::swap(a, b);
+    }
+    while (b.data.size() > 2) {
+        // Run Euclid's algorithm on the leading 32 bits of a and the bits of b in
+        // the same position, for as long as the quotients are certain to match
+        // those of the full values (Knuth's Algorithm L, TAOCP 4.5.2)
+        const size_t n = a.data.size();
+        const int shift = __builtin_clz(a.data[n - 1]);
+        auto leading = [n, shift](const BigInt& value) {
+            auto digit = [&value](size_t i) {
+                return i < value.data.size() ? uint64_t{value.data[i]} : 0;
+            };
+            const uint64_t top = (digit(n - 1) << 32) | digit(n - 2);
+            const uint64_t next = shift == 0 ? 0 : digit(n - 3) >> (32 - shift);
+            return static_cast<int64_t>(((top << shift) | next) >> 32);
+        };
+        int64_t aHat = leading(a);
+        int64_t bHat = leading(b);
+        int64_t x = 1, y = 0, z = 0, w = 1;
+        while (bHat + z > 0 && bHat + w > 0) {
+            const int64_t q = (aHat + x) / (bHat + z);
+            if (q <= 0 || q != (aHat + y) / (bHat + w)) {
+                break;
             }
+            x = std::exchange(z, x - q * z);
+            y = std::exchange(w, y - q * w);
+            aHat = std::exchange(bHat, aHat - q * bHat);
+        }
+        if (y == 0) {
+            // No quotient was certain: take a step of Euclid's algorithm on the
+            // full values
+            BigInt rem = a % b;
+            a = std::move(b);
+            b = std::move(rem);
         } else {
-            uint32_t div = divisionDigit(currentGrouping, divisor);
-            ret.data.push_back(div);
-            currentGrouping -= divisor * BigInt{div};
+            b.data.resize(n);
+            lehmerStep(a.data.data(), b.data.data(), n, x, y, z, w);
+            a.canonicalize();
+            b.canonicalize();
         }
     }
-    // we added the digits front to back
-    std::reverse(ret.data.begin(), ret.data.end());
+    if (b.isZero()) {
+        return a;
+    }
+    if (a.data.size() > 2) {
+        a = a % b;
+    }
+    return BigInt{binaryGcd(static_cast<uint64_t>(a), static_cast<uint64_t>(b))};
 }
 
-std::pair<BigInt, uint32_t> BigInt::divAndMod(uint32_t modulus) {
-    BigInt ret{empty_construct{}};
-    uint64_t digiPair = 0;
-    for (uint32_t digit : data) {
-        digiPair <<= 32;
-        digiPair += digit;
-        if (modulus > digiPair) {
-            if (!ret.data.empty()) {
-                ret.data.push_back(0);
+BigInt BigInt::sqrt() const {
+    if (unlikely(isNegative)) {
+        throw LispError("Square root of a negative integer");
+    } else if (isZero()) {
+        return *this;
+    }
+    // Newton's method from 2^ceil(bits / 2), which is at least the root; the
+    // iterates decrease until they reach it
+    BigInt x = BigInt{1U} << ((bitLength() + 1) / 2);
+    while (true) {
+        BigInt next = (x + *this / x) >> 1;
+        if (next >= x) {
+            return x;
+        }
+        x = std::move(next);
+    }
+}
+
+BigInt BigInt::modPow(const BigInt& base, const BigInt& exponent, const BigInt& modulus) {
+    if (unlikely(modulus.isNegative || modulus.isZero())) {
+        throw LispError("Modulus must be positive");
+    } else if (unlikely(exponent.isNegative)) {
+        throw LispError("Exponent must be non-negative");
+    } else if (modulus == BigInt{1U}) {
+        return BigInt{};
+    }
+    BigInt b = base % modulus;
+    if (b.isNegative) {
+        b += modulus;
+    }
+    auto bitAt = [&exponent](size_t i) { return (exponent.data[i / 32] >> (i % 32)) & 1; };
+    const size_t bits = exponent.bitLength();
+    if ((modulus.data[0] & 1) == 0) {
+        BigInt result{1U};
+        for (size_t i = bits; i-- > 0;) {
+            result = result * result % modulus;
+            if (bitAt(i)) {
+                result = result * b % modulus;
             }
-        } else {
-            uint64_t div = digiPair / modulus;
-            ret.data.push_back(static_cast<uint32_t>(div));
-            digiPair -= div * static_cast<uint64_t>(modulus);
         }
+        return result;
+    }
+    // Values are held as x R mod m, for R = 2^(32n), whose products are reduced
+    // by dividing by R rather than by m
+    const size_t n = modulus.data.size();
+    const Digit mInv = montgomeryInverse(modulus.data[0]);
+    auto montgomeryMul = [&](const BigInt& x, const BigInt& y) {
+        BigInt t = x * y;
+        t.data.resize(2 * n + 1);
+        montgomeryReduce(t.data.begin(), modulus.data.begin(), n, mInv);
+        t.data.erase(t.data.begin(), t.data.begin() + n);
+        t.canonicalize();
+        if (t >= modulus) {
+            t -= modulus;
+        }
+        return t;
+    };
+    const BigInt bR = b.shiftedDigits(n) % modulus;
+    BigInt x = BigInt{1U}.shiftedDigits(n) % modulus;
+    for (size_t i = bits; i-- > 0;) {
+        x = montgomeryMul(x, x);
+        if (bitAt(i)) {
+            x = montgomeryMul(x, bR);
+        }
+    }
+    return montgomeryMul(x, BigInt{1U});
+}
+
+uint64_t BigInt::hash() const noexcept {
+    uint64_t h = util::hashMix(isNegative);
+    for (const uint32_t digit : data) {
+        h = util::hashCombine(h, digit);
     }
-    std::reverse(ret.data.begin(), ret.data.end());
-    BigInt mod = *this - (ret * BigInt{static_cast<int>(modulus)});
-    return {ret, mod.data[0]};
+    return h;
+}
+
+size_t BigInt::bitLength() const noexcept {
+    if (isZero()) {
+        return 0;
+    }
+    return 32 * data.size() - static_cast<size_t>(__builtin_clz(data.back()));
+}
+
+template<typename Op>
+BigInt BigInt::bitwise(const BigInt& a, const BigInt& b, Op op) {
+    // The extra digit holds only sign bits, and so gives the sign of the result
+    const size_t n = std::max(a.data.size(), b.data.size()) + 1;
+    BigInt ret{empty_construct{}};
+    ret.data.resize(n);
+    // A negative value is ~(|x| - 1) in two's complement
+    auto twosDigit = [](const BigInt& x, size_t i, uint64_t& borrow) {
+        const uint64_t digitDiff = uint64_t{i < x.data.size() ? x.data[i] : 0} - borrow;
+        borrow = digitDiff >> 63;
+        const Digit digit = static_cast<Digit>(digitDiff);
+        return x.isNegative ? static_cast<Digit>(~digit) : digit;
+    };
+    uint64_t borrowA = a.isNegative;
+    uint64_t borrowB = b.isNegative;
+    for (size_t i = 0; i < n; ++i) {
+        const Digit aDigit = twosDigit(a, i, borrowA);
+        ret.data[i] = op(aDigit, twosDigit(b, i, borrowB));
+    }
+    const bool negative = (ret.data[n - 1] >> 31) != 0;
+    if (negative) {
+        uint64_t carry = 1;
+        for (Digit& digit : ret.data) {
+            const uint64_t digitSum = uint64_t{static_cast<Digit>(~digit)} + carry;
+            digit = static_cast<Digit>(digitSum);
+            carry = digitSum >> 32;
+        }
+    }
+    ret.canonicalize();
+    ret.isNegative = negative && !ret.isZero();
+    return ret;
+}
+
+BigInt BigInt::operator&(const BigInt& other) const {
+    return bitwise(*this, other, std::bit_and<Digit>{});
+}
+
+BigInt BigInt::operator|(const BigInt& other) const {
+    return bitwise(*this, other, std::bit_or<Digit>{});
+}
+
+BigInt BigInt::operator^(const BigInt& other) const {
+    return bitwise(*this, other, std::bit_xor<Digit>{});
+}
+
+BigInt BigInt::operator<<(size_t bits) const {
+    const size_t digits = bits / 32;
+    const unsigned shift = bits % 32;
+    BigInt ret = shiftedDigits(digits);
+    if (shift != 0 && !ret.isZero()) {
+        ret.data.push_back(0);
+        for (size_t i = ret.data.size() - 1; i > digits; --i) {
+            ret.data[i] = (ret.data[i] << shift) | (ret.data[i - 1] >> (32 - shift));
+        }
+        ret.data[digits] <<= shift;
+        ret.canonicalize();
+    }
+    return ret;
+}
+
+BigInt BigInt::operator>>(size_t bits) const {
+    if (isNegative) {
+        // floor(x / 2^bits) = -(floor((|x| - 1) / 2^bits) + 1) for x < 0
+        BigInt ret = (abs() - BigInt{1U}) >> bits;
+        ret += BigInt{1U};
+        ret.negate();
+        return ret;
+    }
+    const size_t digits = bits / 32;
+    const unsigned shift = bits % 32;
+    if (digits >= data.size()) {
+        return BigInt{};
+    }
+    BigInt ret{empty_construct{}};
+    ret.data.resize(data.size() - digits);
+    for (size_t i = 0; i < ret.data.size(); ++i) {
+        const size_t j = i + digits;
+        const uint64_t high = j + 1 < data.size() ? uint64_t{data[j + 1]} << 32 : 0;
+        ret.data[i] = static_cast<Digit>((high | data[j]) >> shift);
+    }
+    ret.canonicalize();
+    return ret;
 }
 
 void BigInt::canonicalize() {
-    auto nzIt = data.begin();
-    for (auto it = data.begin(); it != data.end(); ++it) {
-        nzIt = (*it == 0) ? it : data.end();
+    auto nzIt = data.end();
+    while (nzIt != data.begin() && *(nzIt - 1) == 0) {
+        --nzIt;
     }
     data.erase(nzIt, data.end());
     if (data.empty()) {
@@ -153,50 +897,27 @@ void BigInt::canonicalize() {
     }
 }
 
-int64_t BigInt::compare(const BigInt& other) const noexcept {
-    if (!sameSign(other)) {
-        return isNegative ? -1 : 1;
-    } else if (data.size() < other.data.size()) {
-        return -1;
-    } else if (data.size() > other.data.size()) {
-        return 1;
+int64_t BigInt::compareAbsVal(const BigInt& a, const BigInt& b) noexcept {
+    if (a.data.size() != b.data.size()) {
+        return a.data.size() < b.data.size() ? -1 : 1;
     }
-    for (auto aIt = data.begin(), bIt = other.data.begin(); aIt != data.end(); ++aIt, ++bIt) {
-        // This will become diff = *aIt <=> *bIt
-        if (int64_t diff = static_cast<int64_t>(*aIt) - static_cast<int64_t>(*bIt);
-            diff != 0) {
-            return diff;
+    // Compare from the most significant digit down
+    for (auto aIt = a.data.rbegin(), bIt = b.data.rbegin(); aIt != a.data.rend(); ++aIt, ++bIt) {
+        if (*aIt != *bIt) {
+            return *aIt < *bIt ? -1 : 1;
         }
     }
     return 0;
 }
 
-std::ostream& operator<<(std::ostream& os, const BigInt& val) {
-    static constexpr uint32_t MODULUS = 1'000'000'000U;
-    if (val.data.empty()) {
-        return os << "<empty>";
-    }
-    if (val.data.size() == 1) {
-        if (val.isNegative) {
-            os << "-";
-        }
-        return os << val.data.front();
-    }
-    BigInt v = val;
-    std::vector<uint32_t> partsToPrint;
-    if (v.isNegative) {
-        v = -v;
-        os << "-";
+int64_t BigInt::compare(const BigInt& other) const noexcept {
+    if (!sameSign(other)) {
+        return isNegative ? -1 : 1;
     }
-    do {
-        auto[div, mod] = v.divAndMod(MODULUS);
-        partsToPrint.emplace_back(mod);
-        v = std::move(div);
-    } while (v != BigInt{0} && !v.data.empty());
-    for (size_t i = partsToPrint.size() - 1; i >= 1; --i) {
-        char buf[32];
-        sprintf(buf, "%010u", partsToPrint[i]);
-        os << buf;
-    }
-    return os << partsToPrint[0];
+    const int64_t cmp = compareAbsVal(*this, other);
+    return isNegative ? -cmp : cmp;
+}
+
+std::ostream& operator<<(std::ostream& os, const BigInt& val) {
+    return os << val.toString();
 }
@@ -8,6 +8,10 @@
 #include <iostream>
 #include <limits>
 #include <numeric>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
 
 // Arbitrary Precision integer
 class BigInt {
@@ -23,7 +27,6 @@ class BigInt {
     // We use a small vector with SSO to avoid heap allocations in the common case
     SmallVector<uint32_t> data{};
     bool isNegative = false;
-    static constexpr uint32_t MAX_DIGIT = std::numeric_limits<uint32_t>::max();
 
     // Helpers that compute the absolute value of an operation, storing the
     // result in the third parameter, which is an outparam
@@ -31,17 +34,50 @@ class BigInt {
 
     static void mulAbsVal(const BigInt& a, const BigInt& b, BigInt& prod);
 
+    // Toom-3 multiplication, used by mulAbsVal for large operands of similar sizes
+    static void toom3AbsVal(const BigInt& a, const BigInt& b, BigInt& prod);
+
+    // Helpers for toom3AbsVal: the value of count digits starting at start, and
+    // value divided by a divisor known to divide it
+    BigInt digitRange(size_t start, size_t count) const;
+    template<uint32_t divisor>
+    static BigInt divExact(BigInt value);
+
     static void diffAbsVal(const BigInt& a, const BigInt& b, BigInt& diff);
 
-    // Helper for the standard division algorithm: finds for
-    // a = dividend, b = divisor, returns c,r such that
-    // a = bc + r where r < b
-    static uint32_t divisionDigit(const BigInt& dividend, const BigInt& divisor);
+    // Compare the absolute values of a and b
+    static int64_t compareAbsVal(const BigInt& a, const BigInt& b) noexcept;
+
+    // Computes quot, rem such that |dividend| = |divisor| quot + rem where
+    // 0 <= rem < |divisor|
+    static void divModAbsVal(const BigInt& dividend, const BigInt& divisor, BigInt& quot,
+                             BigInt& rem);
+
+    // Decimal conversion divides and conquers by the powers (10^9)^(2^k), which
+    // are cached along with their reciprocals. See BigInt.cc
+    struct DecimalPower;
+    static DecimalPower& decimalPower(size_t level);
+
+    // floor(2^(64m) / d) for d of m digits, by Newton's method
+    static BigInt reciprocal(const BigInt& d);
+
+    // Barrett division of a non-negative value less than the square of a power
+    static void divModPower(const BigInt& value, DecimalPower& power, BigInt& quot,
+                            BigInt& rem);
+
+    // Append the digits of a non-negative value less than the square of the power
+    // at level, padded with zeroes to the width of that square if pad is set
+    static void appendDecimal(const BigInt& value, size_t level, bool pad, std::string& out);
 
-    static void divAbsVal(const BigInt& dividend, const BigInt& divisor, BigInt& ret);
+    static BigInt parseDecimal(std::string_view digits);
 
-    // essentially a specialized version of divAbsVal when the divisor is a single digit
-    std::pair<BigInt, uint32_t> divAndMod(uint32_t modulus);
+    // this * 2^(32 count)
+    BigInt shiftedDigits(size_t count) const;
+
+    // The bitwise operation op on the infinitely sign extended two's complement
+    // digits of a and b
+    template<typename Op>
+    static BigInt bitwise(const BigInt& a, const BigInt& b, Op op);
 
     // Standardize the form of the integer: this mostly entails trimming leading zeroes
     void canonicalize();
@@ -51,10 +87,36 @@ class BigInt {
         return isNegative == other.isNegative;
     }
 
+    bool isZero() const noexcept { return data.size() == 1 && data[0] == 0; }
+
+    // Flip the sign in place; zero is never negative
+    void negate() noexcept { isNegative = !isNegative && !isZero(); }
+
+    // this += other, negated if otherNegative differs from the sign of other,
+    // in the existing digits where possible
+    void addInPlace(const BigInt& other, bool otherNegative);
+
     struct empty_construct {};
     BigInt(empty_construct) : data{} {}
 
   public:
+    // Operand sizes (in digits) from which multiplication uses Karatsuba and
+    // then Toom-3 in place of the schoolbook algorithm
+    static constexpr size_t defaultKaratsubaThreshold = 64;
+    static constexpr size_t defaultToom3Threshold = 640;
+    /// Override the multiplication thresholds, e.g. to benchmark the algorithms
+    static void setMulThresholds(size_t karatsuba, size_t toom3);
+
+    /// The loops at the bottom of addition, subtraction and schoolbook
+    /// multiplication work one 32-bit digit at a time, two digits at a time as
+    /// 64-bit words in portable code, or two at a time with the BMI2 and ADX
+    /// multiply and add with carry instructions. The fastest the CPU supports
+    /// is chosen at startup
+    enum class Kernels { Digit32, Word64, Adx };
+    /// Switch kernels, e.g. to benchmark them; false if unsupported here
+    static bool setKernels(Kernels kind);
+    static Kernels activeKernels();
+
     // TODO: should we even have this default constructor? It made sense at one point that
     // the default would be zero, but because I use outparams so much, the empty construct
     // one is much more useful
@@ -75,12 +137,17 @@ class BigInt {
         }
     }
 
-    explicit BigInt(int64_t val) : BigInt(static_cast<uint64_t>(std::labs(val))) {
+    // The magnitude is negated as unsigned, so that INT64_MIN does not overflow
+    explicit BigInt(int64_t val)
+        : BigInt(val < 0 ? 0 - static_cast<uint64_t>(val) : static_cast<uint64_t>(val)) {
         if (val < 0) {
             isNegative = true;
         }
     }
 
+    /// Parse an optionally signed string of decimal digits
+    static BigInt fromString(std::string_view str);
+
     // Disable construction from double
     template<typename = void> BigInt(double) = delete;
     template<typename = void> BigInt& operator=(double) = delete;
@@ -92,21 +159,27 @@ class BigInt {
     SPACESHIP_BOILERPLATE(BigInt, compare, int64_t)
 
     // Unary Arithmetic Operators
-    const BigInt operator-() const {
+    BigInt operator-() const& {
         BigInt ret = *this;
-        ret.isNegative = !isNegative;
+        ret.negate();
         return ret;
     }
+    BigInt operator-() && {
+        negate();
+        return std::move(*this);
+    }
 
     const BigInt& operator+() const noexcept {
         return *this;
     }
 
-    // Binary Arithmetic Operators
-    const BigInt operator+(const BigInt& other) const {
+    // Binary Arithmetic Operators. Those on lvalues build a new result; those
+    // on rvalues work in place in the buffer of the temporary
+    BigInt operator+(const BigInt& other) const& {
         BigInt ret{empty_construct{}};
         if (sameSign(other)) {
             sumAbsVal(*this, other, ret);
+            ret.isNegative = isNegative;
         } else if (isNegative) {
             diffAbsVal(other, *this, ret);
         } else {
@@ -115,48 +188,92 @@ class BigInt {
         ret.canonicalize();
         return ret;
     }
-
-    const BigInt operator-(const BigInt& other) const {
-        return *this + -other;
+    BigInt operator+(const BigInt& other) && {
+        return std::move(*this += other);
+    }
+    BigInt operator+(BigInt&& other) const& {
+        return std::move(other += *this);
+    }
+    BigInt operator+(BigInt&& other) && {
+        return std::move(*this += other);
     }
 
-    const BigInt operator*(const BigInt& other) const {
+    BigInt operator-(const BigInt& other) const& {
         BigInt ret{empty_construct{}};
-        mulAbsVal(*this, other, ret);
+        if (!sameSign(other)) {
+            sumAbsVal(*this, other, ret);
+            ret.isNegative = isNegative;
+        } else if (isNegative) {
+            diffAbsVal(other, *this, ret);
+        } else {
+            diffAbsVal(*this, other, ret);
+        }
         ret.canonicalize();
-        return sameSign(other) ? ret : -ret;
+        return ret;
+    }
+    BigInt operator-(const BigInt& other) && {
+        return std::move(*this -= other);
+    }
+    BigInt operator-(BigInt&& other) const& {
+        other -= *this;
+        other.negate();
+        return std::move(other);
+    }
+    BigInt operator-(BigInt&& other) && {
+        return std::move(*this -= other);
     }
 
-    const BigInt operator/(const BigInt& other) const {
+    BigInt operator*(const BigInt& other) const& {
         BigInt ret{empty_construct{}};
-        divAbsVal(*this, other, ret);
+        mulAbsVal(*this, other, ret);
         ret.canonicalize();
-        return sameSign(other) ? ret : -ret;
+        ret.isNegative = !sameSign(other) && !ret.isZero();
+        return ret;
+    }
+    BigInt operator*(const BigInt& other) && {
+        return std::move(*this *= other);
+    }
+    BigInt operator*(BigInt&& other) const& {
+        return std::move(other *= *this);
+    }
+    BigInt operator*(BigInt&& other) && {
+        return std::move(*this *= other);
     }
 
-    const BigInt operator%(const BigInt& other) const {
-        BigInt ret{empty_construct{}};
-        divAbsVal(*this, other, ret);
-        ret.canonicalize();
-        BigInt returnVal = this->abs() - (other.abs() * ret.abs());
-        return isNegative ? -returnVal : returnVal;
+    // Division truncates towards zero, and the remainder has the sign of the
+    // dividend
+    BigInt operator/(const BigInt& other) const {
+        BigInt quot{empty_construct{}};
+        BigInt rem{empty_construct{}};
+        divModAbsVal(*this, other, quot, rem);
+        quot.isNegative = !sameSign(other) && !quot.isZero();
+        return quot;
+    }
+
+    BigInt operator%(const BigInt& other) const {
+        BigInt quot{empty_construct{}};
+        BigInt rem{empty_construct{}};
+        divModAbsVal(*this, other, quot, rem);
+        rem.isNegative = isNegative && !rem.isZero();
+        return rem;
     }
 
-    // Modifying Assignment Operators
+    // Modifying Assignment Operators, which reuse the digits of this where
+    // they can. other may be this
     BigInt& operator+=(const BigInt& other) {
-        return (*this = *this + other);
+        addInPlace(other, other.isNegative);
+        return *this;
     }
     BigInt& operator-=(const BigInt& other) {
-        return (*this = *this - other);
-    }
-    BigInt& operator*=(const BigInt& other) {
-        return (*this = *this * other);
+        addInPlace(other, !other.isNegative);
+        return *this;
     }
+    BigInt& operator*=(const BigInt& other);
     BigInt& operator/=(const BigInt& other) {
-        return (*this = *this / other);
+        return *this = *this / other;
     }
     BigInt& operator%=(const BigInt& other) {
-        return (*this = *this % other);
+        return *this = *this % other;
     }
 
     explicit operator double() const noexcept {
@@ -180,6 +297,58 @@ class BigInt {
         }
         return result;
     }
+    /// The value as an int64_t, if it is in range
+    std::optional<int64_t> toInt64() const noexcept {
+        if (data.size() > 2) {
+            return std::nullopt;
+        }
+        uint64_t magnitude{};
+        for (auto it = data.rbegin(); it != data.rend(); ++it) {
+            magnitude <<= 32;
+            magnitude += *it;
+        }
+        constexpr uint64_t maxMagnitude = std::numeric_limits<int64_t>::max();
+        if (magnitude <= maxMagnitude) {
+            const int64_t val = static_cast<int64_t>(magnitude);
+            return isNegative ? -val : val;
+        } else if (isNegative && magnitude == maxMagnitude + 1) {
+            return std::numeric_limits<int64_t>::min();
+        }
+        return std::nullopt;
+    }
+
+    /// The decimal representation of the integer
+    std::string toString() const;
+
+    /// A hash of the value, mixing in every digit
+    uint64_t hash() const noexcept;
+
+    /// The greatest common divisor of the absolute values, by Lehmer's
+    /// algorithm down to a binary GCD of 64-bit values
+    static BigInt gcd(BigInt a, BigInt b);
+
+    /// floor(sqrt(this)) of a non-negative value, by Newton's method
+    BigInt sqrt() const;
+
+    /// base^exponent mod modulus, in [0, modulus), for a non-negative exponent
+    /// and a positive modulus. Odd moduli are handled by Montgomery
+    /// multiplication, which needs no division in the loop
+    static BigInt modPow(const BigInt& base, const BigInt& exponent, const BigInt& modulus);
+
+    /// The number of bits in the absolute value, 0 for zero
+    size_t bitLength() const noexcept;
+
+    // Bitwise operators, which act as on an infinitely sign extended two's
+    // complement representation, so that >> rounds towards negative infinity
+    BigInt operator&(const BigInt& other) const;
+    BigInt operator|(const BigInt& other) const;
+    BigInt operator^(const BigInt& other) const;
+    BigInt operator<<(size_t bits) const;
+    BigInt operator>>(size_t bits) const;
+
+    /// The number of 32-bit digits in the absolute value
+    size_t digitCount() const noexcept { return data.size(); }
+
     friend std::ostream& operator<<(std::ostream& os, const BigInt& val);
 
     BigInt abs() const {
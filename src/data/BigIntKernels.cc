@@ -0,0 +1,297 @@
+// (c) Sam Donow 2018
+#include "BigIntKernels.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// The word at a time kernels read pairs of digits as one little endian word
+#if defined(__SIZEOF_INT128__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define LISPI_WORD_KERNELS 1
+#endif
+
+namespace kernels {
+namespace {
+// Finish an addition from digit i with the given carry, one digit at a time
+Digit finishAdd(Digit* a, size_t an, const Digit* b, size_t bn, size_t i, uint64_t carry) {
+    for (; i < bn; ++i) {
+        const uint64_t digitSum = uint64_t{a[i]} + b[i] + carry;
+        a[i] = static_cast<Digit>(digitSum);
+        carry = digitSum >> 32;
+    }
+    for (; carry != 0 && i < an; ++i) {
+        const uint64_t digitSum = uint64_t{a[i]} + carry;
+        a[i] = static_cast<Digit>(digitSum);
+        carry = digitSum >> 32;
+    }
+    return static_cast<Digit>(carry);
+}
+
+Digit finishSub(Digit* a, size_t an, const Digit* b, size_t bn, size_t i, uint64_t borrow) {
+    for (; i < bn; ++i) {
+        const uint64_t digitDiff = uint64_t{a[i]} - b[i] - borrow;
+        a[i] = static_cast<Digit>(digitDiff);
+        borrow = digitDiff >> 63;
+    }
+    for (; borrow != 0 && i < an; ++i) {
+        const uint64_t digitDiff = uint64_t{a[i]} - borrow;
+        a[i] = static_cast<Digit>(digitDiff);
+        borrow = digitDiff >> 63;
+    }
+    return static_cast<Digit>(borrow);
+}
+
+// One digit at a time, with 64-bit intermediates
+Digit addInto32(Digit* a, size_t an, const Digit* b, size_t bn) {
+    return finishAdd(a, an, b, bn, 0, 0);
+}
+
+Digit subInto32(Digit* a, size_t an, const Digit* b, size_t bn) {
+    return finishSub(a, an, b, bn, 0, 0);
+}
+
+void mulSchoolbook32(const Digit* a, size_t an, const Digit* b, size_t bn, Digit* out) {
+    std::fill(out, out + an + bn, 0);
+    for (size_t j = 0; j < bn; ++j) {
+        const uint64_t bDigit = b[j];
+        if (bDigit == 0) {
+            continue;
+        }
+        uint64_t carry = 0;
+        for (size_t i = 0; i < an; ++i) {
+            // Cannot overflow: (2^32 - 1)^2 + 2 * (2^32 - 1) = 2^64 - 1
+            const uint64_t digitProd = a[i] * bDigit + out[i + j] + carry;
+            out[i + j] = static_cast<Digit>(digitProd);
+            carry = digitProd >> 32;
+        }
+        out[j + an] = static_cast<Digit>(carry);
+    }
+}
+
+constexpr KernelSet digit32Kernels{&addInto32, &subInto32, &mulSchoolbook32};
+
+#ifdef LISPI_WORD_KERNELS
+__extension__ using Wide = unsigned __int128;
+
+uint64_t loadWord(const Digit* p) {
+    uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+    return word;
+}
+
+void storeWord(Digit* p, uint64_t word) {
+    std::memcpy(p, &word, sizeof(word));
+}
+
+// Two digits at a time, with 128-bit intermediates
+Digit addInto64(Digit* a, size_t an, const Digit* b, size_t bn) {
+    uint64_t carry = 0;
+    size_t i = 0;
+    for (; i + 2 <= bn; i += 2) {
+        const Wide wordSum = Wide{loadWord(a + i)} + loadWord(b + i) + carry;
+        storeWord(a + i, static_cast<uint64_t>(wordSum));
+        carry = static_cast<uint64_t>(wordSum >> 64);
+    }
+    return finishAdd(a, an, b, bn, i, carry);
+}
+
+Digit subInto64(Digit* a, size_t an, const Digit* b, size_t bn) {
+    uint64_t borrow = 0;
+    size_t i = 0;
+    for (; i + 2 <= bn; i += 2) {
+        const Wide wordDiff = Wide{loadWord(a + i)} - loadWord(b + i) - borrow;
+        storeWord(a + i, static_cast<uint64_t>(wordDiff));
+        borrow = static_cast<uint64_t>(wordDiff >> 64) & 1;
+    }
+    return finishSub(a, an, b, bn, i, borrow);
+}
+
+// out[0, an) += a[0, an) * m, returning the carry, which is to be stored in
+// the two digits from out[an]
+uint64_t mulAddRow64(Digit* out, const Digit* a, size_t an, uint64_t m) {
+    uint64_t carry = 0;
+    size_t i = 0;
+    for (; i + 2 <= an; i += 2) {
+        const Wide wordProd = Wide{loadWord(a + i)} * m + loadWord(out + i) + carry;
+        storeWord(out + i, static_cast<uint64_t>(wordProd));
+        carry = static_cast<uint64_t>(wordProd >> 64);
+    }
+    if (i < an) {
+        const Wide digitProd = Wide{a[i]} * m + out[i] + carry;
+        out[i] = static_cast<Digit>(digitProd);
+        carry = static_cast<uint64_t>(digitProd >> 32);
+    }
+    return carry;
+}
+
+// Each row multiplies by two digits of b. The digits the carry of a row is
+// stored in have not been written by earlier rows
+void mulSchoolbook64(const Digit* a, size_t an, const Digit* b, size_t bn, Digit* out) {
+    std::fill(out, out + an + bn, 0);
+    for (size_t j = 0; j < bn; j += 2) {
+        const uint64_t m = j + 1 < bn ? loadWord(b + j) : b[j];
+        if (m == 0) {
+            continue;
+        }
+        const uint64_t carry = mulAddRow64(out + j, a, an, m);
+        out[j + an] = static_cast<Digit>(carry);
+        if (j + an + 1 < an + bn) {
+            out[j + an + 1] = static_cast<Digit>(carry >> 32);
+        }
+    }
+}
+
+constexpr KernelSet word64Kernels{&addInto64, &subInto64, &mulSchoolbook64};
+#endif
+
+#if defined(LISPI_WORD_KERNELS) && defined(__x86_64__)
+// Two digits at a time with the carry flag, and multiplication by mulx, with
+// separate carry chains (adcx and adox) for the products and the sums. Only
+// selected once the CPU is known to support BMI2 and ADX
+Digit addIntoAdx(Digit* a, size_t an, const Digit* b, size_t bn) {
+    unsigned char carry = 0;
+    size_t i = 0;
+    for (; i + 2 <= bn; i += 2) {
+        unsigned long long wordSum;
+        carry = _addcarry_u64(carry, loadWord(a + i), loadWord(b + i), &wordSum);
+        storeWord(a + i, wordSum);
+    }
+    return finishAdd(a, an, b, bn, i, carry);
+}
+
+Digit subIntoAdx(Digit* a, size_t an, const Digit* b, size_t bn) {
+    unsigned char borrow = 0;
+    size_t i = 0;
+    for (; i + 2 <= bn; i += 2) {
+        unsigned long long wordDiff;
+        borrow = _subborrow_u64(borrow, loadWord(a + i), loadWord(b + i), &wordDiff);
+        storeWord(a + i, wordDiff);
+    }
+    return finishSub(a, an, b, bn, i, borrow);
+}
+
+// Compilers save and restore the flags between carry intrinsics, so this loop
+// is written out, keeping the carries of the products (adcx, in CF) and of the
+// sums (adox, in OF) in the flags throughout. Only mulx, lea, mov and jrcxz,
+// which leave the flags alone, come between them
+uint64_t mulAddRowAdx(Digit* out, const Digit* a, size_t an, uint64_t m) {
+    uint64_t carry = 0;
+    size_t words = an / 2;
+    if (words != 0) {
+        const Digit* source = a;
+        Digit* dest = out;
+        uint64_t low;
+        uint64_t high;
+        asm("xor %k[carry], %k[carry]\n\t"
+            "1:\n\t"
+            "mulx (%[source]), %[low], %[high]\n\t"
+            "adcx %[carry], %[low]\n\t"
+            "adox (%[dest]), %[low]\n\t"
+            "mov %[low], (%[dest])\n\t"
+            "mov %[high], %[carry]\n\t"
+            "lea 8(%[source]), %[source]\n\t"
+            "lea 8(%[dest]), %[dest]\n\t"
+            "lea -1(%[words]), %[words]\n\t"
+            "jrcxz 2f\n\t"
+            "jmp 1b\n"
+            "2:\n\t"
+            "mov $0, %k[low]\n\t"
+            "adcx %[low], %[carry]\n\t"
+            "adox %[low], %[carry]"
+            : [carry] "=&r"(carry), [low] "=&r"(low), [high] "=&r"(high),
+              [source] "+r"(source), [dest] "+r"(dest), [words] "+c"(words)
+            : "d"(m)
+            : "cc", "memory");
+    }
+    const size_t i = an & ~size_t{1};
+    if (i < an) {
+        const Wide digitProd = Wide{a[i]} * m + out[i] + carry;
+        out[i] = static_cast<Digit>(digitProd);
+        carry = static_cast<uint64_t>(digitProd >> 32);
+    }
+    return carry;
+}
+
+void mulSchoolbookAdx(const Digit* a, size_t an, const Digit* b, size_t bn, Digit* out) {
+    std::fill(out, out + an + bn, 0);
+    for (size_t j = 0; j < bn; j += 2) {
+        const uint64_t m = j + 1 < bn ? loadWord(b + j) : b[j];
+        if (m == 0) {
+            continue;
+        }
+        const uint64_t carry = mulAddRowAdx(out + j, a, an, m);
+        out[j + an] = static_cast<Digit>(carry);
+        if (j + an + 1 < an + bn) {
+            out[j + an + 1] = static_cast<Digit>(carry >> 32);
+        }
+    }
+}
+
+constexpr KernelSet adxKernels{&addIntoAdx, &subIntoAdx, &mulSchoolbookAdx};
+#endif
+
+const KernelSet& kernelsOf(BigInt::Kernels kind) {
+    switch (kind) {
+#ifdef LISPI_WORD_KERNELS
+    case BigInt::Kernels::Word64:
+        return word64Kernels;
+#endif
+#if defined(LISPI_WORD_KERNELS) && defined(__x86_64__)
+    case BigInt::Kernels::Adx:
+        return adxKernels;
+#endif
+    default:
+        return digit32Kernels;
+    }
+}
+
+BigInt::Kernels best() {
+    for (BigInt::Kernels kind : {BigInt::Kernels::Adx, BigInt::Kernels::Word64}) {
+        if (supported(kind)) {
+            return kind;
+        }
+    }
+    return BigInt::Kernels::Digit32;
+}
+}
+
+// Start out with the portable kernels, so that they are in place for any
+// static initialization, and then switch to the best supported ones
+#ifdef LISPI_WORD_KERNELS
+KernelSet active = word64Kernels;
+BigInt::Kernels activeKind = BigInt::Kernels::Word64;
+#else
+KernelSet active = digit32Kernels;
+BigInt::Kernels activeKind = BigInt::Kernels::Digit32;
+#endif
+[[maybe_unused]] const bool bestSelected = (select(best()), true);
+
+bool supported(BigInt::Kernels kind) {
+    switch (kind) {
+    case BigInt::Kernels::Digit32:
+        return true;
+    case BigInt::Kernels::Word64:
+#ifdef LISPI_WORD_KERNELS
+        return true;
+#else
+        return false;
+#endif
+    case BigInt::Kernels::Adx:
+#if defined(LISPI_WORD_KERNELS) && defined(__x86_64__)
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("bmi2") && __builtin_cpu_supports("adx");
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+void select(BigInt::Kernels kind) {
+    active = kernelsOf(kind);
+    activeKind = kind;
+}
+}
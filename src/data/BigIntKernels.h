@@ -0,0 +1,32 @@
+// (c) Sam Donow 2018
+#pragma once
+#include "data/BigInt.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/// The innermost loops of BigInt arithmetic, over arrays of 32-bit digits
+/// (least significant first). There are several implementations, of which the
+/// fastest one supported by the CPU is chosen at startup; see BigInt::Kernels
+namespace kernels {
+using Digit = uint32_t;
+
+struct KernelSet {
+    /// a[0, an) += b[0, bn) for bn <= an, returning the carry out of the top digit
+    Digit (*addInto)(Digit* a, size_t an, const Digit* b, size_t bn);
+    /// a[0, an) -= b[0, bn) for bn <= an, returning the borrow out of the top digit
+    Digit (*subInto)(Digit* a, size_t an, const Digit* b, size_t bn);
+    /// out[0, an + bn) = a[0, an) * b[0, bn)
+    void (*mulSchoolbook)(const Digit* a, size_t an, const Digit* b, size_t bn, Digit* out);
+};
+
+/// The implementation in use
+extern KernelSet active;
+extern BigInt::Kernels activeKind;
+
+/// Whether the given implementation can run here
+bool supported(BigInt::Kernels kind);
+
+/// Switch to the given implementation, which must be supported
+void select(BigInt::Kernels kind);
+}
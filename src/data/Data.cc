@@ -1,82 +1,484 @@
 #include "Data.h"
+#include "data/HashTable.h"
+
+#include <algorithm>
+#include <deque>
+#include <unordered_set>
+#include <utility>
 
 LispFunction::LispFunction(std::vector<Symbol> &&formals,
-                           const SExprPtr& defn,
-                           SymbolTable& scope)
-    : formalParameters(std::move(formals)), definition(defn),
-        defnScope{scope.shared_from_this()} {
+                           const Datum& defn,
+                           GCPtr<SymbolTable> scope)
+    : formalParameters(std::move(formals)), definition(defn), code{},
+        defnScope{std::move(scope)} {
+}
+
+LispFunction::~LispFunction() = default;
+
+GCPtr<SymbolTable> LispFunction::funcScope() const {
+    return defnScope->makeChild();
+}
+
+void LispFunction::traverse(GCVisitor& visitor) const {
+    // The constants of the bytecode are not traversed, as the code may be shared
+    // between closures; they are only quoted data, which cannot form cycles
+    definition.traverse(visitor);
+    if (defnScope != nullptr) {
+        visitor.visit(defnScope.get());
+    }
 }
 
-std::shared_ptr<SymbolTable> LispFunction::funcScope() const {
-    return defnScope.lock()->makeChild();
+void LispFunction::clear() {
+    definition = Datum{};
+    defnScope = nullptr;
+}
+
+Atom::Atom(const Number& num) {
+    if (num.is<int64_t>()) {
+        if (const int64_t val = num.as<int64_t>(); val >= minFixnum && val <= maxFixnum) {
+            *this = fixnum(val);
+            return;
+        }
+    } else if (num.is<double>()) {
+        *this = Atom{num.as<double>()};
+        return;
+    }
+    *this = Atom{NumberTag, makeGC<BoxedNumber>(num).get()};
+}
+
+Atom::Atom(std::string str)
+    : Atom{StringTag, makeGC<BoxedString>(std::move(str)).get()} {}
+
+Atom::Atom(const GCPtr<LispFunction>& func) : Atom{FunctionTag, func.get()} {}
+
+Atom::Atom(const GCPtr<F64Vector>& vec) : Atom{F64VectorTag, vec.get()} {}
+
+Atom::Atom(const GCPtr<S64Vector>& vec) : Atom{S64VectorTag, vec.get()} {}
+
+Atom::Atom(const GCPtr<Vector>& vec) : Atom{VectorTag, vec.get()} {}
+
+Atom::Atom(const GCPtr<HashTable>& table) : Atom{HashTableTag, table.get()} {}
+
+namespace {
+template<typename T>
+std::ostream& printElements(std::ostream& os, const char* prefix, const std::vector<T>& elements) {
+    os << prefix;
+    for (size_t i = 0; i < elements.size(); ++i) {
+        os << (i == 0 ? "" : " ") << elements[i];
+    }
+    return os << ")";
+}
+
+// Prints lists and vectors, nested to any depth: the lists and vectors being
+// printed are kept as an explicit stack on the heap rather than by recursion.
+// A list or vector that contains itself prints #[circular] where it recurs
+class StructurePrinter {
+    // A list or vector being printed, and how far it has been printed
+    struct Open {
+        const GCObject* object = nullptr;
+        // Null for a list
+        const Vector* vec = nullptr;
+        size_t index = 0;
+        // For a list, the next pair, and then the final atom of an improper list
+        const SExpr* cell = nullptr;
+        const Datum* tail = nullptr;
+    };
+
+    std::ostream& os;
+    std::vector<Open> stack{};
+    std::unordered_set<const GCObject*> printing{};
+
+    bool enter(const GCObject* object, const char* prefix) {
+        if (!printing.insert(object).second) {
+            os << "#[circular]";
+            return false;
+        }
+        os << prefix;
+        return true;
+    }
+
+  public:
+    explicit StructurePrinter(std::ostream& out) : os{out} {}
+
+    void openList(const SExpr* cell) {
+        if (enter(cell, "'(")) {
+            stack.push_back(Open{cell, nullptr, 0, cell, nullptr});
+        }
+    }
+
+    /// Print an atom, or start printing a list or vector
+    void open(const Datum& datum) {
+        if (!datum.isAtomic()) {
+            if (const SExpr* cell = datum.getSExpr()) {
+                openList(cell);
+            } else {
+                os << "'()";
+            }
+        } else if (datum.getAtom().contains<GCPtr<Vector>>()) {
+            const Vector* vec = datum.getAtom().get<GCPtr<Vector>>().get();
+            if (enter(vec, "#(")) {
+                stack.push_back(Open{vec, vec, 0, nullptr, nullptr});
+            }
+        } else {
+            os << datum.getAtom();
+        }
+    }
+
+    void run() {
+        while (!stack.empty()) {
+            Open& top = stack.back();
+            const Datum* element = nullptr;
+            if (top.vec != nullptr && top.index < top.vec->elements.size()) {
+                element = &top.vec->elements[top.index];
+                os << (top.index == 0 ? "" : " ");
+            } else if (top.cell != nullptr) {
+                element = &top.cell->car;
+                os << (top.index == 0 ? "" : " ");
+                const Datum& cdr = top.cell->cdr;
+                top.cell = cdr.isAtomic() ? nullptr : cdr.getSExpr();
+                top.tail = cdr.isAtomic() ? &cdr : nullptr;
+            } else if (top.tail != nullptr) {
+                element = std::exchange(top.tail, nullptr);
+                os << " . ";
+            } else {
+                os << ")";
+                printing.erase(top.object);
+                stack.pop_back();
+                continue;
+            }
+            ++top.index;
+            open(*element);
+        }
+    }
+};
 }
 
 std::ostream& operator<<(std::ostream& os, const Atom& atom) {
-    return std::visit(Visitor {
-        [&os](const std::monostate&) -> std::ostream& { return os << std::endl; },
-        [&os](const LispFunction&) -> std::ostream& { return os << "<func>"; },
-        [&os](bool b) -> std::ostream& { return os << (b ? "#t" : "#f"); },
-        [&os](const auto &n) -> std::ostream& { return os << n; }
-    }, atom.data);
+    switch (atom.tag()) {
+    case Atom::FunctionTag:
+        return os << "<func>";
+    case Atom::BuiltInTag:
+        return os << "<builtin>";
+    case Atom::StringTag:
+        return os << atom.get<std::string>();
+    case Atom::SymbolTag:
+        return os << atom.get<Symbol>();
+    case Atom::F64VectorTag:
+        return printElements(os, "#f64(", atom.heapObjectAs<F64Vector>()->elements);
+    case Atom::S64VectorTag:
+        return printElements(os, "#s64(", atom.heapObjectAs<S64Vector>()->elements);
+    case Atom::VectorTag: {
+        StructurePrinter printer{os};
+        printer.open(Datum{atom});
+        printer.run();
+        return os;
+    }
+    case Atom::HashTableTag:
+        return os << "#[hash-table " << atom.heapObjectAs<HashTable>()->size() << "]";
+    case Atom::ConstantTag:
+        if (atom.contains<char>()) {
+            return os << atom.get<char>();
+        } else if (atom.contains<bool>()) {
+            return os << (atom.get<bool>() ? "#t" : "#f");
+        }
+        return os << std::endl;
+    default:
+        return os << atom.getNumber();
+    }
+}
+
+std::string_view Atom::typeName() const {
+    switch (tag()) {
+    case PairTag:
+        return "pair";
+    case FunctionTag:
+    case BuiltInTag:
+        return lispTypeName<BuiltInFunc*>();
+    case StringTag:
+        return lispTypeName<std::string>();
+    case SymbolTag:
+        return lispTypeName<Symbol>();
+    case F64VectorTag:
+        return lispTypeName<GCPtr<F64Vector>>();
+    case S64VectorTag:
+        return lispTypeName<GCPtr<S64Vector>>();
+    case VectorTag:
+        return lispTypeName<GCPtr<Vector>>();
+    case HashTableTag:
+        return lispTypeName<GCPtr<HashTable>>();
+    case ConstantTag:
+        if (contains<char>()) {
+            return lispTypeName<char>();
+        } else if (contains<bool>()) {
+            return lispTypeName<bool>();
+        }
+        return "unspecified";
+    default:
+        return lispTypeName<Number>();
+    }
 }
 
 bool Atom::operator==(const Atom& other) const {
-    return std::visit(Visitor{
-        [](const Number& n1, const Number& n2) { return n1 == n2; },
-        [](bool b1, bool b2) { return b1 == b2; },
-        [](const std::string& s1, const std::string& s2) { return s1 == s2; },
-        [](const auto&, const auto&) { return false; }
-    }, data, other.data);
+    if (contains<Number>() && other.contains<Number>()) {
+        if (isFixnum() && other.isFixnum()) {
+            return bits == other.bits;
+        }
+        return getNumber() == other.getNumber();
+    } else if (contains<bool>() || contains<Symbol>()) {
+        return bits == other.bits;
+    } else if (contains<std::string>() && other.contains<std::string>()) {
+        return get<std::string>() == other.get<std::string>();
+    }
+    // Vectors and other heap objects are only equal to themselves; equal?
+    // compares contents
+    return bits == other.bits;
 }
 
 std::ostream& operator<<(std::ostream& os, const Datum& datum) {
-    return std::visit(
-        Visitor{[&os](const Atom& atom) -> std::ostream& { return os << atom; },
-                [&os](const SExprPtr& sexpr) -> std::ostream& {
-                    if (sexpr == nullptr) {
-                        return os << "'()";
-                    } else {
-                        return os << *sexpr;
-                    }
-                }},
-        datum.data);
+    if (datum.isAtomic()) {
+        return os << datum.value;
+    }
+    StructurePrinter printer{os};
+    printer.open(datum);
+    printer.run();
+    return os;
 }
 
 std::ostream& operator<<(std::ostream& os, const SExpr& expr) {
-    os << "'(";
-    for (auto it = expr.begin(); it != expr.end();) {
-        const Datum& datum = *it;
-        os << datum << (++it == expr.end() ? ")" : " ");
-    }
+    StructurePrinter printer{os};
+    printer.openList(&expr);
+    printer.run();
     return os;
 }
 
-// TODO: for eqv? support pointer equality of SExprs and of reference-counted
-// strings
 bool Datum::operator==(const Datum& other) const {
-    return std::visit(
-        Visitor{[](const Atom& a1, const Atom& a2) { return a1 == a2; },
-                [](const auto&, const auto&) { return false; }},
-        data, other.data);
+    return isAtomic() && other.isAtomic() && value == other.value;
 }
 
-SymbolTable::value_type& SymbolTable::
-operator[](const std::string& s) {
-    if (auto it = table.find(s); it == table.end()) {
-        if (unlikely(parent == nullptr)) {
-            throw LispError("Undefined Symbol: ", s);
-        } else {
-            return (*parent)[s];
+namespace {
+// Rationals are exact, though Number::isExact is only true of integers
+bool exactness(const Number& num) {
+    return !num.is<double>();
+}
+
+template<typename T>
+bool elementsEqual(const Atom& a, const Atom& b) {
+    return a.get<GCPtr<T>>()->elements == b.get<GCPtr<T>>()->elements;
+}
+
+// The contents of strings and numeric vectors, which equal? compares; the
+// elements of vectors are compared by Datum::equal itself
+bool atomsEqual(const Atom& a, const Atom& b) {
+    if (a.contains<std::string>() && b.contains<std::string>()) {
+        return a.get<std::string>() == b.get<std::string>();
+    } else if (a.contains<GCPtr<F64Vector>>() && b.contains<GCPtr<F64Vector>>()) {
+        return elementsEqual<F64Vector>(a, b);
+    } else if (a.contains<GCPtr<S64Vector>>() && b.contains<GCPtr<S64Vector>>()) {
+        return elementsEqual<S64Vector>(a, b);
+    }
+    return false;
+}
+
+// Only the first few elements of a structure are hashed, so that hashing a
+// long list or a large vector takes constant time
+constexpr size_t equalHashBudget = 16;
+
+template<typename T>
+uint64_t hashNumbers(const std::vector<T>& elements, size_t& budget) {
+    uint64_t h = util::hashMix(elements.size());
+    for (size_t i = 0; i < elements.size() && budget > 0; ++i, --budget) {
+        h = util::hashCombine(h, Number{elements[i]}.hash());
+    }
+    return h;
+}
+
+uint64_t equalHash(const Datum& datum, size_t& budget) {
+    if (datum.isAtomic()) {
+        const Atom& atom = datum.getAtom();
+        if (atom.contains<std::string>()) {
+            return std::hash<std::string_view>{}(atom.get<std::string>());
+        } else if (atom.contains<GCPtr<Vector>>()) {
+            const std::vector<Datum>& elements = atom.get<GCPtr<Vector>>()->elements;
+            uint64_t h = util::hashMix(elements.size());
+            for (size_t i = 0; i < elements.size() && budget > 0; ++i) {
+                --budget;
+                h = util::hashCombine(h, equalHash(elements[i], budget));
+            }
+            return h;
+        } else if (atom.contains<GCPtr<F64Vector>>()) {
+            return hashNumbers(atom.get<GCPtr<F64Vector>>()->elements, budget);
+        } else if (atom.contains<GCPtr<S64Vector>>()) {
+            return hashNumbers(atom.get<GCPtr<S64Vector>>()->elements, budget);
         }
-    } else {
+        return datum.eqvHash();
+    }
+    uint64_t h = 0;
+    const Datum* rest = &datum;
+    for (; !rest->isAtomic() && budget > 0; --budget) {
+        const SExpr* cell = rest->getSExpr();
+        if (cell == nullptr) {
+            break;
+        }
+        h = util::hashCombine(h, equalHash(cell->car, budget));
+        rest = &cell->cdr;
+    }
+    // The tail of an improper list
+    return rest->isAtomic() && budget > 0 ? util::hashCombine(h, equalHash(*rest, budget)) : h;
+}
+}
+
+bool Datum::eqv(const Datum& other) const {
+    if (value.bits == other.value.bits) {
+        return true;
+    } else if (value.contains<Number>() && other.value.contains<Number>()) {
+        const Number a = value.getNumber();
+        const Number b = other.value.getNumber();
+        return exactness(a) == exactness(b) && a == b;
+    }
+    return false;
+}
+
+// Structures are compared with an explicit stack of the pairs of data left to
+// compare, so that deeply nested lists and vectors do not recurse
+bool Datum::equal(const Datum& other) const {
+    if (eqv(other)) {
+        return true;
+    } else if (isAtomic() && other.isAtomic() && !value.contains<GCPtr<Vector>>()) {
+        return atomsEqual(value, other.value);
+    }
+    std::vector<std::pair<const Datum*, const Datum*>> pending{{this, &other}};
+    while (!pending.empty()) {
+        const auto [a, b] = pending.back();
+        pending.pop_back();
+        if (a->eqv(*b)) {
+            continue;
+        } else if (a->isAtomic() != b->isAtomic()) {
+            return false;
+        } else if (a->isAtomic()) {
+            if (!a->value.contains<GCPtr<Vector>>() || !b->value.contains<GCPtr<Vector>>()) {
+                if (!atomsEqual(a->value, b->value)) {
+                    return false;
+                }
+                continue;
+            }
+            const std::vector<Datum>& x = a->value.heapObjectAs<Vector>()->elements;
+            const std::vector<Datum>& y = b->value.heapObjectAs<Vector>()->elements;
+            if (x.size() != y.size()) {
+                return false;
+            }
+            // Pushed last to first, so the first elements are compared first
+            for (size_t i = x.size(); i > 0; --i) {
+                pending.emplace_back(&x[i - 1], &y[i - 1]);
+            }
+            continue;
+        }
+        const SExpr* x = a->getSExpr();
+        const SExpr* y = b->getSExpr();
+        if (x == nullptr || y == nullptr) {
+            return false;
+        }
+        pending.emplace_back(&x->cdr, &y->cdr);
+        pending.emplace_back(&x->car, &y->car);
+    }
+    return true;
+}
+
+uint64_t Datum::eqvHash() const {
+    if (isFixnum()) {
+        return util::hashMix(static_cast<uint64_t>(fixnumValue()));
+    } else if (value.contains<Number>()) {
+        return value.getNumber().hash();
+    }
+    return util::hashMix(value.bits);
+}
+
+uint64_t Datum::equalHash() const {
+    size_t budget = equalHashBudget;
+    return ::equalHash(*this, budget);
+}
+
+const std::string* Symbol::intern(std::string_view str) {
+    // The names are stored in a deque so that they never move once interned
+    static std::deque<std::string> names;
+    static std::unordered_map<std::string_view, const std::string*> index;
+    if (auto it = index.find(str); it != index.end()) {
         return it->second;
     }
+    const std::string& name = names.emplace_back(str);
+    index.emplace(name, &name);
+    return &name;
 }
 
-SymbolTable::value_type& SymbolTable::get(const Symbol& s) {
-    return (*this)[+s];
+SymbolTable::value_type& SymbolTable::
+operator[](Symbol s) {
+    if (value_type* binding = find(s); binding != nullptr) {
+        return *binding;
+    }
+    throw LispError("Undefined Symbol: ", s);
+}
+
+SymbolTable::value_type* SymbolTable::findHere(Symbol s) {
+    if (auto it = table.find(s); it != table.end()) {
+        return &it->second;
+    }
+    if (slotNames != nullptr) {
+        // Search from the back so that the last of any duplicate parameters wins
+        for (size_t i = slotNames->size(); i > 0; --i) {
+            if ((*slotNames)[i - 1] == s) {
+                return &slots[i - 1];
+            }
+        }
+    }
+    return nullptr;
+}
+
+SymbolTable::value_type* SymbolTable::find(Symbol s) {
+    for (SymbolTable* scope = this; scope != nullptr; scope = scope->parent.get()) {
+        if (value_type* binding = scope->findHere(s); binding != nullptr) {
+            return binding;
+        }
+    }
+    return nullptr;
+}
+
+Datum SymbolTable::lookup(Symbol s) {
+    for (SymbolTable* scope = this; scope != nullptr; scope = scope->parent.get()) {
+        if (value_type* binding = scope->findHere(s); binding != nullptr) {
+            return valueOf(*binding, s);
+        }
+    }
+    throw LispError("Undefined Symbol: ", s);
+}
+
+const Datum& SymbolTable::valueOf(const value_type& binding, Symbol s) {
+    if (const Datum* datum = std::get_if<Datum>(&binding)) {
+        return *datum;
+    }
+    throw LispError("Syntactic keyword may not be used as an expression: ", s);
 }
 
 SymbolTable::value_type& SymbolTable::get(const Atom& atom) {
-    return (*this)[+atom.get<Symbol>()];
+    return (*this)[atom.get<Symbol>()];
+}
+
+void SymbolTable::traverse(GCVisitor& visitor) const {
+    if (parent != nullptr) {
+        visitor.visit(parent.get());
+    }
+    for (const auto& [name, value] : table) {
+        if (const Datum* datum = std::get_if<Datum>(&value)) {
+            datum->traverse(visitor);
+        }
+    }
+    for (const value_type& value : slots) {
+        if (const Datum* datum = std::get_if<Datum>(&value)) {
+            datum->traverse(visitor);
+        }
+    }
+}
+
+void SymbolTable::clear() {
+    table.clear();
+    slots.clear();
+    parent = nullptr;
 }
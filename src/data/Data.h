@@ -2,139 +2,410 @@
 #pragma once
 
 #include "data/Error.h"
+#include "data/Heap.h"
 #include "data/Number.h"
+#include "util/Span.h"
 #include "util/Util.h"
 
+#include <cstdint>
+#include <cstring>
 #include <functional>
 #include <list>
 #include <memory>
 #include <optional>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <unordered_map>
 #include <variant>
 #include <vector>
 
 struct SExpr;
-using SExprPtr = std::shared_ptr<SExpr>;
+using SExprPtr = GCPtr<SExpr>;
 class SymbolTable;
+class Datum;
+class Evaluator;
+class LispFunction;
+struct CodeObject;
+template<typename T>
+struct NumericVector;
+using F64Vector = NumericVector<double>;
+using S64Vector = NumericVector<int64_t>;
+struct Vector;
+class HashTable;
+
+// Built in procedures receive their arguments already evaluated, as a view into
+// storage owned by the caller
+using ArgSpan = Span<const Datum>;
+using BuiltInFunc = Datum(ArgSpan, Evaluator&);
+
+// Class used for representing "symbols". Symbols are interned: every symbol with
+// a given name points to the same copy of the name, so they are compared and
+// hashed by pointer
+class Symbol {
+    const std::string* name;
+
+    static const std::string* intern(std::string_view str);
+
+    friend class Atom;
+    explicit Symbol(const std::string* interned) : name{interned} {}
+  public:
+    explicit Symbol(std::string_view str) : name{intern(str)} {}
 
-// Class used for representing "symbols" -- the data is just a string, but we want a
-// distinct type
-struct Symbol {
-    std::string val;
+    const std::string& operator+() const { return *name; }
 
-    const std::string& operator+() const { return val; }
+    bool operator==(const Symbol& other) const { return name == other.name; }
+    bool operator!=(const Symbol& other) const { return name != other.name; }
 
     friend std::ostream& operator<<(std::ostream& os, const Symbol& sym) {
         return os << +sym;
     }
+
+    friend struct std::hash<Symbol>;
 };
 
-// Type describing a function in lisp: a list of formal parameters together with
-// a definition
-class LispFunction {
-  public:
-    std::vector<Symbol> formalParameters;
-    SExprPtr definition;
-    LispFunction(std::vector<Symbol>&& formals, const SExprPtr& defn,
-        SymbolTable& scope);
+namespace std {
+template<>
+struct hash<Symbol> {
+    size_t operator()(const Symbol& sym) const noexcept {
+        return std::hash<const std::string*>{}(sym.name);
+    }
+};
+}
+
+template<typename T>
+constexpr std::string_view lispTypeName() {
+    if constexpr (std::is_same_v<T, Number>) {
+        return "number";
+    } else if constexpr (std::is_same_v<T, bool>) {
+        return "boolean";
+    } else if constexpr (std::is_same_v<T, char>) {
+        return "char";
+    } else if constexpr (std::is_same_v<T, std::string>) {
+        return "string";
+    } else if constexpr (std::is_same_v<T, Symbol>) {
+        return "symbol";
+    } else if constexpr (std::is_same_v<T, GCPtr<F64Vector>>) {
+        return "f64vector";
+    } else if constexpr (std::is_same_v<T, GCPtr<S64Vector>>) {
+        return "s64vector";
+    } else if constexpr (std::is_same_v<T, GCPtr<Vector>>) {
+        return "vector";
+    } else if constexpr (std::is_same_v<T, GCPtr<HashTable>>) {
+        return "hash-table";
+    } else {
+        return "procedure";
+    }
+}
 
-    std::shared_ptr<SymbolTable> funcScope() const;
-  private:
-    // We maintain a weak ptr; if this is a closure, then we should maintain an
-    // aliased shared ptr to the LispFunction which has a reference count based
-    // on the the parent table
-    std::weak_ptr<SymbolTable> defnScope;
+// A number too large to be stored in an Atom directly (a big integer or a
+// rational), which is kept on the heap
+struct BoxedNumber : GCObject {
+    const Number value;
+
+    explicit BoxedNumber(const Number& num) : value{num} {}
+
+    void traverse(GCVisitor&) const override {}
+    void clear() override {}
 };
 
+// The characters of a string; strings are immutable, so copies share these
+struct BoxedString : GCObject {
+    const std::string value;
+
+    explicit BoxedString(std::string str) : value{std::move(str)} {}
 
-// An Atom is any entity in lisp other than an SExpr (aka pair, cons cell, list)
+    void traverse(GCVisitor&) const override {}
+    void clear() override {}
+};
+
+// A vector of unboxed doubles (an f64vector) or 64-bit integers (an s64vector),
+// stored contiguously so that bulk operations on them are simple loops
+template<typename T>
+struct NumericVector : GCObject {
+    using value_type = T;
+    std::vector<T> elements;
+
+    explicit NumericVector(std::vector<T> elems) : elements{std::move(elems)} {}
+
+    void traverse(GCVisitor&) const override {}
+    void clear() override {}
+};
+
+// An Atom is any entity in lisp other than an SExpr (aka pair, cons cell, list).
+// Atoms are a single tagged word: small integers, doubles, chars, booleans,
+// symbols and builtins are stored directly, and everything else as a pointer
+// to an object on the heap
 class Atom {
-    std::variant<std::monostate, Number, bool, char,
-                 std::string, Symbol, std::shared_ptr<LispFunction>> data{};
+    friend class Datum;
+
+    // The top 16 bits of the word are the tag, and the rest is the payload.
+    // Doubles are stored offset by doubleOffset, which moves their top 16 bits
+    // above all of the other tags (NaNs are made canonical first, so that none
+    // of them wrap around)
+    enum Tag : uint64_t {
+        // Only used by Datum; the payload is null for the empty list
+        PairTag,
+        FunctionTag,
+        // A BoxedNumber
+        NumberTag,
+        // A BoxedString
+        StringTag,
+        F64VectorTag,
+        S64VectorTag,
+        VectorTag,
+        HashTableTag,
+        SymbolTag,
+        BuiltInTag,
+        FixnumTag,
+        // Unspecified, booleans and chars
+        ConstantTag,
+        FirstDoubleTag
+    };
+    // The tags up to this one have a pointer to a heap object as their payload
+    static constexpr uint64_t lastHeapTag = HashTableTag;
+    static constexpr unsigned tagShift = 48;
+    static constexpr uint64_t payloadMask = (uint64_t{1} << tagShift) - 1;
+    static constexpr uint64_t doubleOffset = uint64_t{FirstDoubleTag} << tagShift;
+    static constexpr uint64_t canonicalNaN = 0x7ff8000000000000;
+
+    static constexpr uint64_t constantBits = uint64_t{ConstantTag} << tagShift;
+    static constexpr uint64_t unspecifiedBits = constantBits | 0;
+    static constexpr uint64_t falseBits = constantBits | 1;
+    static constexpr uint64_t trueBits = constantBits | 2;
+    static constexpr uint64_t charBase = 0x100;
+
+    uint64_t bits = unspecifiedBits;
+
+    static uint64_t tagged(Tag tag, uint64_t payload) {
+        return uint64_t{tag} << tagShift | payload;
+    }
+    static uint64_t tagged(Tag tag, const void* ptr) {
+        return tagged(tag, reinterpret_cast<uintptr_t>(ptr));
+    }
+
+    uint64_t tag() const noexcept { return bits >> tagShift; }
+    uint64_t payload() const noexcept { return bits & payloadMask; }
+    bool isDouble() const noexcept { return tag() >= FirstDoubleTag; }
+
+    /// The heap object referred to by this word, or nullptr for immediates
+    GCObject* heapObject() const noexcept {
+        return tag() <= lastHeapTag ? reinterpret_cast<GCObject*>(payload()) : nullptr;
+    }
+    template<typename T>
+    T* heapObjectAs() const noexcept {
+        return static_cast<T*>(heapObject());
+    }
+
+    Atom(Tag tag, GCObject* obj) : bits{tagged(tag, obj)} {
+        if (obj != nullptr) {
+            obj->addRef();
+        }
+    }
+
+    double getDouble() const noexcept {
+        const uint64_t raw = bits - doubleOffset;
+        double d;
+        std::memcpy(&d, &raw, sizeof(d));
+        return d;
+    }
+
+    Number getNumber() const {
+        if (isFixnum()) {
+            return Number{static_cast<long>(fixnumValue())};
+        } else if (isDouble()) {
+            return Number{getDouble()};
+        }
+        return heapObjectAs<BoxedNumber>()->value;
+    }
+
   public:
+    static constexpr int64_t minFixnum = -(int64_t{1} << (tagShift - 1));
+    static constexpr int64_t maxFixnum = (int64_t{1} << (tagShift - 1)) - 1;
+
     Atom() = default;
-    template <typename T, typename = std::enable_if_t<
-                              !std::is_same_v<Atom, std::remove_reference<T>>>>
-    explicit Atom(T&& val) : data(std::forward<T>(val)) {}
+    explicit Atom(const Number& num);
+    explicit Atom(double d) {
+        uint64_t raw;
+        std::memcpy(&raw, &d, sizeof(raw));
+        bits = (d != d ? canonicalNaN : raw) + doubleOffset;
+    }
+    explicit Atom(bool b) : bits{b ? trueBits : falseBits} {}
+    explicit Atom(char c) : bits{constantBits | (charBase + static_cast<unsigned char>(c))} {}
+    explicit Atom(std::string str);
+    explicit Atom(const char* str) : Atom(std::string{str}) {}
+    explicit Atom(Symbol sym) : bits{tagged(SymbolTag, sym.name)} {}
+    explicit Atom(const GCPtr<LispFunction>& func);
+    explicit Atom(const GCPtr<F64Vector>& vec);
+    explicit Atom(const GCPtr<S64Vector>& vec);
+    explicit Atom(const GCPtr<Vector>& vec);
+    explicit Atom(const GCPtr<HashTable>& table);
+    explicit Atom(BuiltInFunc* func)
+        : bits{tagged(BuiltInTag, reinterpret_cast<uintptr_t>(func))} {}
+
+    /// An Atom holding a small integer, in [minFixnum, maxFixnum]
+    static Atom fixnum(int64_t value) noexcept {
+        Atom atom;
+        atom.bits = tagged(FixnumTag, static_cast<uint64_t>(value) & payloadMask);
+        return atom;
+    }
+
+    Atom(const Atom& other) noexcept : bits{other.bits} {
+        if (GCObject* obj = heapObject()) {
+            obj->addRef();
+        }
+    }
+    Atom(Atom&& other) noexcept : bits{other.bits} {
+        other.bits = unspecifiedBits;
+    }
+    Atom& operator=(Atom other) noexcept {
+        std::swap(bits, other.bits);
+        return *this;
+    }
+    ~Atom() {
+        if (GCObject* obj = heapObject()) {
+            obj->dropRef();
+        }
+    }
+
+    bool isFixnum() const noexcept { return tag() == FixnumTag; }
+    int64_t fixnumValue() const noexcept {
+        // Sign extend the payload
+        return static_cast<int64_t>(bits << (64 - tagShift)) >> (64 - tagShift);
+    }
 
     template<typename T>
-    decltype(auto) get() const {
-        return std::get<T>(data);
+    bool contains() const noexcept {
+        if constexpr (std::is_same_v<T, Number>) {
+            return isFixnum() || isDouble() || tag() == NumberTag;
+        } else if constexpr (std::is_same_v<T, bool>) {
+            return bits == trueBits || bits == falseBits;
+        } else if constexpr (std::is_same_v<T, char>) {
+            return tag() == ConstantTag && payload() >= charBase;
+        } else if constexpr (std::is_same_v<T, std::string>) {
+            return tag() == StringTag;
+        } else if constexpr (std::is_same_v<T, Symbol>) {
+            return tag() == SymbolTag;
+        } else if constexpr (std::is_same_v<T, GCPtr<LispFunction>>) {
+            return tag() == FunctionTag;
+        } else if constexpr (std::is_same_v<T, GCPtr<F64Vector>>) {
+            return tag() == F64VectorTag;
+        } else if constexpr (std::is_same_v<T, GCPtr<S64Vector>>) {
+            return tag() == S64VectorTag;
+        } else if constexpr (std::is_same_v<T, GCPtr<Vector>>) {
+            return tag() == VectorTag;
+        } else if constexpr (std::is_same_v<T, GCPtr<HashTable>>) {
+            return tag() == HashTableTag;
+        } else {
+            static_assert(std::is_same_v<T, BuiltInFunc*>, "Not an Atom type");
+            return tag() == BuiltInTag;
+        }
     }
 
+    /// The value as a T, which must be the type of value this holds; strings
+    /// are returned by reference, and everything else by value
     template<typename T>
-    bool contains() const {
-        return std::holds_alternative<T>(data);
+    std::conditional_t<std::is_same_v<T, std::string>, const std::string&, T> get() const {
+        if (!contains<T>()) {
+            throw TypeError(lispTypeName<T>(), typeName());
+        }
+        if constexpr (std::is_same_v<T, Number>) {
+            return getNumber();
+        } else if constexpr (std::is_same_v<T, bool>) {
+            return bits == trueBits;
+        } else if constexpr (std::is_same_v<T, char>) {
+            return static_cast<char>(payload() - charBase);
+        } else if constexpr (std::is_same_v<T, std::string>) {
+            return heapObjectAs<BoxedString>()->value;
+        } else if constexpr (std::is_same_v<T, Symbol>) {
+            return Symbol{reinterpret_cast<const std::string*>(payload())};
+        } else if constexpr (std::is_same_v<T, BuiltInFunc*>) {
+            return reinterpret_cast<BuiltInFunc*>(payload());
+        } else {
+            return T{heapObjectAs<typename T::element_type>()};
+        }
     }
 
+    /// The name of the type of the contained value, for error messages
+    std::string_view typeName() const;
+
     friend std::ostream& operator<<(std::ostream& os, const Atom &atom);
 
     bool operator==(const Atom& other) const;
 };
 
-// Any piece of data: can be an Atom or an SExpr
+// Any piece of data: can be an Atom or an SExpr. Pairs are stored in the same
+// tagged word as Atoms, so a Datum is a single word
 class Datum {
-    std::variant<Atom, SExprPtr> data{};
+    Atom value{};
   public:
     template<typename T>
     std::optional<T> getAtomicValue() const {
-        if (!isAtomic()) {
+        if (!value.contains<T>()) {
             return std::nullopt;
         }
-        const Atom& atom = std::get<Atom>(data);
-        if (!atom.contains<T>()) {
-            return std::nullopt;
-        }
-        return atom.get<T>();
+        return value.get<T>();
     }
     template<typename T>
     bool hasAtomicValue() const {
-        return isAtomic() && std::get<Atom>(data).contains<T>();
+        return value.contains<T>();
     }
 
-    const SExprPtr& getSExpr() const {
-        if (std::holds_alternative<SExprPtr>(data)) {
-            return std::get<SExprPtr>(data);
-        } else {
-            throw LispError("Use of atom as pair");
-        }
+    /// Like getAtomicValue, but throws a TypeError if the datum has the wrong
+    /// type; used for checking the arguments of builtins
+    template<typename T>
+    decltype(auto) getAtomicValueE() const {
+        return value.get<T>();
+    }
+
+    /// Small integers are held directly, and can be operated on without
+    /// converting to a Number
+    bool isFixnum() const noexcept { return value.isFixnum(); }
+    int64_t fixnumValue() const noexcept { return value.fixnumValue(); }
+
+    std::string_view typeName() const {
+        return isAtomic() ? value.typeName() : "pair";
     }
 
+    /// The pair this holds (nullptr for the empty list); the pair is not owned
+    /// by the returned pointer
+    SExpr* getSExpr() const;
+
     const Atom& getAtom() const {
-        if (std::holds_alternative<Atom>(data)) {
-            return std::get<Atom>(data);
+        if (isAtomic()) {
+            return value;
         } else {
             throw LispError("Use of pair as atom");
         }
     }
 
     bool isAtomic() const noexcept {
-        return std::holds_alternative<Atom>(data);
+        return value.tag() != Atom::PairTag;
     }
 
     bool isTrue() const noexcept {
-        if (!isAtomic()) {
-            return true;
-        }
-        std::optional<bool> val = getAtomicValue<bool>();
-        if (val == std::nullopt) {
-            return true;
-        }
-        return *val;
+        return value.bits != Atom::falseBits;
     }
 
     Datum() = default;
-    Datum(Atom atom) : data{std::move(atom)} {}
+    Datum(Atom atom) : value{std::move(atom)} {}
 
-    Datum(SExprPtr ptr) : data{std::move(ptr)} {}
+    Datum(const SExprPtr& ptr);
 
     friend std::ostream &operator<<(std::ostream& os, const Datum& datum);
 
     bool operator==(const Datum& other) const;
 
+    /// eqv?: the same object, or numbers of the same exactness that are equal
+    bool eqv(const Datum& other) const;
+    /// equal?: eqv?, or strings, pairs and vectors with equal contents
+    bool equal(const Datum& other) const;
+    /// Hashes consistent with eqv? and with equal?. The latter only looks at a
+    /// bounded prefix of large structures
+    uint64_t eqvHash() const;
+    uint64_t equalHash() const;
+
     static Datum True() {
         return {Atom{true}};
     }
@@ -143,12 +414,44 @@ class Datum {
         return {Atom{false}};
     }
 
+    /// Visit the heap objects referenced by this datum, for the collector
+    void traverse(GCVisitor& visitor) const {
+        if (GCObject* obj = value.heapObject()) {
+            visitor.visit(obj);
+        }
+    }
+};
+static_assert(sizeof(Datum) == sizeof(uint64_t), "Datum must be a single word");
+
+// Type describing a function in lisp: a list of formal parameters together with
+// a definition, and the scope it was defined in
+class LispFunction : public GCObject {
+  public:
+    std::vector<Symbol> formalParameters;
+    Datum definition;
+    // Bytecode for the definition, filled in by the Compiler when the function
+    // is created; null if the definition uses forms that the compiler does not
+    // support, in which case calls fall back to the tree-walking evaluator
+    std::shared_ptr<const CodeObject> code;
+    bool compiled = false;
+
+    LispFunction(std::vector<Symbol>&& formals, const Datum& defn,
+        GCPtr<SymbolTable> scope);
+    ~LispFunction() override;
+
+    GCPtr<SymbolTable> funcScope() const;
+    const GCPtr<SymbolTable>& scope() const { return defnScope; }
+
+    void traverse(GCVisitor& visitor) const override;
+    void clear() override;
+  private:
+    GCPtr<SymbolTable> defnScope;
 };
 
 // An SExpr/cons cell/pair
 // This is really a pair, while the SExprs we parse are true lists (i.e cdr is always an SExpr)
 // I should make the interface easier to use that way while still supporting general pairs
-struct SExpr : std::enable_shared_from_this<SExpr> {
+struct SExpr : GCObject {
     Datum car;
     Datum cdr{SExprPtr{nullptr}};
 
@@ -158,12 +461,25 @@ struct SExpr : std::enable_shared_from_this<SExpr> {
 
     explicit SExpr(const Datum& datum) : car{datum} {}
 
+    SExpr(const Datum& first, const Datum& rest) : car{first}, cdr{rest} {}
+
+    void traverse(GCVisitor& visitor) const override {
+        car.traverse(visitor);
+        cdr.traverse(visitor);
+    }
+    void clear() override {
+        car = Datum{};
+        cdr = Datum{};
+    }
+
     class iterator {
         friend struct SExpr;
         friend class LispArgs;
-        SExprPtr curr;
+        // Iterators do not own the list, so they can be advanced without
+        // touching reference counts
+        SExpr* curr;
 
-        iterator(SExprPtr _curr) : curr{_curr} {}
+        iterator(SExpr* _curr) : curr{_curr} {}
 
       public:
         // For std::iterator_traits
@@ -198,9 +514,9 @@ struct SExpr : std::enable_shared_from_this<SExpr> {
     class const_iterator {
         friend struct SExpr;
         friend class LispArgs;
-        std::shared_ptr<const SExpr> curr;
+        const SExpr* curr;
 
-        const_iterator(std::shared_ptr<const SExpr> _curr) : curr{_curr} {}
+        const_iterator(const SExpr* _curr) : curr{_curr} {}
 
       public:
         // For std::iterator_traits
@@ -232,20 +548,49 @@ struct SExpr : std::enable_shared_from_this<SExpr> {
         }
     };
 
-    iterator begin() { return iterator{shared_from_this()}; }
+    iterator begin() { return iterator{this}; }
     iterator end() { return iterator{nullptr}; }
-    const_iterator begin() const { return const_iterator{shared_from_this()}; }
+    const_iterator begin() const { return const_iterator{this}; }
     const_iterator end() const { return const_iterator{nullptr}; }
 
     // TODO: don't depend on this too much as it is O(N)
+    /// The number of pairs in the list; for an improper list, the final atom is
+    /// not counted
     size_t size() const {
-        const SExprPtr& cdrList = cdr.getSExpr();
-        return 1 + (cdrList == nullptr ? 0 : cdrList->size());
+        size_t count = 1;
+        for (const SExpr* cell = this; !cell->cdr.isAtomic() && cell->cdr.getSExpr() != nullptr;
+             cell = cell->cdr.getSExpr()) {
+            ++count;
+        }
+        return count;
     }
 
     friend std::ostream& operator<<(std::ostream& os, const SExpr& expr);
 };
 
+// A vector of any data, stored contiguously, with constant time access by index
+struct Vector : GCObject {
+    std::vector<Datum> elements;
+
+    explicit Vector(std::vector<Datum> elems) : elements{std::move(elems)} {}
+
+    void traverse(GCVisitor& visitor) const override {
+        for (const Datum& datum : elements) {
+            datum.traverse(visitor);
+        }
+    }
+    void clear() override { elements.clear(); }
+};
+
+inline Datum::Datum(const SExprPtr& ptr) : value{Atom::PairTag, ptr.get()} {}
+
+inline SExpr* Datum::getSExpr() const {
+    if (isAtomic()) {
+        throw LispError("Use of atom as pair");
+    }
+    return value.heapObjectAs<SExpr>();
+}
+
 // A wrapper around SExpr used for passing arguments; most notably an "empty arguments SExpr"
 // would be a nullptr, while Args will be iterable and yield an empty iteration
 class LispArgs {
@@ -253,6 +598,7 @@ class LispArgs {
   public:
     LispArgs() = default;
     LispArgs(const SExprPtr& sexpr) : ptr{sexpr.get()} {}
+    LispArgs(SExpr* sexpr) : ptr{sexpr} {}
     LispArgs(const LispArgs&) = delete;
     LispArgs operator=(const LispArgs&) = delete;
     LispArgs(LispArgs&& other) : ptr{other.ptr} {
@@ -303,11 +649,11 @@ class ArityError : public LispError {
 
 
 struct FunctionCall {
-    std::shared_ptr<LispFunction>(func);
+    GCPtr<LispFunction> func;
     LispArgs     args;
     SymbolTable* scope;
 
-    FunctionCall(const std::shared_ptr<LispFunction>& f, LispArgs a, SymbolTable& s) : func(f), args(std::move(a)), scope(&s) {}
+    FunctionCall(const GCPtr<LispFunction>& f, LispArgs a, SymbolTable& s) : func(f), args(std::move(a)), scope(&s) {}
     FunctionCall(const FunctionCall&) = delete;
     FunctionCall& operator=(const FunctionCall&) = delete;
     FunctionCall(FunctionCall&& other) : func(std::move(other.func)), args(std::move(other.args)), scope(other.scope) {}
@@ -320,47 +666,70 @@ struct FunctionCall {
 };
 using EvalResult = std::variant<Datum, FunctionCall>;
 
-class Evaluator;
-// TODO separate BuiltInFunc and specialform; only SpecialForms can return an EvalResult,
-// BuiltInFuncs should return Datum
-using BuiltInFunc = EvalResult(LispArgs, SymbolTable&, Evaluator&);
-using SpecialForm = BuiltInFunc*;
+// Special forms receive their arguments unevaluated, together with the scope in
+// which to evaluate them, and may return a tail call
+using SpecialFormImpl = EvalResult(LispArgs, SymbolTable&, Evaluator&);
+using SpecialForm = SpecialFormImpl*;
 
-class SymbolTable : public std::enable_shared_from_this<SymbolTable> {
+class SymbolTable : public GCObject {
   public:
-    using value_type = std::variant<Datum, SpecialForm, LispFunction>;
+    using value_type = std::variant<Datum, SpecialForm>;
   private:
-    std::unordered_map<std::string, value_type> table{};
-    std::shared_ptr<SymbolTable> parent;
-
-    static inline size_t anonLambdaCount = 0;
+    std::unordered_map<Symbol, value_type> table{};
+    GCPtr<SymbolTable> parent;
+    // Frames of compiled functions hold their variables in slots, which the
+    // bytecode addresses by index; the names are kept so that functions run by
+    // the tree-walking evaluator can still look them up
+    std::vector<value_type> slots{};
+    std::shared_ptr<const std::vector<Symbol>> slotNames{};
   public:
-    explicit SymbolTable(const std::shared_ptr<SymbolTable>& p)
-        : parent{p} {}
-    value_type& operator[](const std::string& s);
-    value_type& get(const Symbol& s);
+    explicit SymbolTable(GCPtr<SymbolTable> p)
+        : parent{std::move(p)} {}
+    /// Create the frame of a compiled function, with one (unspecified) slot per name
+    SymbolTable(GCPtr<SymbolTable> p, std::shared_ptr<const std::vector<Symbol>> names)
+        : parent{std::move(p)}, slots(names->size()), slotNames{std::move(names)} {}
+    value_type& operator[](Symbol s);
     value_type& get(const Atom& datum);
 
-    value_type& emplace(const std::string& s, const Datum& datum) {
+    /// Returns the binding of s in this scope alone, or nullptr if there is none
+    value_type* findHere(Symbol s);
+
+    /// Returns the binding of s in this scope or a parent, or nullptr if there
+    /// is none
+    value_type* find(Symbol s);
+
+    /// Look up the value of a variable as a first class Datum
+    Datum lookup(Symbol s);
+
+    /// The value of a binding, as returned by lookup
+    static const Datum& valueOf(const value_type& binding, Symbol s);
+
+    value_type& slot(size_t i) { return slots[i]; }
+    Symbol slotName(size_t i) const { return (*slotNames)[i]; }
+    bool isFrame() const { return slotNames != nullptr; }
+    SymbolTable* parentScope() const { return parent.get(); }
+
+    value_type& emplace(Symbol s, const Datum& datum) {
         return table.emplace(s, datum).first->second;
     }
 
-    value_type& emplace(const std::string& s, SpecialForm form) {
+    value_type& emplace(Symbol s, SpecialForm form) {
         return table.emplace(s, form).first->second;
     }
 
-    value_type& emplace(const std::string& s, const LispFunction& func) {
-        return table.emplace(s, func).first->second;
+    value_type& emplace(Symbol s, BuiltInFunc* func) {
+        return table.emplace(s, Datum{Atom{func}}).first->second;
     }
 
-    value_type& emplaceAnon(const LispFunction& func) {
-        std::string anonName = std::to_string(anonLambdaCount);
-        anonName.push_back('\x01');
-        ++anonLambdaCount;
-        return emplace(anonName, func);
+    /// Bind s in this scope, replacing any existing binding
+    value_type& define(Symbol s, const Datum& value) {
+        return table.insert_or_assign(s, value).first->second;
     }
 
-    std::shared_ptr<SymbolTable> makeChild() {
-        return std::make_shared<SymbolTable>(shared_from_this());
+    GCPtr<SymbolTable> makeChild() {
+        return makeGC<SymbolTable>(GCPtr<SymbolTable>{this});
     }
+
+    void traverse(GCVisitor& visitor) const override;
+    void clear() override;
 };
@@ -0,0 +1,126 @@
+// (c) Sam Donow 2018
+#include "HashTable.h"
+
+#include <string>
+#include <string_view>
+
+HashTable::HashTable(Kind k, size_t initialSize) : slots{}, kind{k} {
+    // Room for initialSize entries without growing
+    size_t capacity = minCapacity;
+    while (capacity / 4 * 3 < initialSize) {
+        capacity *= 2;
+    }
+    slots.resize(capacity);
+}
+
+uint64_t HashTable::hashOf(const Datum& key) const {
+    switch (kind) {
+    case Kind::Equal:
+        return key.equalHash() | occupied;
+    case Kind::StrongEqv:
+        return key.eqvHash() | occupied;
+    case Kind::String:
+        break;
+    }
+    return util::hashMix(std::hash<std::string_view>{}(key.getAtomicValueE<std::string>())) |
+           occupied;
+}
+
+bool HashTable::keysEqual(const Datum& a, const Datum& b) const {
+    switch (kind) {
+    case Kind::Equal:
+        return a.equal(b);
+    case Kind::StrongEqv:
+        return a.eqv(b);
+    case Kind::String:
+        break;
+    }
+    return a.getAtomicValueE<std::string>() == b.getAtomicValueE<std::string>();
+}
+
+size_t HashTable::probe(const Datum& key, uint64_t hash) const {
+    size_t i = hash & mask();
+    while (slots[i].hash != 0 && (slots[i].hash != hash || !keysEqual(slots[i].key, key))) {
+        i = (i + 1) & mask();
+    }
+    return i;
+}
+
+void HashTable::rehash(size_t capacity) {
+    std::vector<Slot> old(capacity);
+    old.swap(slots);
+    for (Slot& slot : old) {
+        if (slot.hash == 0) {
+            continue;
+        }
+        size_t i = slot.hash & mask();
+        while (slots[i].hash != 0) {
+            i = (i + 1) & mask();
+        }
+        slots[i] = std::move(slot);
+    }
+}
+
+Datum* HashTable::find(const Datum& key) {
+    Slot& slot = slots[probe(key, hashOf(key))];
+    return slot.hash == 0 ? nullptr : &slot.value;
+}
+
+void HashTable::set(const Datum& key, Datum value) {
+    const uint64_t hash = hashOf(key);
+    // Keep the table at most three quarters full, so that probes stay short
+    if ((count + 1) * 4 > slots.size() * 3) {
+        rehash(slots.size() * 2);
+    }
+    Slot& slot = slots[probe(key, hash)];
+    if (slot.hash == 0) {
+        slot.hash = hash;
+        slot.key = key;
+        ++count;
+    }
+    slot.value = std::move(value);
+}
+
+bool HashTable::remove(const Datum& key) {
+    size_t hole = probe(key, hashOf(key));
+    if (slots[hole].hash == 0) {
+        return false;
+    }
+    // Fill the hole with each later entry of the run that would not be found
+    // past it: those whose home slot is not between the hole and themselves
+    for (size_t i = (hole + 1) & mask(); slots[i].hash != 0; i = (i + 1) & mask()) {
+        const size_t home = slots[i].hash & mask();
+        if (((i - home) & mask()) >= ((i - hole) & mask())) {
+            slots[hole] = std::move(slots[i]);
+            hole = i;
+        }
+    }
+    slots[hole] = Slot{};
+    --count;
+    return true;
+}
+
+std::vector<std::pair<Datum, Datum>> HashTable::entries() const {
+    std::vector<std::pair<Datum, Datum>> result;
+    result.reserve(count);
+    for (const Slot& slot : slots) {
+        if (slot.hash != 0) {
+            result.emplace_back(slot.key, slot.value);
+        }
+    }
+    return result;
+}
+
+void HashTable::traverse(GCVisitor& visitor) const {
+    for (const Slot& slot : slots) {
+        if (slot.hash != 0) {
+            slot.key.traverse(visitor);
+            slot.value.traverse(visitor);
+        }
+    }
+}
+
+void HashTable::clear() {
+    std::vector<Slot>(minCapacity).swap(slots);
+    count = 0;
+}
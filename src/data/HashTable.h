@@ -0,0 +1,60 @@
+// (c) Sam Donow 2018
+#pragma once
+#include "data/Data.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/// A hash table from data to data, comparing keys by equal?, by eqv?, or as
+/// strings by string=?.
+///
+/// The table uses open addressing: entries are stored inline in an array whose
+/// size is a power of two, and a key is found by probing linearly from the slot
+/// its hash selects. Each slot caches the hash of its key, so probing compares
+/// keys only when the hashes match, and removal shifts the entries after a
+/// removed one back rather than leaving tombstones
+class HashTable : public GCObject {
+  public:
+    enum class Kind { Equal, StrongEqv, String };
+
+  private:
+    struct Slot {
+        // The hash of the key with the top bit set, or 0 if the slot is empty
+        uint64_t hash = 0;
+        Datum key{};
+        Datum value{};
+    };
+    static constexpr uint64_t occupied = uint64_t{1} << 63;
+    static constexpr size_t minCapacity = 8;
+
+    std::vector<Slot> slots;
+    size_t count = 0;
+    Kind kind;
+
+    uint64_t hashOf(const Datum& key) const;
+    bool keysEqual(const Datum& a, const Datum& b) const;
+    size_t mask() const { return slots.size() - 1; }
+    /// The slot holding key, or the empty slot at which its probe ends
+    size_t probe(const Datum& key, uint64_t hash) const;
+    /// Move the entries into a table of the given capacity
+    void rehash(size_t capacity);
+
+  public:
+    explicit HashTable(Kind k, size_t initialSize = 0);
+
+    /// The value for key, or nullptr if it is absent. The pointer is
+    /// invalidated by the next insertion
+    Datum* find(const Datum& key);
+    void set(const Datum& key, Datum value);
+    /// Remove the entry for key, returning whether there was one
+    bool remove(const Datum& key);
+
+    size_t size() const { return count; }
+
+    /// A copy of the entries, which may be iterated over while the table changes
+    std::vector<std::pair<Datum, Datum>> entries() const;
+
+    void traverse(GCVisitor& visitor) const override;
+    void clear() override;
+};
@@ -0,0 +1,254 @@
+// (c) 2018 Sam Donow
+#include "Heap.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <ostream>
+
+namespace {
+constexpr uint32_t reachable = std::numeric_limits<uint32_t>::max();
+constexpr uint32_t tenured = reachable - 1;
+
+using Clock = std::chrono::steady_clock;
+
+double toMillis(std::chrono::nanoseconds time) {
+    return std::chrono::duration<double, std::milli>(time).count();
+}
+}
+
+std::ostream& operator<<(std::ostream& os, const GCStats& stats) {
+    return os << "minor collections: " << stats.minorCollections
+              << " (" << toMillis(stats.minorPauses) << "ms)"
+              << ", major collections: " << stats.majorCollections
+              << " (" << toMillis(stats.majorPauses) << "ms)"
+              << ", longest pause: " << toMillis(stats.longestPause) << "ms";
+}
+
+Heap::Heap() {
+    young.prev = &young;
+    young.next = &young;
+    old.prev = &old;
+    old.next = &old;
+}
+
+void Heap::track(GCObject* obj) {
+    obj->prev = young.prev;
+    obj->next = &young;
+    young.prev->next = obj;
+    young.prev = obj;
+    ++objectCount;
+    if (--allocationsUntilMinor == 0) {
+        collectYoung();
+    }
+}
+
+void Heap::release(GCObject* obj) {
+    pendingFree.push_back(obj);
+    if (freeing) {
+        return;
+    }
+    freeing = true;
+    while (!pendingFree.empty()) {
+        GCObject* next = pendingFree.back();
+        pendingFree.pop_back();
+        free(next);
+    }
+    freeing = false;
+}
+
+void Heap::free(GCObject* obj) {
+    obj->prev->next = obj->next;
+    obj->next->prev = obj->prev;
+    --objectCount;
+    delete obj;
+}
+
+void Heap::setNurserySize(size_t size) {
+    nurserySize = std::max<size_t>(size, 1);
+    allocationsUntilMinor = nurserySize;
+}
+
+void Heap::promoteYoung() {
+    if (young.next == &young) {
+        return;
+    }
+    young.next->prev = old.prev;
+    old.prev->next = young.next;
+    young.prev->next = &old;
+    old.prev = young.prev;
+    young.next = &young;
+    young.prev = &young;
+}
+
+void Heap::collectYoung() {
+    const Clock::time_point start = Clock::now();
+    promoted += collectList(young);
+    promoteYoung();
+    allocationsUntilMinor = nurserySize;
+
+    const std::chrono::nanoseconds pause = Clock::now() - start;
+    ++gcStats.minorCollections;
+    gcStats.minorPauses += pause;
+    gcStats.longestPause = std::max(gcStats.longestPause, pause);
+    if (promoted >= promotionLimit) {
+        collect();
+    }
+}
+
+void Heap::collect() {
+    const Clock::time_point start = Clock::now();
+    promoteYoung();
+    collectList(old);
+    promoted = 0;
+    promotionLimit = std::max(minMajorInterval, objectCount);
+    allocationsUntilMinor = nurserySize;
+
+    const std::chrono::nanoseconds pause = Clock::now() - start;
+    ++gcStats.majorCollections;
+    gcStats.majorPauses += pause;
+    gcStats.longestPause = std::max(gcStats.longestPause, pause);
+}
+
+size_t Heap::collectList(Head& list) {
+    // Start from the reference counts, and subtract the references from other
+    // objects in the list: objects left with a positive count are referenced
+    // from elsewhere (the evaluator and VM stacks, global scopes, the old
+    // generation etc.), so they are the roots
+    for (GCObject* obj = list.next; obj != &list; obj = obj->next) {
+        obj->gcRefs = obj->refCount;
+    }
+    struct Subtract : GCVisitor {
+        void visit(GCObject* obj) override {
+            if (obj->gcRefs != tenured) {
+                --obj->gcRefs;
+            }
+        }
+    } subtract;
+    for (GCObject* obj = list.next; obj != &list; obj = obj->next) {
+        obj->traverse(subtract);
+    }
+
+    // Mark everything in the list reachable from the roots
+    struct Mark : GCVisitor {
+        std::vector<GCObject*> stack{};
+        void visit(GCObject* obj) override {
+            if (obj->gcRefs != reachable && obj->gcRefs != tenured) {
+                obj->gcRefs = reachable;
+                stack.push_back(obj);
+            }
+        }
+    } mark;
+    for (GCObject* obj = list.next; obj != &list; obj = obj->next) {
+        if (obj->gcRefs == 0 || obj->gcRefs == reachable) {
+            continue;
+        }
+        mark.visit(obj);
+        while (!mark.stack.empty()) {
+            GCObject* live = mark.stack.back();
+            mark.stack.pop_back();
+            live->traverse(mark);
+        }
+    }
+
+    // Sweep: everything else is only referenced by garbage. Hold on to the
+    // garbage while clearing it, so that nothing is freed from under us
+    std::vector<GCObject*> garbage;
+    size_t survivors = 0;
+    for (GCObject* obj = list.next; obj != &list; obj = obj->next) {
+        if (obj->gcRefs == reachable) {
+            obj->gcRefs = tenured;
+            ++survivors;
+        } else {
+            ++obj->refCount;
+            garbage.push_back(obj);
+        }
+    }
+    for (GCObject* obj : garbage) {
+        obj->clear();
+    }
+    for (GCObject* obj : garbage) {
+        if (--obj->refCount == 0) {
+            release(obj);
+        }
+    }
+    return survivors;
+}
+
+void* Heap::allocate(size_t size) {
+    if (size > maxSmallSize) {
+        return ::operator new(size);
+    }
+    const size_t cellSize = (size + granularity - 1) / granularity * granularity;
+    Pool& pool = pools[cellSize / granularity - 1];
+    if (pool.current != nullptr) {
+        if (void* cell = takeCell(pool.current, cellSize)) {
+            return cell;
+        }
+    }
+    return allocateSlow(pool, cellSize);
+}
+
+void* Heap::takeCell(Block* block, size_t cellSize) {
+    if (block->cursor != block->limit) {
+        void* cell = block->cursor;
+        block->cursor += cellSize;
+        ++block->live;
+        return cell;
+    }
+    if (FreeCell* cell = block->freeCells) {
+        block->freeCells = cell->next;
+        ++block->live;
+        return cell;
+    }
+    return nullptr;
+}
+
+void* Heap::allocateSlow(Pool& pool, size_t cellSize) {
+    // The current block is full; blocks only become available again once
+    // some of their cells are freed
+    Block* block = pool.available;
+    if (block != nullptr) {
+        pool.available = block->nextAvailable;
+        block->available = false;
+    } else {
+        void* memory = std::aligned_alloc(blockSize, blockSize);
+        if (memory == nullptr) {
+            throw std::bad_alloc{};
+        }
+        char* cells = static_cast<char*>(memory) + blockHeaderSize;
+        char* limit = cells + (blockSize - blockHeaderSize) / cellSize * cellSize;
+        block = new (memory) Block{nullptr, cells, limit, nullptr, 0, false};
+    }
+    pool.current = block;
+    return takeCell(block, cellSize);
+}
+
+void Heap::resetBlock(Block* block) {
+    block->freeCells = nullptr;
+    block->cursor = reinterpret_cast<char*>(block) + blockHeaderSize;
+}
+
+void Heap::deallocate(void* ptr, size_t size) {
+    if (size > maxSmallSize) {
+        ::operator delete(ptr);
+        return;
+    }
+    const size_t cellSize = (size + granularity - 1) / granularity * granularity;
+    Pool& pool = pools[cellSize / granularity - 1];
+    Block* block = reinterpret_cast<Block*>(
+        reinterpret_cast<uintptr_t>(ptr) & ~(uintptr_t{blockSize} - 1));
+    if (--block->live == 0) {
+        resetBlock(block);
+    } else {
+        FreeCell* cell = static_cast<FreeCell*>(ptr);
+        cell->next = block->freeCells;
+        block->freeCells = cell;
+    }
+    if (block != pool.current && !block->available) {
+        block->available = true;
+        block->nextAvailable = pool.available;
+        pool.available = block;
+    }
+}
@@ -0,0 +1,235 @@
+// (c) 2018 Sam Donow
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <utility>
+#include <vector>
+
+class GCObject;
+
+/// Callback used by the collector to find the heap objects referenced by an object
+class GCVisitor {
+  public:
+    virtual void visit(GCObject* obj) = 0;
+    virtual ~GCVisitor() = default;
+};
+
+/// Base class of everything on the garbage collected heap: pairs, environments
+/// and closures. Objects are reference counted (without atomics), so that most
+/// garbage is freed as soon as it becomes unreachable; the Heap's collector then
+/// finds and frees the cycles that reference counting cannot
+class GCObject {
+    friend class Heap;
+
+    // All objects are kept in a doubly linked list per generation, so that the
+    // collector can find them and freed objects can be unlinked in constant time
+    GCObject* prev = nullptr;
+    GCObject* next = nullptr;
+    uint32_t refCount = 0;
+    // Scratch space for the collector: the number of references from outside
+    // of the objects being collected, or reachable if the object has been found
+    // to be live. Between collections, marks the objects in the old generation
+    uint32_t gcRefs = 0;
+
+  protected:
+    GCObject() = default;
+
+  public:
+    GCObject(const GCObject&) = delete;
+    GCObject& operator=(const GCObject&) = delete;
+    virtual ~GCObject() = default;
+
+    /// Visit each heap object directly referenced by this one
+    virtual void traverse(GCVisitor& visitor) const = 0;
+    /// Drop all references to other heap objects, to break a garbage cycle
+    virtual void clear() = 0;
+
+    /// Manual reference counting, for owners that do not hold objects through
+    /// a GCPtr (the tagged words of Atoms)
+    void addRef() { ++refCount; }
+    inline void dropRef();
+
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr, size_t size);
+};
+
+/// Counts and pause times of the collections run so far
+struct GCStats {
+    size_t minorCollections = 0;
+    size_t majorCollections = 0;
+    std::chrono::nanoseconds minorPauses{};
+    std::chrono::nanoseconds majorPauses{};
+    std::chrono::nanoseconds longestPause{};
+
+    friend std::ostream& operator<<(std::ostream& os, const GCStats& stats);
+};
+
+/// The garbage collected heap. There is a single heap for the process, as data
+/// is shared freely between the parser and evaluators.
+///
+/// Objects start out in the young generation. Once nurserySize objects have been
+/// allocated, a minor collection frees the young garbage and promotes the
+/// survivors to the old generation, which is only collected (by a major
+/// collection) once it has doubled in size. A minor collection treats every
+/// young object with references from outside the young generation as a root,
+/// so a store of a young object into an old one needs no separate write
+/// barrier: the reference count of the young object is the remembered set
+class Heap {
+    // Sentinel of a list of objects
+    struct Head : GCObject {
+        void traverse(GCVisitor&) const override {}
+        void clear() override {}
+    };
+    Head young{};
+    Head old{};
+    size_t objectCount = 0;
+    size_t nurserySize = defaultNurserySize;
+    size_t allocationsUntilMinor = defaultNurserySize;
+    // Objects promoted since the last major collection, and the number of them
+    // that triggers the next one
+    size_t promoted = 0;
+    size_t promotionLimit = minMajorInterval;
+    GCStats gcStats{};
+
+    // Objects whose last reference has been dropped. Freeing an object drops its
+    // own references, so this is used to free long lists without recursion
+    std::vector<GCObject*> pendingFree{};
+    bool freeing = false;
+
+    // Small objects are allocated from blocks of cells of a single size, by
+    // bumping a pointer through the block and then reusing the cells freed in
+    // it. A block whose cells are all freed is reset, so the memory of short
+    // lived objects is reused in allocation order
+    struct FreeCell {
+        FreeCell* next;
+    };
+    struct Block {
+        FreeCell* freeCells;
+        char* cursor;
+        char* limit;
+        Block* nextAvailable;
+        uint32_t live;
+        bool available;
+    };
+    struct Pool {
+        Block* current = nullptr;
+        // Blocks other than the current one with free cells
+        Block* available = nullptr;
+    };
+    static constexpr size_t blockSize = 32 * 1024;
+    static constexpr size_t granularity = 16;
+    static constexpr size_t maxSmallSize = 256;
+    static constexpr size_t blockHeaderSize =
+        (sizeof(Block) + granularity - 1) / granularity * granularity;
+    Pool pools[maxSmallSize / granularity]{};
+
+    static constexpr size_t defaultNurserySize = 8192;
+    static constexpr size_t minMajorInterval = 10000;
+
+    Heap();
+    void free(GCObject* obj);
+    /// Trial deletion over the objects in list: free those that are only
+    /// reachable from garbage, and tenure the rest. References to objects that
+    /// are already tenured are ignored. Returns the number of survivors
+    size_t collectList(Head& list);
+    /// Move all of the young objects to the old generation
+    void promoteYoung();
+    void* allocateSlow(Pool& pool, size_t cellSize);
+    static void* takeCell(Block* block, size_t cellSize);
+    static void resetBlock(Block* block);
+
+  public:
+    Heap(const Heap&) = delete;
+    Heap& operator=(const Heap&) = delete;
+
+    static Heap& get() {
+        // Never destroyed, as objects may outlive any static destruction order
+        static Heap* heap = new Heap;
+        return *heap;
+    }
+
+    /// Start tracking a newly allocated object, possibly running a collection
+    void track(GCObject* obj);
+    /// Called when the last reference to obj is dropped
+    void release(GCObject* obj);
+
+    /// Free the garbage in the young generation, and promote the survivors
+    void collectYoung();
+    /// Free all objects that are only reachable from garbage cycles
+    void collect();
+
+    size_t size() const { return objectCount; }
+    const GCStats& stats() const { return gcStats; }
+    /// Set the number of allocations between minor collections
+    void setNurserySize(size_t size);
+
+    void* allocate(size_t size);
+    void deallocate(void* ptr, size_t size);
+};
+
+inline void GCObject::dropRef() {
+    if (--refCount == 0) {
+        Heap::get().release(this);
+    }
+}
+
+inline void* GCObject::operator new(size_t size) {
+    return Heap::get().allocate(size);
+}
+
+inline void GCObject::operator delete(void* ptr, size_t size) {
+    Heap::get().deallocate(ptr, size);
+}
+
+/// An owning pointer to an object on the heap. Copies only adjust the
+/// (non-atomic) reference count of the object
+template<typename T>
+class GCPtr {
+    T* ptr = nullptr;
+
+    void retain() const {
+        if (ptr != nullptr) {
+            static_cast<GCObject*>(ptr)->addRef();
+        }
+    }
+
+  public:
+    using element_type = T;
+
+    GCPtr() = default;
+    GCPtr(std::nullptr_t) {}
+    explicit GCPtr(T* p) : ptr(p) { retain(); }
+    GCPtr(const GCPtr& other) : ptr(other.ptr) { retain(); }
+    GCPtr(GCPtr&& other) noexcept : ptr(other.ptr) { other.ptr = nullptr; }
+
+    GCPtr& operator=(GCPtr other) noexcept {
+        std::swap(ptr, other.ptr);
+        return *this;
+    }
+
+    ~GCPtr() {
+        if (ptr != nullptr) {
+            static_cast<GCObject*>(ptr)->dropRef();
+        }
+    }
+
+    T* get() const { return ptr; }
+    T& operator*() const { return *ptr; }
+    T* operator->() const { return ptr; }
+    explicit operator bool() const { return ptr != nullptr; }
+
+    bool operator==(const GCPtr& other) const { return ptr == other.ptr; }
+    bool operator!=(const GCPtr& other) const { return ptr != other.ptr; }
+    bool operator==(std::nullptr_t) const { return ptr == nullptr; }
+    bool operator!=(std::nullptr_t) const { return ptr != nullptr; }
+};
+
+/// Allocate a new object on the heap
+template<typename T, typename... Args>
+GCPtr<T> makeGC(Args&&... args) {
+    GCPtr<T> ptr{new T(std::forward<Args>(args)...)};
+    Heap::get().track(ptr.get());
+    return ptr;
+}
@@ -6,31 +6,69 @@
 #include "data/Rational.h"
 #include "util/Util.h"
 
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <limits>
 #include <math.h>
+#include <optional>
+#include <utility>
 #include <variant>
 
 /// Type to encapsulate numbers as represented in Scheme
 class Number {
     using Rat = Rational<BigInt>;
     // TODO: add support for Complex
-    // std::variant<BigInt, double, Rational, Complex> data
-    std::variant<BigInt, double, Rat> data;
+    // std::variant<int64_t, BigInt, double, Rational, Complex> data
+    // Integers that fit in an int64_t are always held as one, so that most
+    // arithmetic never touches BigInt; a BigInt only holds integers outside of
+    // that range
+    using Data = std::variant<int64_t, BigInt, double, Rat>;
+    Data data;
+
+    static Data fromBigInt(const BigInt& bnum) {
+        if (std::optional<int64_t> small = bnum.toInt64()) {
+            return *small;
+        }
+        return bnum;
+    }
+    static Data fromBigInt(BigInt&& bnum) {
+        if (std::optional<int64_t> small = bnum.toInt64()) {
+            return *small;
+        }
+        return std::move(bnum);
+    }
+
+    static Data fromUnsigned(unsigned long ulnum) {
+        if (ulnum <= static_cast<unsigned long>(std::numeric_limits<int64_t>::max())) {
+            return static_cast<int64_t>(ulnum);
+        }
+        return BigInt{static_cast<uint64_t>(ulnum)};
+    }
+
+    // Operations on mixed types are carried out on BigInts in place of int64_ts
+    static BigInt widen(int64_t val) { return BigInt{val}; }
+    template<typename T>
+    static const T& widen(const T& val) { return val; }
+
+    const int64_t* small() const noexcept { return std::get_if<int64_t>(&data); }
 
   public:
     // Default construct with long value, as long will get coerced to other
     // types in operations
-    Number() : data{BigInt{0}} {}
-    Number (long lnum) : data{BigInt{lnum}} {}
-    Number (unsigned long ulnum) : data{BigInt{ulnum}} {}
-    Number (const BigInt& bnum) : data{bnum} {}
+    Number() : data{int64_t{0}} {}
+    Number (long lnum) : data{int64_t{lnum}} {}
+    Number (unsigned long ulnum) : data{fromUnsigned(ulnum)} {}
+    Number (const BigInt& bnum) : data{fromBigInt(bnum)} {}
+    Number (BigInt&& bnum) : data{fromBigInt(std::move(bnum))} {}
     Number (double dnum) : data{dnum} {}
     Number (const Rat& rat) : data{rat} {}
 
   private:
     template<template<typename> typename F, typename R>
     const R opImpl(const Number& other) const {
-        return std::visit(Visitor {
+        return std::visit([](const auto& a1, const auto& a2) {
+          return Visitor {
             [](double v1, const BigInt& v2) {
                 return R{F<double>{}(v1, static_cast<double>(v2))};
             },
@@ -60,26 +98,85 @@ class Number {
             [](const Rat& v1, const BigInt& v2) {
                 return R{F<Rat>{}(v1, Rat{v2})};
             }
+          }(widen(a1), widen(a2));
         }, data, other.data);
     }
 
+    // Update a BigInt in place by an exact integer, so that accumulating into it
+    // reuses its digits. Returns false if the operands are of other types
+    template<typename Op>
+    bool updateBig(const Number& other, Op op) {
+        BigInt* big = std::get_if<BigInt>(&data);
+        if (big == nullptr) {
+            return false;
+        } else if (const int64_t* v = other.small()) {
+            op(*big, BigInt{*v});
+        } else if (const BigInt* v2 = std::get_if<BigInt>(&other.data)) {
+            op(*big, *v2);
+        } else {
+            return false;
+        }
+        if (std::optional<int64_t> demoted = big->toInt64()) {
+            data = *demoted;
+        }
+        return true;
+    }
+
+    // Comparisons of two int64_ts are done directly
+    template<template<typename> typename F>
+    bool compareImpl(const Number& other) const {
+        if (const int64_t *v1 = small(), *v2 = other.small(); v1 && v2) {
+            return F<int64_t>{}(*v1, *v2);
+        }
+        return opImpl<F, bool>(other);
+    }
+
   public:
-    const Number operator+(const Number& other) const { return opImpl<std::plus, Number>(other); }
+    // Arithmetic on two int64_ts is done directly, falling back on BigInt only
+    // when the result overflows
+    const Number operator+(const Number& other) const {
+        if (const int64_t *v1 = small(), *v2 = other.small(); v1 && v2) {
+            if (int64_t result; !__builtin_add_overflow(*v1, *v2, &result)) {
+                return Number{result};
+            }
+        }
+        return opImpl<std::plus, Number>(other);
+    }
 
-    const Number operator-(const Number& other) const { return opImpl<std::minus, Number>(other); }
+    const Number operator-(const Number& other) const {
+        if (const int64_t *v1 = small(), *v2 = other.small(); v1 && v2) {
+            if (int64_t result; !__builtin_sub_overflow(*v1, *v2, &result)) {
+                return Number{result};
+            }
+        }
+        return opImpl<std::minus, Number>(other);
+    }
 
-    const Number operator*(const Number& other) const { return opImpl<std::multiplies, Number>(other); }
+    const Number operator*(const Number& other) const {
+        if (const int64_t *v1 = small(), *v2 = other.small(); v1 && v2) {
+            if (int64_t result; !__builtin_mul_overflow(*v1, *v2, &result)) {
+                return Number{result};
+            }
+        }
+        return opImpl<std::multiplies, Number>(other);
+    }
 
     const Number operator-() const {
-        return std::visit([](const auto& v1) { return Number{-v1}; }, data);
+        if (const int64_t* v = small()) {
+            if (int64_t result; !__builtin_sub_overflow(int64_t{0}, *v, &result)) {
+                return Number{result};
+            }
+        }
+        return std::visit([](const auto& v1) { return Number{-widen(v1)}; }, data);
     }
 
     const Number operator+() const {
-        return std::visit([](const auto& v1) { return Number{+v1}; }, data);
+        return *this;
     }
 
     const Number operator/(const Number& other) const {
-        return std::visit(Visitor {
+        return std::visit([](const auto& a1, const auto& a2) {
+          return Visitor {
             [](double v1, const BigInt& v2) { return Number{v1 / static_cast<double>(v2)}; },
             [](double v1, const Rat& v2) { return Number{v1 / static_cast<double>(v2)}; },
             [](const BigInt& v1, double v2) { return Number{static_cast<double>(v1) / v2}; },
@@ -90,54 +187,129 @@ class Number {
             [](const BigInt& v1, const Rat& v2) { return Number{Rat{v1} / v2}; },
             [](const BigInt& v1, const BigInt& v2) { return Number{Rat{v1, v2}}; },
             [](const Rat& v1, const Rat& v2) { return Number{v1 / v2}; }
+          }(widen(a1), widen(a2));
         }, data, other.data);
     }
 
+    /// Integer division, truncating towards zero
+    const Number quotient(const Number& other) const {
+        if (const int64_t *v1 = small(), *v2 = other.small(); v1 && v2) {
+            if (unlikely(*v2 == 0)) {
+                throw LispError("Division by zero");
+            } else if (*v2 != -1) {
+                return Number{*v1 / *v2};
+            }
+            return -*this;
+        }
+        return std::visit(
+            [](const auto& a1, const auto& a2) {
+                return Visitor{[](const BigInt& v1, const BigInt& v2) { return Number{v1 / v2}; },
+                               [](const auto&, const auto&) -> Number { throw TypeError("exact", "inexact"); }}(
+                    widen(a1), widen(a2));
+            },
+            data, other.data);
+    }
+
     const Number operator%(const Number& other) const {
+        if (const int64_t *v1 = small(), *v2 = other.small(); v1 && v2) {
+            if (unlikely(*v2 == 0)) {
+                throw LispError("Division by zero");
+            }
+            // Avoid the overflow of INT64_MIN % -1
+            return Number{*v2 == -1 ? 0L : *v1 % *v2};
+        }
         return std::visit(
-            Visitor{[](const BigInt& v1, const BigInt& v2) { return Number{v1 % v2}; },
-                    [](const auto&, const auto&) -> Number { throw TypeError("exact", "inexact"); }},
+            [](const auto& a1, const auto& a2) {
+                return Visitor{[](const BigInt& v1, const BigInt& v2) { return Number{v1 % v2}; },
+                               [](const auto&, const auto&) -> Number { throw TypeError("exact", "inexact"); }}(
+                    widen(a1), widen(a2));
+            },
             data, other.data);
     }
 
-    Number& operator+=(const Number& other) { return *this = *this + other; }
-    Number& operator-=(const Number& other) { return *this = *this - other; }
-    Number& operator*=(const Number& other) { return *this = *this * other; }
+    Number& operator+=(const Number& other) {
+        if (updateBig(other, [](BigInt& v1, const BigInt& v2) { v1 += v2; })) {
+            return *this;
+        }
+        return *this = *this + other;
+    }
+    Number& operator-=(const Number& other) {
+        if (updateBig(other, [](BigInt& v1, const BigInt& v2) { v1 -= v2; })) {
+            return *this;
+        }
+        return *this = *this - other;
+    }
+    Number& operator*=(const Number& other) {
+        if (updateBig(other, [](BigInt& v1, const BigInt& v2) { v1 *= v2; })) {
+            return *this;
+        }
+        return *this = *this * other;
+    }
     Number& operator/=(const Number& other) { return *this = *this / other; }
     Number& operator%=(const Number& other) { return *this = *this % other; }
 
     bool operator==(const Number& other) const {
-        return opImpl<std::equal_to, bool>(other);
+        return compareImpl<std::equal_to>(other);
     }
     bool operator!=(const Number& other) const {
-        return opImpl<std::not_equal_to, bool>(other);
+        return compareImpl<std::not_equal_to>(other);
     }
     bool operator<(const Number& other) const {
-        return opImpl<std::less, bool>(other);
+        return compareImpl<std::less>(other);
     }
     bool operator>(const Number& other) const {
-        return opImpl<std::greater, bool>(other);
+        return compareImpl<std::greater>(other);
     }
     bool operator<=(const Number& other) const {
-        return opImpl<std::less_equal, bool>(other);
+        return compareImpl<std::less_equal>(other);
     }
     bool operator>=(const Number& other) const {
-        return opImpl<std::greater_equal, bool>(other);
+        return compareImpl<std::greater_equal>(other);
     }
 
     friend std::ostream& operator<<(std::ostream& os, const Number& num) {
-        return std::visit([&os](auto v) -> std::ostream& { return os << v; }, num.data);
+        return std::visit([&os](const auto& v) -> std::ostream& { return os << v; }, num.data);
     }
 
     Number abs() const {
         return std::visit(Visitor{
+            [this](int64_t v) -> Number { return v < 0 ? -*this : *this; },
             [](const BigInt& v) -> Number { return v.abs(); },
             [](double v) -> Number { return fabs(v); },
             [](const Rat& v) -> Number { return v < Rat{BigInt{0}} ? -v : v; }
         }, data);
     }
 
-    bool isExact() const { return std::holds_alternative<BigInt>(data); }
+    explicit operator double() const {
+        return std::visit([](const auto& v) { return static_cast<double>(v); }, data);
+    }
+
+    /// A hash consistent with numeric equality among numbers of the same
+    /// exactness: integers held as rationals hash as integers, and the two zeroes
+    /// of doubles alike
+    uint64_t hash() const {
+        return std::visit(Visitor{
+            [](int64_t v) { return util::hashMix(static_cast<uint64_t>(v)); },
+            [](const BigInt& v) { return v.hash(); },
+            [](double v) {
+                uint64_t raw;
+                const double normalized = v == 0.0 ? 0.0 : v;
+                std::memcpy(&raw, &normalized, sizeof(raw));
+                return util::hashMix(raw);
+            },
+            [](const Rat& v) {
+                if (v.denominator() == BigInt{1}) {
+                    return Number{v.numerator()}.hash();
+                }
+                return util::hashCombine(v.numerator().hash(), v.denominator().hash());
+            }
+        }, data);
+    }
+
+    bool isExact() const { return is<int64_t>() || is<BigInt>(); }
+
+    template<typename T>
+    bool is() const { return std::holds_alternative<T>(data); }
 
     template<typename T>
     decltype(auto) as() const {
@@ -145,6 +317,9 @@ class Number {
     }
 
     uint64_t ulong() const {
+        if (const int64_t* v = small()) {
+            return static_cast<uint64_t>(*v);
+        }
         return static_cast<uint64_t>(std::get<BigInt>(data));
     }
 };
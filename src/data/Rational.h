@@ -3,65 +3,152 @@
 #include "util/Util.h"
 #pragma once
 
-/// A general Rational type. TODO: optimize for our case of Numeric=BigInt
+#include <type_traits>
+#include <utility>
+
+/// A general Rational type. For Numeric=BigInt, the gcd is BigInt::gcd, and
+/// reduction to lowest terms may be deferred (see setLazyLimit)
 template<typename Numeric>
 class Rational {
-    Numeric high{};
-    Numeric low{};
-  public:
+    // The denominator is always positive, but the fraction is only in lowest
+    // terms once reduced is set. Reduction happens on observation, so these
+    // are mutable
+    mutable Numeric high{};
+    mutable Numeric low{};
+    mutable bool reduced = false;
+
+    // Sums and products are left unreduced while their denominators have
+    // fewer than this many digits; zero reduces every result
+    static inline size_t lazyLimit = 0;
+
+    struct unreduced_construct {};
+    Rational(unreduced_construct, Numeric x, Numeric y, bool isReduced)
+        : high(std::move(x)), low(std::move(y)), reduced(isReduced) {}
 
-    Rational(Numeric x, Numeric y) : high(x), low(y) {
-        bool isNegative = false;
-        if (high < Numeric{0}) {
-            high *= Numeric{-1};
-            isNegative = !isNegative;
+    static bool defer(const Numeric& denominator) {
+        // Fixed width fractions could overflow if left unreduced
+        if constexpr (std::is_integral_v<Numeric>) {
+            return false;
+        } else {
+            return denominator.digitCount() < lazyLimit;
         }
-        if (low < Numeric{0}) {
-            low *= Numeric{-1};
-            isNegative = !isNegative;
+    }
+
+    // A result with a positive denominator, reduced unless that is deferred
+    static Rational make(Numeric x, Numeric y) {
+        Rational ret{unreduced_construct{}, std::move(x), std::move(y), false};
+        if (!defer(ret.low)) {
+            ret.reduce();
+        }
+        return ret;
+    }
+
+    // Whether results of operations on these operands are reduced as they are
+    // computed, which needs reduced operands
+    bool reduceEagerly(const Rational& other) const {
+        return reduced && other.reduced && !defer(low) && !defer(other.low);
+    }
+
+    void reduce() const {
+        if (reduced) {
+            return;
         }
         const Numeric z = gcd(high, low);
-        high /= z;
-        low  /= z;
-        if (isNegative) {
-            high *= Numeric{-1};
+        if (z != Numeric{1} && z != Numeric{}) {
+            high /= z;
+            low /= z;
+        }
+        reduced = true;
+    }
+
+  public:
+    Rational(Numeric x, Numeric y) : high(std::move(x)), low(std::move(y)) {
+        if (low < Numeric{0}) {
+            high = -high;
+            low = -low;
         }
+        reduce();
     }
 
-    explicit Rational(Numeric x) : Rational(x, Numeric{1}) {}
+    explicit Rational(Numeric x) : Rational(std::move(x), Numeric{1}) {}
     Rational() : Rational(Numeric{0}, Numeric{1}) {}
+
+    /// The gcd of the absolute values of a and b
     static Numeric gcd(const Numeric& a, const Numeric& b) {
-        if (b == Numeric{}) {
-            return a;
+        if constexpr (std::is_integral_v<Numeric>) {
+            Numeric x = a < Numeric{0} ? -a : a;
+            Numeric y = b < Numeric{0} ? -b : b;
+            while (y != Numeric{}) {
+                x = std::exchange(y, x % y);
+            }
+            return x;
         } else {
-            return gcd(b, a % b);
+            return Numeric::gcd(a, b);
         }
     }
 
-    const Numeric& numerator() const noexcept { return high; }
-    const Numeric& denominator() const noexcept { return low; }
+    /// Leave the results of arithmetic unreduced until they are observed, or
+    /// their denominators reach the given number of digits; 0 reduces eagerly.
+    /// Chains of operations then need far fewer gcds
+    static void setLazyLimit(size_t digits) { lazyLimit = digits; }
+
+    const Numeric& numerator() const {
+        reduce();
+        return high;
+    }
+    const Numeric& denominator() const {
+        reduce();
+        return low;
+    }
     Rational inverse() const {
-        if (unlikely(low == Numeric{})) {
+        if (unlikely(high == Numeric{})) {
             throw LispError("Division by zero");
+        } else if (high < Numeric{0}) {
+            return {unreduced_construct{}, -low, -high, reduced};
         } else {
-            return {low, high};
+            return {unreduced_construct{}, low, high, reduced};
         }
     }
 
     Rational operator+() const noexcept {
-        return {+high, +low};
+        return *this;
     }
     Rational operator+(const Rational& other) const noexcept {
-        return {high * other.low + low * other.high, low * other.low};
+        if (!reduceEagerly(other)) {
+            return make(high * other.low + other.high * low, low * other.low);
+        }
+        // With g = gcd(b, d), a/b + c/d = t / (b/g d) for t = a d/g + c b/g, and
+        // only gcd(t, g) is left to divide out (Henrici; TAOCP 4.5.1)
+        const Numeric g = gcd(low, other.low);
+        if (g == Numeric{1}) {
+            return {unreduced_construct{}, high * other.low + other.high * low, low * other.low,
+                    true};
+        }
+        const Numeric lowOverG = low / g;
+        const Numeric t = high * (other.low / g) + other.high * lowOverG;
+        if (t == Numeric{}) {
+            return Rational{};
+        }
+        const Numeric g2 = gcd(t, g);
+        return {unreduced_construct{}, t / g2, lowOverG * (other.low / g2), true};
     }
     Rational operator-() const noexcept {
-        return {-high, low};
+        return {unreduced_construct{}, -high, low, reduced};
     }
     Rational operator-(const Rational& other) const noexcept {
         return *this + (-other);
     }
     Rational operator*(const Rational& other) const noexcept {
-        return {high * other.high, low * other.low};
+        if (!reduceEagerly(other)) {
+            return make(high * other.high, low * other.low);
+        } else if (high == Numeric{} || other.high == Numeric{}) {
+            return Rational{};
+        }
+        // Cancel across the operands, so that the product is already reduced
+        const Numeric g1 = gcd(high, other.low);
+        const Numeric g2 = gcd(other.high, low);
+        return {unreduced_construct{}, (high / g1) * (other.high / g2),
+                (low / g2) * (other.low / g1), true};
     }
     Rational operator/(const Rational& other) const {
         return *this * other.inverse();
@@ -82,15 +169,27 @@ class Rational {
 
     explicit operator double() const noexcept {
         // There are almost certainly better ways of doing this
+        reduce();
         return static_cast<double>(high) / static_cast<double>(low);
     }
-    // C++20 operator<=>
-    Numeric compare(const Rational& other) const noexcept {
-        return high * other.low - other.high * low;
+    // C++20 operator<=>. Comparison needs no reduction, and the signs settle
+    // most comparisons without multiplying
+    int compare(const Rational& other) const noexcept {
+        const bool isNegative = high < Numeric{0};
+        if (isNegative != (other.high < Numeric{0})) {
+            return isNegative ? -1 : 1;
+        }
+        if (low == other.low) {
+            return high < other.high ? -1 : (other.high < high ? 1 : 0);
+        }
+        const Numeric lhs = high * other.low;
+        const Numeric rhs = other.high * low;
+        return lhs < rhs ? -1 : (rhs < lhs ? 1 : 0);
     }
-    SPACESHIP_BOILERPLATE(Rational, compare, Numeric)
+    SPACESHIP_BOILERPLATE(Rational, compare, int)
 
     friend std::ostream& operator<<(std::ostream& os, const Rational& r) noexcept {
+        r.reduce();
         return os << r.high << "/" << r.low;
     }
 };
@@ -2,13 +2,15 @@
 #pragma once
 #include "util/Enum.h"
 #include <iostream>
-#include <string>
+#include <string_view>
 
 ENUM(TokenType, uint8_t, Paren, String, Symbol, Number, Trivia, Quote, Error)
 
+/// A token refers to its text in the source it was lexed from, rather than
+/// owning a copy, so the source must outlive it
 class Token {
     TokenType type{TokenType::Error};
-    std::string data;
+    std::string_view data{};
   public:
     Token() = default;
 
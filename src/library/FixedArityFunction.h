@@ -0,0 +1,36 @@
+// (c) Sam Donow 2017-2018
+#pragma once
+#include "data/Data.h"
+#include "util/function_traits.h"
+
+#include <string_view>
+#include <tuple>
+#include <utility>
+
+/// Adapts a C++ function of a fixed number of atomic arguments into a builtin,
+/// checking the number and types of the arguments it is called with
+template<auto func>
+class FixedArityFunction {
+    // TODO: support Pass-by-reference parameters (std::reference_wrapper?)
+    using TupleT = typename function_traits<decltype(func)>::ArgTupleType;
+    static constexpr size_t Arity = function_traits<decltype(func)>::arity;
+    static Datum apply(ArgSpan args, Evaluator&) {
+        if (args.size() != Arity) {
+            throw ArityError(Arity, args.size());
+        }
+        TupleT argsToPass;
+        setupArgs(args, argsToPass, std::make_index_sequence<Arity>{});
+        return Datum{Atom{std::apply(func, argsToPass)}};
+    }
+
+    template <size_t... Is>
+    static void setupArgs(ArgSpan args, TupleT& argTuple, std::index_sequence<Is...>) {
+        ((std::get<Is>(argTuple) =
+              args[Is].getAtomicValueE<std::tuple_element_t<Is, TupleT>>()), ...);
+    }
+
+  public:
+    static void insert(SymbolTable& st, std::string_view s) {
+        st.emplace(Symbol{s}, &FixedArityFunction::apply);
+    }
+};
@@ -0,0 +1,124 @@
+// (c) Sam Donow 2018
+#include "HashTableMethods.h"
+#include "core/Evaluator.h"
+#include "library/FixedArityFunction.h"
+
+namespace {
+void checkArity(ArgSpan args, size_t minArity, size_t maxArity) {
+    if (args.size() < minArity || args.size() > maxArity) {
+        throw ArityError(args.size() < minArity ? minArity : maxArity, args.size());
+    }
+}
+
+GCPtr<HashTable> tableArg(const Datum& datum) {
+    return datum.getAtomicValueE<GCPtr<HashTable>>();
+}
+}
+
+template<HashTable::Kind kind>
+Datum HashTableMethods::make(ArgSpan args, Evaluator&) {
+    checkArity(args, 0, 1);
+    size_t initialSize = 0;
+    if (args.size() == 1) {
+        const Number size = args[0].getAtomicValueE<Number>();
+        if (!size.is<int64_t>() || size.as<int64_t>() < 0) {
+            throw LispError("Invalid hash table size: ", size);
+        }
+        initialSize = static_cast<size_t>(size.as<int64_t>());
+    }
+    return Datum{Atom{makeGC<HashTable>(kind, initialSize)}};
+}
+
+// (hash-table-ref table key [fail [succeed]]): (succeed value), or value, if
+// key is present; otherwise (fail), or an error
+Datum HashTableMethods::ref(ArgSpan args, Evaluator& ev) {
+    checkArity(args, 2, 4);
+    if (const Datum* found = tableArg(args[0])->find(args[1])) {
+        const Datum value = *found;
+        return args.size() == 4 ? ev.apply(args[3], ArgSpan{&value, 1}) : value;
+    } else if (args.size() >= 3) {
+        return ev.apply(args[2], ArgSpan{});
+    }
+    throw LispError("Key not found in hash table: ", args[1]);
+}
+
+Datum HashTableMethods::refDefault(ArgSpan args, Evaluator&) {
+    checkArity(args, 3, 3);
+    const Datum* value = tableArg(args[0])->find(args[1]);
+    return value != nullptr ? *value : args[2];
+}
+
+Datum HashTableMethods::set(ArgSpan args, Evaluator&) {
+    checkArity(args, 3, 3);
+    tableArg(args[0])->set(args[1], args[2]);
+    return Datum{};
+}
+
+// (hash-table-update! table key proc [get-default]): store (proc value), where
+// value is that of key, or (get-default) if it is absent. proc may change the
+// table, so the key is looked up again to store the result
+Datum HashTableMethods::update(ArgSpan args, Evaluator& ev) {
+    checkArity(args, 3, 4);
+    const GCPtr<HashTable> table = tableArg(args[0]);
+    Datum value;
+    if (const Datum* current = table->find(args[1])) {
+        value = *current;
+    } else if (args.size() == 4) {
+        value = ev.apply(args[3], ArgSpan{});
+    } else {
+        throw LispError("Key not found in hash table: ", args[1]);
+    }
+    table->set(args[1], ev.apply(args[2], ArgSpan{&value, 1}));
+    return Datum{};
+}
+
+// (hash-table-update!/default table key proc default)
+Datum HashTableMethods::updateDefault(ArgSpan args, Evaluator& ev) {
+    checkArity(args, 4, 4);
+    const GCPtr<HashTable> table = tableArg(args[0]);
+    const Datum* current = table->find(args[1]);
+    const Datum value = current != nullptr ? *current : args[3];
+    table->set(args[1], ev.apply(args[2], ArgSpan{&value, 1}));
+    return Datum{};
+}
+
+Datum HashTableMethods::remove(ArgSpan args, Evaluator&) {
+    checkArity(args, 2, 2);
+    tableArg(args[0])->remove(args[1]);
+    return Datum{};
+}
+
+Datum HashTableMethods::contains(ArgSpan args, Evaluator&) {
+    checkArity(args, 2, 2);
+    return Datum{Atom{tableArg(args[0])->find(args[1]) != nullptr}};
+}
+
+Number HashTableMethods::count(GCPtr<HashTable> table) {
+    return Number{table->size()};
+}
+
+// (hash-table-walk table proc): call (proc key value) on each entry. The
+// entries are copied first, so proc may change the table
+Datum HashTableMethods::walk(ArgSpan args, Evaluator& ev) {
+    checkArity(args, 2, 2);
+    for (const auto& [key, value] : tableArg(args[0])->entries()) {
+        const Datum entry[] = {key, value};
+        ev.apply(args[1], ArgSpan{entry, 2});
+    }
+    return Datum{};
+}
+
+void HashTableMethods::insertIntoScope(SymbolTable& st) {
+    st.emplace(Symbol{"make-equal-hash-table"}, &make<HashTable::Kind::Equal>);
+    st.emplace(Symbol{"make-strong-eqv-hash-table"}, &make<HashTable::Kind::StrongEqv>);
+    st.emplace(Symbol{"make-string-hash-table"}, &make<HashTable::Kind::String>);
+    st.emplace(Symbol{"hash-table-ref"}, &HashTableMethods::ref);
+    st.emplace(Symbol{"hash-table-ref/default"}, &HashTableMethods::refDefault);
+    st.emplace(Symbol{"hash-table-set!"}, &HashTableMethods::set);
+    st.emplace(Symbol{"hash-table-update!"}, &HashTableMethods::update);
+    st.emplace(Symbol{"hash-table-update!/default"}, &HashTableMethods::updateDefault);
+    st.emplace(Symbol{"hash-table-delete!"}, &HashTableMethods::remove);
+    st.emplace(Symbol{"hash-table-contains?"}, &HashTableMethods::contains);
+    FixedArityFunction<&HashTableMethods::count>::insert(st, "hash-table-count");
+    st.emplace(Symbol{"hash-table-walk"}, &HashTableMethods::walk);
+}
@@ -0,0 +1,22 @@
+// (c) Sam Donow 2018
+#pragma once
+#include "data/HashTable.h"
+
+/// Builtins on hash tables, after those of MIT Scheme
+class HashTableMethods {
+    template<HashTable::Kind kind>
+    static Datum make(ArgSpan args, Evaluator& ev);
+
+    static BuiltInFunc ref;
+    static BuiltInFunc refDefault;
+    static BuiltInFunc set;
+    static BuiltInFunc update;
+    static BuiltInFunc updateDefault;
+    static BuiltInFunc remove;
+    static BuiltInFunc contains;
+    static Number count(GCPtr<HashTable> table);
+    static BuiltInFunc walk;
+
+  public:
+    static void insertIntoScope(SymbolTable& st);
+};
@@ -0,0 +1,219 @@
+// (c) Sam Donow 2018
+#include "ListMethods.h"
+#include "core/Evaluator.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+void checkArity(ArgSpan args, size_t minArity, size_t maxArity) {
+    if (args.size() < minArity || args.size() > maxArity) {
+        throw ArityError(args.size() < minArity ? minArity : maxArity, args.size());
+    }
+}
+
+Datum emptyList() {
+    return Datum{SExprPtr{nullptr}};
+}
+
+// Builds a list front to back, keeping a pointer to its last pair
+class ListBuilder {
+    SExprPtr head{nullptr};
+    SExpr* tail = nullptr;
+
+  public:
+    void push(const Datum& datum) {
+        auto cell = makeGC<SExpr>(datum);
+        if (tail == nullptr) {
+            head = cell;
+        } else {
+            tail->cdr = Datum{cell};
+        }
+        tail = cell.get();
+    }
+
+    /// The list built, ending in rest rather than the empty list
+    Datum finish(const Datum& rest) {
+        if (tail == nullptr) {
+            return rest;
+        }
+        tail->cdr = rest;
+        return Datum{head};
+    }
+};
+
+// Walks several lists in step, stopping at the end of the shortest. The
+// current pairs are held, so the lists may be changed by the procedure called
+// on their elements
+class ListCursors {
+    std::vector<SExprPtr> cells{};
+
+  public:
+    explicit ListCursors(ArgSpan lists) {
+        cells.reserve(lists.size());
+        for (const Datum& list : lists) {
+            cells.emplace_back(list.getSExpr());
+        }
+    }
+
+    size_t size() const { return cells.size(); }
+
+    bool done() const {
+        return std::any_of(cells.begin(), cells.end(),
+                           [](const SExprPtr& cell) { return cell == nullptr; });
+    }
+
+    /// Copy the current elements to out, and move on to the next ones
+    void next(Datum* out) {
+        for (SExprPtr& cell : cells) {
+            *out++ = cell->car;
+            cell = SExprPtr{cell->cdr.getSExpr()};
+        }
+    }
+};
+}
+
+Datum ListMethods::length(ArgSpan args, Evaluator&) {
+    checkArity(args, 1, 1);
+    int64_t count = 0;
+    for (const SExpr* cell = args[0].getSExpr(); cell != nullptr; cell = cell->cdr.getSExpr()) {
+        ++count;
+    }
+    return Datum{Atom{Number{count}}};
+}
+
+// (append list ... obj): the last argument is shared, not copied, and need not
+// be a list
+Datum ListMethods::append(ArgSpan args, Evaluator&) {
+    if (args.empty()) {
+        return emptyList();
+    }
+    ListBuilder result;
+    for (size_t i = 0; i + 1 < args.size(); ++i) {
+        for (const SExpr* cell = args[i].getSExpr(); cell != nullptr;
+             cell = cell->cdr.getSExpr()) {
+            result.push(cell->car);
+        }
+    }
+    return result.finish(args.back());
+}
+
+Datum ListMethods::reverse(ArgSpan args, Evaluator&) {
+    checkArity(args, 1, 1);
+    Datum result = emptyList();
+    for (const SExpr* cell = args[0].getSExpr(); cell != nullptr; cell = cell->cdr.getSExpr()) {
+        result = Datum{makeGC<SExpr>(cell->car, result)};
+    }
+    return result;
+}
+
+Datum ListMethods::listTail(ArgSpan args, Evaluator&) {
+    checkArity(args, 2, 2);
+    const Number k = args[1].getAtomicValueE<Number>();
+    if (!k.is<int64_t>() || k.as<int64_t>() < 0) {
+        throw LispError("Invalid list-tail index: ", k);
+    }
+    Datum list = args[0];
+    for (int64_t i = k.as<int64_t>(); i > 0; --i) {
+        const SExpr* cell = list.getSExpr();
+        if (cell == nullptr) {
+            throw LispError("list-tail index out of range: ", k);
+        }
+        list = cell->cdr;
+    }
+    return list;
+}
+
+// (map proc list1 list2 ...)
+Datum ListMethods::map(ArgSpan args, Evaluator& ev) {
+    checkArity(args, 2, args.size());
+    ListCursors lists{args.subspan(1)};
+    const Evaluator::Procedure proc{ev, args[0], lists.size()};
+    std::vector<Datum> elements(lists.size());
+    ListBuilder result;
+    while (!lists.done()) {
+        lists.next(elements.data());
+        result.push(proc(elements));
+    }
+    return result.finish(emptyList());
+}
+
+Datum ListMethods::forEach(ArgSpan args, Evaluator& ev) {
+    checkArity(args, 2, args.size());
+    ListCursors lists{args.subspan(1)};
+    const Evaluator::Procedure proc{ev, args[0], lists.size()};
+    std::vector<Datum> elements(lists.size());
+    while (!lists.done()) {
+        lists.next(elements.data());
+        proc(elements);
+    }
+    return Datum{};
+}
+
+// (fold-left proc init list1 ...): (proc (proc init e1 ...) e2 ...) ...
+Datum ListMethods::foldLeft(ArgSpan args, Evaluator& ev) {
+    checkArity(args, 3, args.size());
+    ListCursors lists{args.subspan(2)};
+    const Evaluator::Procedure proc{ev, args[0], lists.size() + 1};
+    std::vector<Datum> procArgs(lists.size() + 1);
+    Datum acc = args[1];
+    while (!lists.done()) {
+        procArgs[0] = acc;
+        lists.next(&procArgs[1]);
+        acc = proc(procArgs);
+    }
+    return acc;
+}
+
+// (fold-right proc init list1 ...): (proc e1 ... (proc e2 ... init)). The
+// elements are gathered first, so that the calls are made from the back
+Datum ListMethods::foldRight(ArgSpan args, Evaluator& ev) {
+    checkArity(args, 3, args.size());
+    ListCursors lists{args.subspan(2)};
+    const size_t width = lists.size();
+    const Evaluator::Procedure proc{ev, args[0], width + 1};
+    std::vector<Datum> elements;
+    while (!lists.done()) {
+        elements.resize(elements.size() + width);
+        lists.next(&elements[elements.size() - width]);
+    }
+    std::vector<Datum> procArgs(width + 1);
+    Datum acc = args[1];
+    for (size_t end = elements.size(); end != 0; end -= width) {
+        std::copy(elements.begin() + static_cast<ptrdiff_t>(end - width),
+                  elements.begin() + static_cast<ptrdiff_t>(end), procArgs.begin());
+        procArgs[width] = acc;
+        acc = proc(procArgs);
+    }
+    return acc;
+}
+
+// (reduce proc initial list): initial for the empty list, otherwise
+// (proc e3 (proc e2 e1)) and so on, as in SRFI 1
+Datum ListMethods::reduce(ArgSpan args, Evaluator& ev) {
+    checkArity(args, 3, 3);
+    SExprPtr cell{args[2].getSExpr()};
+    if (cell == nullptr) {
+        return args[1];
+    }
+    const Evaluator::Procedure proc{ev, args[0], 2};
+    Datum procArgs[2] = {Datum{}, cell->car};
+    for (cell = SExprPtr{cell->cdr.getSExpr()}; cell != nullptr;
+         cell = SExprPtr{cell->cdr.getSExpr()}) {
+        procArgs[0] = cell->car;
+        procArgs[1] = proc(ArgSpan{procArgs, 2});
+    }
+    return procArgs[1];
+}
+
+void ListMethods::insertIntoScope(SymbolTable& st) {
+    st.emplace(Symbol{"length"}, &ListMethods::length);
+    st.emplace(Symbol{"append"}, &ListMethods::append);
+    st.emplace(Symbol{"reverse"}, &ListMethods::reverse);
+    st.emplace(Symbol{"list-tail"}, &ListMethods::listTail);
+    st.emplace(Symbol{"map"}, &ListMethods::map);
+    st.emplace(Symbol{"for-each"}, &ListMethods::forEach);
+    st.emplace(Symbol{"fold-left"}, &ListMethods::foldLeft);
+    st.emplace(Symbol{"fold-right"}, &ListMethods::foldRight);
+    st.emplace(Symbol{"reduce"}, &ListMethods::reduce);
+}
@@ -0,0 +1,22 @@
+// (c) Sam Donow 2018
+#pragma once
+#include "data/Data.h"
+
+/// Builtins on lists. These walk the lists iteratively and call procedures
+/// through Evaluator::Procedure, so long lists need neither deep recursion nor
+/// the evaluator's per-call dispatch
+class ListMethods {
+    static BuiltInFunc length;
+    static BuiltInFunc append;
+    static BuiltInFunc reverse;
+    static BuiltInFunc listTail;
+
+    static BuiltInFunc map;
+    static BuiltInFunc forEach;
+    static BuiltInFunc foldLeft;
+    static BuiltInFunc foldRight;
+    static BuiltInFunc reduce;
+
+  public:
+    static void insertIntoScope(SymbolTable& st);
+};
@@ -0,0 +1,144 @@
+// (c) Sam Donow 2018
+#include "SortMethods.h"
+#include "core/Evaluator.h"
+#include "library/SystemMethods.h"
+
+#include <algorithm>
+#include <functional>
+#include <string>
+
+namespace {
+// A bottom-up merge sort, of runs of width 1, 2, 4 etc. Each merge only
+// indexes within its two runs whatever cmp answers, so a procedure that is not
+// a consistent ordering gives some permutation of the items rather than
+// undefined behavior, as it would with std::stable_sort
+template<typename T, typename Key, typename Compare>
+void stableSort(std::vector<T>& items, Key key, Compare cmp) {
+    const size_t n = items.size();
+    std::vector<T> merged(n);
+    for (size_t width = 1; width < n; width *= 2) {
+        for (size_t lo = 0; lo < n; lo += 2 * width) {
+            const size_t mid = std::min(lo + width, n);
+            const size_t hi = std::min(mid + width, n);
+            size_t i = lo;
+            size_t j = mid;
+            size_t out = lo;
+            while (i < mid && j < hi) {
+                // Take from the right run only if strictly less, for stability
+                merged[out++] = std::move(cmp(key(items[j]), key(items[i])) ? items[j++] : items[i++]);
+            }
+            std::move(items.begin() + static_cast<ptrdiff_t>(i),
+                      items.begin() + static_cast<ptrdiff_t>(mid), merged.begin() + static_cast<ptrdiff_t>(out));
+            out += mid - i;
+            std::move(items.begin() + static_cast<ptrdiff_t>(j),
+                      items.begin() + static_cast<ptrdiff_t>(hi), merged.begin() + static_cast<ptrdiff_t>(out));
+        }
+        items.swap(merged);
+    }
+}
+
+// Compare numbers, directly if both are fixnums
+template<typename Compare>
+bool compareNumbers(const Datum& a, const Datum& b, Compare cmp) {
+    if (a.isFixnum() && b.isFixnum()) {
+        return cmp(a.fixnumValue(), b.fixnumValue());
+    }
+    return cmp(a.getAtomicValueE<Number>(), b.getAtomicValueE<Number>());
+}
+
+template<typename Compare>
+bool compareStrings(const Datum& a, const Datum& b, Compare cmp) {
+    return cmp(a.getAtomicValueE<std::string>(), b.getAtomicValueE<std::string>());
+}
+
+template<typename T, typename Key>
+bool allHave(const std::vector<T>& items, Key key, bool (Datum::*has)() const) {
+    return std::all_of(items.begin(), items.end(),
+                       [&](const T& item) { return (key(item).*has)(); });
+}
+}
+
+template<typename T, typename Key>
+void SortMethods::sortBy(std::vector<T>& items, const Datum& proc, Evaluator& ev, Key key) {
+    BuiltInFunc* const builtin = proc.getAtomicValue<BuiltInFunc*>().value_or(nullptr);
+    if (builtin == &SystemMethods::lt || builtin == &SystemMethods::gt) {
+        if (allHave(items, key, &Datum::hasAtomicValue<Number>)) {
+            if (builtin == &SystemMethods::lt) {
+                stableSort(items, key, [](const Datum& a, const Datum& b) {
+                    return compareNumbers(a, b, std::less<>{});
+                });
+            } else {
+                stableSort(items, key, [](const Datum& a, const Datum& b) {
+                    return compareNumbers(a, b, std::greater<>{});
+                });
+            }
+            return;
+        }
+    } else if (builtin == &SystemMethods::stringLt || builtin == &SystemMethods::stringGt) {
+        if (allHave(items, key, &Datum::hasAtomicValue<std::string>)) {
+            if (builtin == &SystemMethods::stringLt) {
+                stableSort(items, key, [](const Datum& a, const Datum& b) {
+                    return compareStrings(a, b, std::less<>{});
+                });
+            } else {
+                stableSort(items, key, [](const Datum& a, const Datum& b) {
+                    return compareStrings(a, b, std::greater<>{});
+                });
+            }
+            return;
+        }
+    }
+    const Evaluator::Procedure less{ev, proc, 2};
+    stableSort(items, key, [&](const Datum& a, const Datum& b) {
+        const Datum pair[] = {a, b};
+        return less(ArgSpan{pair, 2}).isTrue();
+    });
+}
+
+// (sort sequence procedure): the sequence is sorted as a copy, or in place for
+// sort!. Either way the elements are sorted in a separate array, so the
+// sequence is left unchanged if the procedure fails
+Datum SortMethods::sortSequence(ArgSpan args, Evaluator& ev, bool inPlace) {
+    if (args.size() != 2) {
+        throw ArityError(2, args.size());
+    }
+    const Datum& sequence = args[0];
+    if (auto vec = sequence.getAtomicValue<GCPtr<Vector>>()) {
+        std::vector<Datum> elements = (*vec)->elements;
+        sortBy(elements, args[1], ev, [](const Datum& datum) -> const Datum& { return datum; });
+        if (!inPlace) {
+            return Datum{Atom{makeGC<Vector>(std::move(elements))}};
+        }
+        (*vec)->elements = std::move(elements);
+        return sequence;
+    }
+
+    // Sort the pairs themselves, then relink them in order
+    std::vector<SExprPtr> cells;
+    for (SExpr* cell = sequence.getSExpr(); cell != nullptr; cell = cell->cdr.getSExpr()) {
+        cells.push_back(inPlace ? SExprPtr{cell} : makeGC<SExpr>(cell->car));
+    }
+    if (cells.empty()) {
+        return sequence;
+    }
+    sortBy(cells, args[1], ev, [](const SExprPtr& cell) -> const Datum& { return cell->car; });
+    for (size_t i = 0; i + 1 < cells.size(); ++i) {
+        cells[i]->cdr = Datum{cells[i + 1]};
+    }
+    cells.back()->cdr = Datum{SExprPtr{nullptr}};
+    return Datum{cells.front()};
+}
+
+Datum SortMethods::sort(ArgSpan args, Evaluator& ev) {
+    return sortSequence(args, ev, false);
+}
+
+Datum SortMethods::sortInPlace(ArgSpan args, Evaluator& ev) {
+    return sortSequence(args, ev, true);
+}
+
+void SortMethods::insertIntoScope(SymbolTable& st) {
+    st.emplace(Symbol{"sort"}, &SortMethods::sort);
+    st.emplace(Symbol{"sort!"}, &SortMethods::sortInPlace);
+    st.emplace(Symbol{"merge-sort"}, &SortMethods::sort);
+}
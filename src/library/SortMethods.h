@@ -0,0 +1,24 @@
+// (c) Sam Donow 2018
+#pragma once
+#include "data/Data.h"
+
+#include <vector>
+
+/// sort, sort! and merge-sort, on lists and vectors, after those of MIT Scheme.
+/// All three are stable merge sorts; sort! reorders the pairs of a list, or
+/// the elements of a vector, rather than making new ones
+class SortMethods {
+    /// Stably sort items by the data key(item), ordered by the procedure
+    /// proc. The builtin comparisons of numbers and strings are recognized
+    /// and made directly, without calling proc
+    template<typename T, typename Key>
+    static void sortBy(std::vector<T>& items, const Datum& proc, Evaluator& ev, Key key);
+
+    static Datum sortSequence(ArgSpan args, Evaluator& ev, bool inPlace);
+
+    static BuiltInFunc sort;
+    static BuiltInFunc sortInPlace;
+
+  public:
+    static void insertIntoScope(SymbolTable& st);
+};
@@ -1,21 +1,23 @@
 // (c) Sam Donow 2017
 #include "SpecialForms.h"
 #include "core/Evaluator.h"
+#include "core/Loader.h"
 
 void SpecialForms::insertIntoScope(SymbolTable& st) {
-    st.emplace("lambda", &SpecialForms::lambdaImpl);
-    st.emplace("named-lambda", &SpecialForms::namedLambdaImpl);
-    st.emplace("if", &SpecialForms::ifImpl);
-    st.emplace("define", &SpecialForms::defineImpl);
-    st.emplace("quote", &SpecialForms::quoteImpl);
-    st.emplace("and", &SpecialForms::andImpl);
-    st.emplace("or", &SpecialForms::orImpl);
-    st.emplace("begin", &SpecialForms::beginImpl);
-    st.emplace("cond", &SpecialForms::condImpl);
-    st.emplace("case", &SpecialForms::caseImpl);
+    st.emplace(Symbol{"lambda"}, &SpecialForms::lambdaImpl);
+    st.emplace(Symbol{"named-lambda"}, &SpecialForms::namedLambdaImpl);
+    st.emplace(Symbol{"if"}, &SpecialForms::ifImpl);
+    st.emplace(Symbol{"define"}, &SpecialForms::defineImpl);
+    st.emplace(Symbol{"quote"}, &SpecialForms::quoteImpl);
+    st.emplace(Symbol{"and"}, &SpecialForms::andImpl);
+    st.emplace(Symbol{"or"}, &SpecialForms::orImpl);
+    st.emplace(Symbol{"begin"}, &SpecialForms::beginImpl);
+    st.emplace(Symbol{"cond"}, &SpecialForms::condImpl);
+    st.emplace(Symbol{"case"}, &SpecialForms::caseImpl);
+    st.emplace(Symbol{"load"}, &SpecialForms::loadImpl);
 }
 
-std::pair<std::vector<Symbol>, Datum> parseFuncDefn(LispArgs args) {
+std::pair<std::vector<Symbol>, Datum> SpecialForms::parseFuncDefn(LispArgs args) {
     std::vector<Symbol> formals;
     if (args.size() < 2) {
         throw LispError("Definition must have param list and body");
@@ -25,7 +27,7 @@ std::pair<std::vector<Symbol>, Datum> parseFuncDefn(LispArgs args) {
     if (inputIt->isAtomic()) {
         throw LispError("Parameter list must be a list");
     }
-    const SExprPtr& expr = inputIt->getSExpr();
+    const SExpr* expr = inputIt->getSExpr();
     if (expr != nullptr) {
         for (const Datum& datum : *expr) {
             std::optional<Symbol> param = datum.getAtomicValue<Symbol>();
@@ -38,15 +40,24 @@ std::pair<std::vector<Symbol>, Datum> parseFuncDefn(LispArgs args) {
         }
     }
 
-    return {formals, *++inputIt};
+    if (args.size() == 2) {
+        return {formals, *++inputIt};
+    }
+    SExprPtr body = makeGC<SExpr>(Atom{Symbol{"begin"}});
+    SExpr* tail = body.get();
+    for (++inputIt; inputIt != args.end(); ++inputIt) {
+        tail->cdr = makeGC<SExpr>(*inputIt);
+        tail = tail->cdr.getSExpr();
+    }
+    return {formals, Datum{body}};
 }
 
-EvalResult SpecialForms::lambdaImpl(LispArgs args, SymbolTable& st, Evaluator&) {
+EvalResult SpecialForms::lambdaImpl(LispArgs args, SymbolTable& st, Evaluator& ev) {
     auto[formals, defn] = parseFuncDefn(std::move(args));
-    SExprPtr impl =
-        defn.isAtomic() ? std::make_shared<SExpr>(defn.getAtom()) : defn.getSExpr();
-    auto &elem = st.emplaceAnon(LispFunction{std::move(formals), std::move(impl), st});
-    return Datum{Atom{std::shared_ptr<LispFunction>(st.shared_from_this(), &std::get<LispFunction>(elem))}};
+    auto func = makeGC<LispFunction>(std::move(formals), defn, GCPtr<SymbolTable>{&st});
+    // Variable references are resolved once, when the closure is created
+    ev.compiledCode(*func);
+    return Datum{Atom{func}};
 }
 
 EvalResult SpecialForms::namedLambdaImpl(LispArgs args, SymbolTable& st, Evaluator&) {
@@ -57,10 +68,9 @@ EvalResult SpecialForms::namedLambdaImpl(LispArgs args, SymbolTable& st, Evaluat
     Symbol funName = std::move(*formals.begin());
     formals.erase(formals.begin());
 
-    SExprPtr impl =
-        defn.isAtomic() ? std::make_shared<SExpr>(defn.getAtom()) : defn.getSExpr();
-    auto &elem = st.emplace(+funName, LispFunction{std::move(formals), std::move(impl), st});
-    return Datum{Atom{std::shared_ptr<LispFunction>(st.shared_from_this(), &std::get<LispFunction>(elem))}};
+    auto func = makeGC<LispFunction>(std::move(formals), defn, GCPtr<SymbolTable>{&st});
+    st.emplace(funName, Datum{Atom{func}});
+    return Datum{Atom{func}};
 }
 
 EvalResult SpecialForms::defineImpl(LispArgs args, SymbolTable& st, Evaluator& ev) {
@@ -72,8 +82,8 @@ EvalResult SpecialForms::defineImpl(LispArgs args, SymbolTable& st, Evaluator& e
             throw LispError("Name ", *inputIt, " is not an identifier");
         }
         ++inputIt;
-        Datum value = ev.evalDatum(inputIt->getSExpr(), st);
-        st.emplace(+*varName, value);
+        Datum value = ev.computeArg(*inputIt, st);
+        st.define(*varName, value);
         return Datum{};
     }
     auto [formals, defn] = parseFuncDefn(std::move(args));
@@ -83,9 +93,9 @@ EvalResult SpecialForms::defineImpl(LispArgs args, SymbolTable& st, Evaluator& e
     Symbol funName = std::move(*formals.begin());
     formals.erase(formals.begin());
 
-    SExprPtr impl =
-        defn.isAtomic() ? std::make_shared<SExpr>(defn.getAtom()) : defn.getSExpr();
-    st.emplace(+funName, LispFunction{std::move(formals), std::move(impl), st});
+    auto func = makeGC<LispFunction>(std::move(formals), defn, GCPtr<SymbolTable>{&st});
+    st.define(funName, Datum{Atom{func}});
+    ev.compiledCode(*func);
     return Datum{};
 }
 
@@ -106,7 +116,17 @@ EvalResult SpecialForms::quoteImpl(LispArgs args, SymbolTable&, Evaluator&) {
     if (args.size() != 1) {
         throw LispError("quote requires exactly one argument");
     }
-    return Datum{args.begin()->getSExpr()};
+    return *args.begin();
+}
+
+// (load filename): evaluate the forms of the file in the current environment,
+// returning the value of the last
+EvalResult SpecialForms::loadImpl(LispArgs args, SymbolTable& st, Evaluator& ev) {
+    if (args.size() != 1) {
+        throw LispError("load requires exactly one argument");
+    }
+    const Datum path = ev.computeArg(*args.begin(), st);
+    return Loader::loadFile(path.getAtomicValueE<std::string>(), st, ev);
 }
 
 EvalResult SpecialForms::andImpl(LispArgs args, SymbolTable& st, Evaluator& ev) {
@@ -150,7 +170,7 @@ EvalResult SpecialForms::condImpl(LispArgs args, SymbolTable& st, Evaluator& ev)
         if (unlikely(datum.isAtomic())) {
             throw LispError("Condition clauses must be pairs");
         }
-        const SExprPtr& condPair = datum.getSExpr();
+        const SExpr* condPair = datum.getSExpr();
         if (auto sym = condPair->car.getAtomicValue<Symbol>();
             (sym && +*sym == "else") || ev.computeArg(condPair->car, st).isTrue()) {
             return beginImpl(condPair->cdr.getSExpr(), st, ev);
@@ -168,7 +188,7 @@ EvalResult SpecialForms::caseImpl(LispArgs args, SymbolTable& st, Evaluator& ev)
     Datum key = ev.computeArg(*it, st);
 
     for (++it; it != args.end(); ++it) {
-        const SExprPtr& expr = it->getSExpr();
+        const SExpr* expr = it->getSExpr();
         if (expr->car.isAtomic()) {
             std::optional<Symbol> sym = expr->car.getAtomicValue<Symbol>();
             if (sym && +*sym == "else") {
@@ -176,7 +196,7 @@ EvalResult SpecialForms::caseImpl(LispArgs args, SymbolTable& st, Evaluator& ev)
             }
         } else {
             for (const Datum& datum : LispArgs(expr->car.getSExpr())) {
-                if (key == datum) {
+                if (key.eqv(datum)) {
                     return beginImpl(LispArgs(expr->cdr.getSExpr()), st, ev);
                 }
             }
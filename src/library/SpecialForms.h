@@ -8,42 +8,48 @@
 // TODO: add helpers for things like Unaryfunction and such
 class SpecialForms {
     // All special forms documented here; will be implemented as I get to them
-    //static BuiltInFunc accessImpl;
-    static BuiltInFunc caseImpl;
-    //static BuiltInFunc declareImpl;
-    //static BuiltInFunc defineIntegrableImpl;
-    //static BuiltInFunc delayImpl;
-    //static BuiltInFunc fluidLetImpl;
-    //static BuiltInFunc letImpl;
-    //static BuiltInFunc letSyntexImpl;
-    //static BuiltInFunc localDeclarImpl;
-    static BuiltInFunc orImpl;
-    //static BuiltInFunc rscMacroTransformerImpl;
-    //static BuiltInFunc syntaxRulesImpl;
-    static BuiltInFunc andImpl;
-    static BuiltInFunc condImpl;
-    static BuiltInFunc defineImpl;
-    //static BuiltInFunc defineStructureImpl;
-    //static BuiltInFunc doImpl;
-    static BuiltInFunc ifImpl;
-    //static BuiltInFunc letSImpl;
-    //static BuiltInFunc letrecImpl;
-    static BuiltInFunc namedLambdaImpl;
-    //static BuiltinFunc quasiquoteImpl;
-    //static BuiltInFunc scMacroTransformer;
-    //static BuiltInFunc theEnvironmentImpl;
-    static BuiltInFunc beginImpl;
-    //static BuiltInFunc consStreamImpl;
-    //static BuiltInFunc consStreamImpl;
-    //static BuiltInFunc defineSyntaxImpl;
-    //static BuiltInFunc erMacroTransformerImpl;
-    static BuiltInFunc lambdaImpl;
-    //static BuiltInFunc letSSyntax;
-    //static BuiltInFunc letrecSyntaxImpl;
-    //static BuiltInFunc nonHygienicMacroTransformerImpl;
-    static BuiltInFunc quoteImpl;
-    //static BuiltInFunc setBangImpl;
+    //static SpecialFormImpl accessImpl;
+    static SpecialFormImpl caseImpl;
+    //static SpecialFormImpl declareImpl;
+    //static SpecialFormImpl defineIntegrableImpl;
+    //static SpecialFormImpl delayImpl;
+    //static SpecialFormImpl fluidLetImpl;
+    //static SpecialFormImpl letImpl;
+    //static SpecialFormImpl letSyntexImpl;
+    //static SpecialFormImpl localDeclarImpl;
+    static SpecialFormImpl orImpl;
+    //static SpecialFormImpl rscMacroTransformerImpl;
+    //static SpecialFormImpl syntaxRulesImpl;
+    static SpecialFormImpl andImpl;
+    static SpecialFormImpl condImpl;
+    static SpecialFormImpl defineImpl;
+    //static SpecialFormImpl defineStructureImpl;
+    //static SpecialFormImpl doImpl;
+    static SpecialFormImpl ifImpl;
+    //static SpecialFormImpl letSImpl;
+    //static SpecialFormImpl letrecImpl;
+    static SpecialFormImpl namedLambdaImpl;
+    //static SpecialFormImpl quasiquoteImpl;
+    //static SpecialFormImpl scMacroTransformer;
+    //static SpecialFormImpl theEnvironmentImpl;
+    static SpecialFormImpl beginImpl;
+    //static SpecialFormImpl consStreamImpl;
+    //static SpecialFormImpl consStreamImpl;
+    //static SpecialFormImpl defineSyntaxImpl;
+    //static SpecialFormImpl erMacroTransformerImpl;
+    static SpecialFormImpl lambdaImpl;
+    //static SpecialFormImpl letSSyntax;
+    //static SpecialFormImpl letrecSyntaxImpl;
+    //static SpecialFormImpl nonHygienicMacroTransformerImpl;
+    static SpecialFormImpl quoteImpl;
+    static SpecialFormImpl loadImpl;
+    //static SpecialFormImpl setBangImpl;
 
   public:
     static void insertIntoScope(SymbolTable& st);
+
+    /// Split the arguments of a lambda or function definition into the formal
+    /// parameters and the definition; a body of several expressions is wrapped
+    /// in a begin
+    static std::pair<std::vector<Symbol>, Datum> parseFuncDefn(LispArgs args);
 };
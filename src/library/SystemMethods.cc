@@ -2,58 +2,20 @@
 #include "SystemMethods.h"
 #include "data/Data.h"
 #include "core/Evaluator.h"
-#include "util/function_traits.h"
+#include "library/FixedArityFunction.h"
 #include <cctype>
+#include <cmath>
+#include <functional>
+#include <initializer_list>
 #include <iostream>
 #include <numeric>
 #include <utility>
 
-template<auto func>
-class FixedArityFunction {
-    // TODO: support Pass-by-reference parameters (std::reference_wrapper?)
-    using TupleT = typename function_traits<decltype(func)>::ArgTupleType;
-    static constexpr size_t Arity = function_traits<decltype(func)>::arity;
-    static EvalResult apply(LispArgs args, SymbolTable& st, Evaluator& ev) {
-        TupleT argsToPass = setupArgs(args.begin(), args.end(), st, ev);
-        return Datum{Atom{std::apply(func, argsToPass)}};
-    }
-
-    template <typename FwdIterator>
-    static TupleT setupArgs(FwdIterator start, FwdIterator end, SymbolTable& st,
-                            Evaluator& ev) {
-        TupleT argsToPass;
-        validateArgsImpl(start, end, argsToPass, st, ev,
-                         std::make_index_sequence<Arity>{});
-        return argsToPass;
-    }
-
-    template <typename FwdIterator, size_t... Is>
-    static void validateArgsImpl(FwdIterator start, FwdIterator end,
-                                 TupleT& argTuple, SymbolTable& st, Evaluator& ev, std::index_sequence<Is...>) {
-        if constexpr (sizeof...(Is) == 0) {
-            if (start != end) {
-                throw ArityError(Arity + static_cast<size_t>(std::distance(start, end)),
-                                 Arity);
-            }
-        } else {
-            constexpr size_t currIndex = util::index_sequence_head_v<Is...>;
-            auto&& arg = ev.getOrEvaluateE<std::tuple_element_t<currIndex, TupleT>>(*start, st);
-            std::get<currIndex>(argTuple) = arg;
-            validateArgsImpl(++start, end, argTuple, st, ev, util::index_sequence_tail_t<Is...>{});
-        }
-    }
-
-  public:
-    static void insert(SymbolTable& st, const std::string& s) {
-        st.emplace(s, &FixedArityFunction::apply);
-    }
-};
-
 void SystemMethods::insertIntoScope(SymbolTable& st) {
-    st.emplace("+", &SystemMethods::add);
-    st.emplace("-", &SystemMethods::sub);
-    st.emplace("*", &SystemMethods::mul);
-    st.emplace("/", &SystemMethods::div);
+    st.emplace(Symbol{"+"}, &SystemMethods::add);
+    st.emplace(Symbol{"-"}, &SystemMethods::sub);
+    st.emplace(Symbol{"*"}, &SystemMethods::mul);
+    st.emplace(Symbol{"/"}, &SystemMethods::div);
 
     FixedArityFunction<SystemMethods::quotient>::insert(st, "quotient");
     FixedArityFunction<SystemMethods::remainder>::insert(st, "remainder");
@@ -63,46 +25,60 @@ void SystemMethods::insertIntoScope(SymbolTable& st) {
     FixedArityFunction<SystemMethods::dec>::insert(st, "-1+");
     FixedArityFunction<SystemMethods::abs>::insert(st, "abs");
 
+    FixedArityFunction<SystemMethods::expt>::insert(st, "expt");
+    FixedArityFunction<SystemMethods::modularExpt>::insert(st, "modular-expt");
+    st.emplace(Symbol{"exact-integer-sqrt"}, &SystemMethods::exactIntegerSqrt);
+    FixedArityFunction<SystemMethods::bitwiseAnd>::insert(st, "bitwise-and");
+    FixedArityFunction<SystemMethods::bitwiseOr>::insert(st, "bitwise-or");
+    FixedArityFunction<SystemMethods::bitwiseXor>::insert(st, "bitwise-xor");
+    FixedArityFunction<SystemMethods::arithmeticShift>::insert(st, "arithmetic-shift");
+
     FixedArityFunction<SystemMethods::stringLength>::insert(st, "string-length");
     FixedArityFunction<SystemMethods::stringRef>::insert(st, "string-ref");
     FixedArityFunction<SystemMethods::stringEq>::insert(st, "string=?");
     FixedArityFunction<SystemMethods::stringCIEq>::insert(st, "string-ci=?");
+    st.emplace(Symbol{"string<?"}, &SystemMethods::stringLt);
+    st.emplace(Symbol{"string>?"}, &SystemMethods::stringGt);
+
+    st.emplace(Symbol{"="}, &SystemMethods::eq);
+    st.emplace(Symbol{"<"}, &SystemMethods::lt);
+    st.emplace(Symbol{">"}, &SystemMethods::gt);
+    st.emplace(Symbol{"<="},&SystemMethods::le);
+    st.emplace(Symbol{">="},&SystemMethods::ge);
+    st.emplace(Symbol{"zero?"}, &SystemMethods::zeroQ);
+    st.emplace(Symbol{"positive?"}, &SystemMethods::positiveQ);
+    st.emplace(Symbol{"negative?"}, &SystemMethods::negativeQ);
+    //st.emplace(Symbol{"odd?"}, &SystemMethods::oddQ);
+    //st.emplace(Symbol{"even?"}, &SystemMethods::evenQ);
+    st.emplace(Symbol{"exact?"}, &SystemMethods::exactQ);
+    st.emplace(Symbol{"inexact?"}, &SystemMethods::inexactQ);
+
+    st.emplace(Symbol{"car"}, &SystemMethods::car);
+    st.emplace(Symbol{"cdr"}, &SystemMethods::cdr);
+    st.emplace(Symbol{"cons"}, &SystemMethods::cons);
+    st.emplace(Symbol{"set-car!"}, &SystemMethods::setCar);
+    st.emplace(Symbol{"set-cdr!"}, &SystemMethods::setCdr);
+
+    st.emplace(Symbol{"eq?"}, &SystemMethods::eqQ);
+    st.emplace(Symbol{"eqv?"}, &SystemMethods::eqvQ);
+    st.emplace(Symbol{"equal?"}, &SystemMethods::equalQ);
+    st.emplace(Symbol{"null?"}, &SystemMethods::nullQ);
+    st.emplace(Symbol{"list"}, &SystemMethods::list);
+    st.emplace(Symbol{"display"}, &SystemMethods::display);
+}
+
+Datum SystemMethods::add(ArgSpan args, Evaluator&) {
+    Number sum{0L};
+    for (const Datum& datum : args) {
+        sum += datum.getAtomicValueE<Number>();
+    }
+    return Datum{Atom{sum}};
+}
 
-    st.emplace("=", &SystemMethods::eq);
-    st.emplace("<", &SystemMethods::lt);
-    st.emplace(">", &SystemMethods::gt);
-    st.emplace("<=",&SystemMethods::le);
-    st.emplace("<=",&SystemMethods::ge);
-    st.emplace("zero?", &SystemMethods::zeroQ);
-    st.emplace("positive?", &SystemMethods::positiveQ);
-    st.emplace("negative?", &SystemMethods::negativeQ);
-    //st.emplace("odd?", &SystemMethods::oddQ);
-    //st.emplace("even?", &SystemMethods::evenQ);
-    st.emplace("exact?", &SystemMethods::exactQ);
-    st.emplace("inexact?", &SystemMethods::inexactQ);
-
-    st.emplace("car", &SystemMethods::car);
-    st.emplace("cdr", &SystemMethods::cdr);
-    st.emplace("cons", &SystemMethods::cons);
-
-    st.emplace("eq?", &SystemMethods::eqQ);
-    st.emplace("null?", &SystemMethods::nullQ);
-    st.emplace("list", &SystemMethods::list);
-    st.emplace("display", &SystemMethods::display);
-}
-
-EvalResult SystemMethods::add(LispArgs args, SymbolTable& st, Evaluator& ev) {
-    return Datum{Atom{util::foldr(
-        args.begin(), args.end(), Number{0L},
-        [&](const Datum& datum, const Number& number) {
-            return number + ev.getOrEvaluateE<Number>(datum, st);
-        })}};
-}
-
-EvalResult SystemMethods::sub(LispArgs args, SymbolTable& st, Evaluator& ev) {
+Datum SystemMethods::sub(ArgSpan args, Evaluator&) {
     Number diff{};
     for (auto it = args.begin(); it != args.end(); ++it) {
-        const Number val = ev.getOrEvaluateE<Number>(*it, st);
+        const Number& val = it->getAtomicValueE<Number>();
         if (it == args.begin() && args.size() > 1) {
             diff = val;
         } else {
@@ -112,18 +88,18 @@ EvalResult SystemMethods::sub(LispArgs args, SymbolTable& st, Evaluator& ev) {
     return Datum{Atom{diff}};
 }
 
-EvalResult SystemMethods::mul(LispArgs args, SymbolTable& st, Evaluator& ev) {
-    return Datum{Atom{util::foldr(
-        args.begin(), args.end(), Number{1L},
-        [&](const Datum& datum, const Number& number) {
-            return number * ev.getOrEvaluateE<Number>(datum, st);
-        })}};
+Datum SystemMethods::mul(ArgSpan args, Evaluator&) {
+    Number prod{1L};
+    for (const Datum& datum : args) {
+        prod *= datum.getAtomicValueE<Number>();
+    }
+    return Datum{Atom{prod}};
 }
 
-EvalResult SystemMethods::div(LispArgs args, SymbolTable& st, Evaluator& ev) {
+Datum SystemMethods::div(ArgSpan args, Evaluator&) {
     Number quot{1L};
     for (auto it = args.begin(); it != args.end(); ++it) {
-        const Number val = ev.getOrEvaluateE<Number>(*it, st);
+        const Number& val = it->getAtomicValueE<Number>();
         if (it == args.begin() && args.size() > 1) {
             quot = val;
         } else {
@@ -137,7 +113,7 @@ Number SystemMethods::quotient(Number first, Number second) {
     if (unlikely(!(first.isExact() && second.isExact()))) {
         throw LispError("quotient arguments must be exact");
     }
-    return Number{first.as<BigInt>() / second.as<BigInt>()};
+    return first.quotient(second);
 }
 
 Number SystemMethods::remainder(Number first, Number second) {
@@ -151,9 +127,10 @@ Number SystemMethods::modulo(Number first, Number second) {
     if (unlikely(!(first.isExact() && second.isExact()))) {
         throw LispError("modulo arguments must be exact");
     }
+    // The result has the sign of the divisor
     Number remainder = first % second;
-    if (first * second < Number{0L}) {
-        return second + remainder;
+    if (remainder != Number{0L} && (remainder < Number{0L}) != (second < Number{0L})) {
+        return remainder + second;
     }
     return remainder;
 }
@@ -170,6 +147,138 @@ Number SystemMethods::abs(Number x) {
     return x.abs();
 }
 
+namespace {
+__extension__ using Wide = unsigned __int128;
+
+BigInt exactInteger(const Number& x) {
+    return x.is<int64_t>() ? BigInt{x.as<int64_t>()} : x.as<BigInt>();
+}
+
+void requireExactIntegers(std::initializer_list<const Number*> args, const char* name) {
+    for (const Number* arg : args) {
+        if (unlikely(!arg->isExact())) {
+            throw LispError(name, " arguments must be exact integers");
+        }
+    }
+}
+
+// Rationals are not otherwise normalized, so demote n/1 here
+Number demoteRational(Number x) {
+    if (x.is<Rational<BigInt>>()) {
+        const Rational<BigInt>& rat = x.as<Rational<BigInt>>();
+        if (rat.denominator() == BigInt{1U}) {
+            return Number{rat.numerator()};
+        }
+    }
+    return x;
+}
+
+// An operation on two exact integers, directly on int64_ts where possible
+template<typename SmallOp, typename BigOp>
+Number integerOp(const Number& x, const Number& y, const char* name, SmallOp smallOp,
+                 BigOp bigOp) {
+    requireExactIntegers({&x, &y}, name);
+    if (x.is<int64_t>() && y.is<int64_t>()) {
+        return Number{smallOp(x.as<int64_t>(), y.as<int64_t>())};
+    }
+    return Number{bigOp(exactInteger(x), exactInteger(y))};
+}
+}
+
+Number SystemMethods::expt(Number base, Number exponent) {
+    if (!exponent.isExact() || base.is<double>()) {
+        return Number{std::pow(static_cast<double>(base), static_cast<double>(exponent))};
+    }
+    const bool negative = exponent < Number{0L};
+    if (negative && base == Number{0L}) {
+        throw LispError("Division by zero");
+    }
+    Number result{1L};
+    if (exponent.is<BigInt>()) {
+        // Only 0, 1 and -1 have powers this large that can be represented
+        if (base == Number{0L} || base == Number{1L}) {
+            return base;
+        } else if (base == Number{-1L}) {
+            return (exponent.as<BigInt>() & BigInt{1U}) == BigInt{0U} ? Number{1L} : base;
+        }
+        throw LispError("expt exponent is too large");
+    }
+    // Square and multiply from the top bit down, so that each multiplication
+    // by the base is by the original, small, base
+    const int64_t e = exponent.as<int64_t>();
+    const uint64_t magnitude = negative ? 0 - static_cast<uint64_t>(e) : static_cast<uint64_t>(e);
+    if (magnitude != 0) {
+        result = base;
+        for (int bit = 62 - __builtin_clzll(magnitude); bit >= 0; --bit) {
+            result *= result;
+            if ((magnitude >> bit) & 1) {
+                result *= base;
+            }
+        }
+    }
+    return negative ? demoteRational(Number{1L} / result) : result;
+}
+
+Number SystemMethods::modularExpt(Number base, Number exponent, Number modulus) {
+    requireExactIntegers({&base, &exponent, &modulus}, "modular-expt");
+    if (unlikely(modulus <= Number{0L})) {
+        throw LispError("modular-expt modulus must be positive");
+    } else if (unlikely(exponent < Number{0L})) {
+        throw LispError("modular-expt exponent must be non-negative");
+    }
+    if (!(modulus.is<int64_t>() && exponent.is<int64_t>())) {
+        return Number{BigInt::modPow(exactInteger(base), exactInteger(exponent),
+                                     exactInteger(modulus))};
+    }
+    // Products of residues fit in 128 bits
+    const uint64_t m = static_cast<uint64_t>(modulus.as<int64_t>());
+    const int64_t reduced = (base % modulus).as<int64_t>();
+    const uint64_t b = static_cast<uint64_t>(reduced < 0 ? reduced + modulus.as<int64_t>() : reduced);
+    uint64_t result = 1 % m;
+    for (uint64_t e = static_cast<uint64_t>(exponent.as<int64_t>()), power = b; e != 0; e >>= 1) {
+        if (e & 1) {
+            result = static_cast<uint64_t>(Wide{result} * power % m);
+        }
+        power = static_cast<uint64_t>(Wide{power} * power % m);
+    }
+    return Number{result};
+}
+
+Number SystemMethods::bitwiseAnd(Number x, Number y) {
+    return integerOp(x, y, "bitwise-and", std::bit_and<int64_t>{}, std::bit_and<BigInt>{});
+}
+
+Number SystemMethods::bitwiseOr(Number x, Number y) {
+    return integerOp(x, y, "bitwise-or", std::bit_or<int64_t>{}, std::bit_or<BigInt>{});
+}
+
+Number SystemMethods::bitwiseXor(Number x, Number y) {
+    return integerOp(x, y, "bitwise-xor", std::bit_xor<int64_t>{}, std::bit_xor<BigInt>{});
+}
+
+Number SystemMethods::arithmeticShift(Number n, Number count) {
+    requireExactIntegers({&n, &count}, "arithmetic-shift");
+    if (unlikely(!count.is<int64_t>())) {
+        throw LispError("arithmetic-shift count is too large");
+    }
+    const int64_t k = count.as<int64_t>();
+    if (n.is<int64_t>()) {
+        const int64_t v = n.as<int64_t>();
+        if (k <= -64) {
+            return Number{v < 0 ? -1L : 0L};
+        } else if (k <= 0) {
+            return Number{v >> -k};
+        } else if (int64_t result; k < 63 && !__builtin_mul_overflow(v, int64_t{1} << k, &result)) {
+            return Number{result};
+        }
+    }
+    const BigInt big = exactInteger(n);
+    if (k >= 0) {
+        return Number{big << static_cast<size_t>(k)};
+    }
+    return Number{big >> (0 - static_cast<uint64_t>(k))};
+}
+
 Number SystemMethods::stringLength(std::string s) {
     return Number{s.size()};
 }
@@ -188,155 +297,205 @@ bool SystemMethods::stringCIEq(std::string s1, std::string s2) {
             }) == make_pair(s1.end(), s2.end());
 }
 
-EvalResult SystemMethods::eq(LispArgs args, SymbolTable& st, Evaluator& ev) {
+namespace {
+// Check that each adjacent pair of arguments, of type T, satisfies the given
+// comparison
+template<typename T, typename Compare>
+Datum compareChain(ArgSpan args, Compare cmp) {
     if (args.empty()) {
         return Datum::False();
     }
-    auto it = args.begin();
-    const Number& first = ev.getOrEvaluateE<Number>(*it, st);
-    return Datum{
-        Atom{util::foldr(++it, args.end(), true, [&](const Datum& datum, bool acc) {
-            return acc && first == ev.getOrEvaluateE<Number>(datum, st);
-        })}};
+    for (size_t i = 1; i < args.size(); ++i) {
+        if (!cmp(args[i - 1].getAtomicValueE<T>(), args[i].getAtomicValueE<T>())) {
+            return Datum::False();
+        }
+    }
+    return Datum::True();
 }
 
-EvalResult SystemMethods::lt(LispArgs args, SymbolTable& st, Evaluator& ev) {
-    if (args.empty()) {
-        return Datum::False();
+const Datum& unaryArg(ArgSpan args) {
+    if (args.size() != 1) {
+        throw ArityError(1, args.size());
     }
-    auto it = args.begin();
-    const Number& first = ev.getOrEvaluateE<Number>(*it, st);
-    return Datum{
-        Atom{util::foldr(++it, args.end(), true, [&](const Datum& datum, bool acc) {
-            return acc && first < ev.getOrEvaluateE<Number>(datum, st);
-        })}};
+    return args.front();
+}
 }
 
-EvalResult SystemMethods::gt(LispArgs args, SymbolTable& st, Evaluator& ev) {
-    if (args.empty()) {
-        return Datum::False();
+Datum SystemMethods::exactIntegerSqrt(ArgSpan args, Evaluator&) {
+    const Number& n = unaryArg(args).getAtomicValueE<Number>();
+    if (unlikely(!n.isExact() || n < Number{0L})) {
+        throw LispError("exact-integer-sqrt requires a non-negative exact integer");
     }
-    auto it = args.begin();
-    const Number& first = ev.getOrEvaluateE<Number>(*it, st);
-    return Datum{
-        Atom{util::foldr(++it, args.end(), true, [&](const Datum& datum, bool acc) {
-            return acc && first > ev.getOrEvaluateE<Number>(datum, st);
-        })}};
+    Number root;
+    if (n.is<int64_t>()) {
+        // Correct the floating point estimate, which may be off by one
+        const uint64_t v = static_cast<uint64_t>(n.as<int64_t>());
+        uint64_t s = static_cast<uint64_t>(std::sqrt(static_cast<double>(v)));
+        while (s * s > v) {
+            --s;
+        }
+        while ((s + 1) * (s + 1) <= v) {
+            ++s;
+        }
+        root = Number{s};
+    } else {
+        root = Number{n.as<BigInt>().sqrt()};
+    }
+    // Without multiple values, the root and the remainder are returned as a list
+    auto ret = makeGC<SExpr>(Datum{Atom{root}});
+    ret->cdr = Datum{makeGC<SExpr>(Datum{Atom{n - root * root}})};
+    return Datum{ret};
 }
 
-EvalResult SystemMethods::le(LispArgs args, SymbolTable& st, Evaluator& ev) {
-    if (args.empty()) {
-        return Datum::False();
-    }
-    auto it = args.begin();
-    const Number& first = ev.getOrEvaluateE<Number>(*it, st);
-    return Datum{
-        Atom{util::foldr(++it, args.end(), true, [&](const Datum& datum, bool acc) {
-            return acc && first <= ev.getOrEvaluateE<Number>(datum, st);
-        })}};
+Datum SystemMethods::eq(ArgSpan args, Evaluator&) {
+    return compareChain<Number>(args, std::equal_to<Number>{});
 }
 
-EvalResult SystemMethods::ge(LispArgs args, SymbolTable& st, Evaluator& ev) {
-    if (args.empty()) {
-        return Datum::False();
-    }
-    auto it = args.begin();
-    const Number& first = ev.getOrEvaluateE<Number>(*it, st);
-    return Datum{
-        Atom{util::foldr(++it, args.end(), true, [&](const Datum& datum, bool acc) {
-            return acc && first >= ev.getOrEvaluateE<Number>(datum, st);
-        })}};
+Datum SystemMethods::lt(ArgSpan args, Evaluator&) {
+    return compareChain<Number>(args, std::less<Number>{});
 }
 
-EvalResult SystemMethods::exactQ(LispArgs args, SymbolTable& st, Evaluator& ev) {
-    return Datum{Atom{ev.getOrEvaluateE<Number>(*args.begin(), st).isExact()}};
+Datum SystemMethods::gt(ArgSpan args, Evaluator&) {
+    return compareChain<Number>(args, std::greater<Number>{});
 }
 
-EvalResult SystemMethods::inexactQ(LispArgs args, SymbolTable& st, Evaluator& ev) {
-    return Datum{Atom{!ev.getOrEvaluateE<Number>(*args.begin(), st).isExact()}};
+Datum SystemMethods::le(ArgSpan args, Evaluator&) {
+    return compareChain<Number>(args, std::less_equal<Number>{});
 }
 
-EvalResult SystemMethods::zeroQ(LispArgs args, SymbolTable& st, Evaluator& ev) {
-    return Datum{Atom{ev.getOrEvaluateE<Number>(*args.begin(), st) == Number{0L}}};
+Datum SystemMethods::ge(ArgSpan args, Evaluator&) {
+    return compareChain<Number>(args, std::greater_equal<Number>{});
 }
 
-EvalResult SystemMethods::positiveQ(LispArgs args, SymbolTable& st, Evaluator& ev) {
-    return Datum{Atom{ev.getOrEvaluateE<Number>(*args.begin(), st) > Number{0L}}};
+Datum SystemMethods::stringLt(ArgSpan args, Evaluator&) {
+    return compareChain<std::string>(args, std::less<std::string>{});
 }
 
-EvalResult SystemMethods::negativeQ(LispArgs args, SymbolTable& st, Evaluator& ev) {
-    return Datum{Atom{ev.getOrEvaluateE<Number>(*args.begin(), st) < Number{0L}}};
+Datum SystemMethods::stringGt(ArgSpan args, Evaluator&) {
+    return compareChain<std::string>(args, std::greater<std::string>{});
 }
 
-EvalResult SystemMethods::car(LispArgs args, SymbolTable& st, Evaluator& ev) {
-    Datum arg = ev.computeArg(*args.begin(), st);
-    if (arg.isAtomic()) {
+Datum SystemMethods::exactQ(ArgSpan args, Evaluator&) {
+    return Datum{Atom{unaryArg(args).getAtomicValueE<Number>().isExact()}};
+}
+
+Datum SystemMethods::inexactQ(ArgSpan args, Evaluator&) {
+    return Datum{Atom{!unaryArg(args).getAtomicValueE<Number>().isExact()}};
+}
+
+Datum SystemMethods::zeroQ(ArgSpan args, Evaluator&) {
+    return Datum{Atom{unaryArg(args).getAtomicValueE<Number>() == Number{0L}}};
+}
+
+Datum SystemMethods::positiveQ(ArgSpan args, Evaluator&) {
+    return Datum{Atom{unaryArg(args).getAtomicValueE<Number>() > Number{0L}}};
+}
+
+Datum SystemMethods::negativeQ(ArgSpan args, Evaluator&) {
+    return Datum{Atom{unaryArg(args).getAtomicValueE<Number>() < Number{0L}}};
+}
+
+Datum SystemMethods::car(ArgSpan args, Evaluator&) {
+    const Datum& arg = unaryArg(args);
+    if (arg.isAtomic() || arg.getSExpr() == nullptr) {
         throw LispError("car requires a cons cell");
     }
     return arg.getSExpr()->car;
 }
 
-EvalResult SystemMethods::cdr(LispArgs args, SymbolTable& st, Evaluator& ev) {
-    Datum arg = ev.computeArg(*args.begin(), st);
-    if (arg.isAtomic()) {
+Datum SystemMethods::cdr(ArgSpan args, Evaluator&) {
+    const Datum& arg = unaryArg(args);
+    if (arg.isAtomic() || arg.getSExpr() == nullptr) {
         throw LispError("cdr requires a cons cell");
     }
-    return Datum{arg.getSExpr()->cdr};
+    return arg.getSExpr()->cdr;
 }
 
-EvalResult SystemMethods::cons(LispArgs args, SymbolTable& st, Evaluator& ev) {
+Datum SystemMethods::cons(ArgSpan args, Evaluator&) {
     if (args.size() != 2) {
         throw LispError("Function expects 2 arguments, received ", args.size());
     }
-    auto it = args.begin();
-    auto ret = std::make_shared<SExpr>(ev.computeArg(*it++, st));
-    ret->cdr = ev.computeArg(*it, st);
+    auto ret = makeGC<SExpr>(args[0]);
+    ret->cdr = args[1];
     return Datum{ret};
 }
 
-EvalResult SystemMethods::eqQ(LispArgs args, SymbolTable& st, Evaluator& ev) {
+Datum SystemMethods::setCar(ArgSpan args, Evaluator&) {
     if (args.size() != 2) {
         throw LispError("Function expects 2 arguments, received ", args.size());
     }
+    if (args[0].isAtomic() || args[0].getSExpr() == nullptr) {
+        throw LispError("set-car! requires a cons cell");
+    }
+    args[0].getSExpr()->car = args[1];
+    return Datum{};
+}
 
-    auto it = args.begin();
-    Datum first = ev.computeArg(*it, st);
-    ++it;
-    Datum second = ev.computeArg(*it, st);
-    return Datum{Atom{first == second}};
+Datum SystemMethods::setCdr(ArgSpan args, Evaluator&) {
+    if (args.size() != 2) {
+        throw LispError("Function expects 2 arguments, received ", args.size());
+    }
+    if (args[0].isAtomic() || args[0].getSExpr() == nullptr) {
+        throw LispError("set-cdr! requires a cons cell");
+    }
+    args[0].getSExpr()->cdr = args[1];
+    return Datum{};
 }
 
-EvalResult SystemMethods::list(LispArgs args, SymbolTable& st, Evaluator& ev) {
-    SExprPtr ret = std::make_shared<SExpr>(nullptr);
-    SExpr* curr = ret.get();
-    bool first = true;
+// eq? is eqv?: besides identity, numbers of the same exactness compare by
+// value (as R7RS permits), so that whether an integer is boxed never shows
+Datum SystemMethods::eqQ(ArgSpan args, Evaluator&) {
+    if (args.size() != 2) {
+        throw LispError("Function expects 2 arguments, received ", args.size());
+    }
+    return Datum{Atom{args[0].eqv(args[1])}};
+}
+
+Datum SystemMethods::eqvQ(ArgSpan args, Evaluator&) {
+    if (args.size() != 2) {
+        throw ArityError(2, args.size());
+    }
+    return Datum{Atom{args[0].eqv(args[1])}};
+}
+
+Datum SystemMethods::equalQ(ArgSpan args, Evaluator&) {
+    if (args.size() != 2) {
+        throw ArityError(2, args.size());
+    }
+    return Datum{Atom{args[0].equal(args[1])}};
+}
+
+Datum SystemMethods::list(ArgSpan args, Evaluator&) {
+    SExprPtr ret = nullptr;
+    SExpr* curr = nullptr;
     for (const Datum& datum : args) {
-        if (!first) {
-            curr->cdr = std::make_shared<SExpr>(nullptr);
-            curr = curr->cdr.getSExpr().get();
+        auto cell = makeGC<SExpr>(datum);
+        if (curr == nullptr) {
+            ret = cell;
+        } else {
+            curr->cdr = cell;
         }
-        curr->car = ev.computeArg(datum, st);
-        first = false;
+        curr = cell.get();
     }
     return Datum{ret};
 }
 
-EvalResult SystemMethods::nullQ(LispArgs args, SymbolTable& st, Evaluator& ev) {
+Datum SystemMethods::nullQ(ArgSpan args, Evaluator&) {
     if (args.size() != 1) {
         throw LispError("null? expects only 1 argument");
     }
-    Datum arg = ev.computeArg(*args.begin(), st);
+    const Datum& arg = args.front();
     if (arg.isAtomic()) {
-        return Datum::True();
+        return Datum::False();
     }
     const bool isNull = arg.getSExpr() == nullptr;
     return Datum{Atom{isNull}};
 }
 
-EvalResult SystemMethods::display(LispArgs args, SymbolTable& st, Evaluator& ev) {
+Datum SystemMethods::display(ArgSpan args, Evaluator&) {
     if (args.empty()) {
         return Datum{};
     }
-    std::cout << ev.computeArg(*args.begin(), st);
+    std::cout << args.front();
     return Datum{};
 }
@@ -3,6 +3,9 @@
 #include "data/Data.h"
 
 class SystemMethods {
+    // Sorting recognizes the builtin comparisons, to compare without calls
+    friend class SortMethods;
+
     static BuiltInFunc add;
     static BuiltInFunc sub;
     static BuiltInFunc mul;
@@ -17,10 +20,20 @@ class SystemMethods {
     static Number dec(Number);
     static Number abs(Number);
 
+    static Number expt(Number base, Number exponent);
+    static Number modularExpt(Number base, Number exponent, Number modulus);
+    static BuiltInFunc exactIntegerSqrt;
+    static Number bitwiseAnd(Number, Number);
+    static Number bitwiseOr(Number, Number);
+    static Number bitwiseXor(Number, Number);
+    static Number arithmeticShift(Number n, Number count);
+
     static Number stringLength(std::string);
     static char stringRef(std::string, Number idx);
     static bool stringEq(std::string, std::string);
     static bool stringCIEq(std::string, std::string);
+    static BuiltInFunc stringLt;
+    static BuiltInFunc stringGt;
 
     static BuiltInFunc exactQ;
     static BuiltInFunc inexactQ;
@@ -38,8 +51,12 @@ class SystemMethods {
     static BuiltInFunc car;
     static BuiltInFunc cdr;
     static BuiltInFunc cons;
+    static BuiltInFunc setCar;
+    static BuiltInFunc setCdr;
 
     static BuiltInFunc eqQ;
+    static BuiltInFunc eqvQ;
+    static BuiltInFunc equalQ;
     static BuiltInFunc nullQ;
     static BuiltInFunc list;
     static BuiltInFunc display;
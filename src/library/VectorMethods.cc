@@ -0,0 +1,501 @@
+// (c) Sam Donow 2018
+#include "VectorMethods.h"
+#include "core/Evaluator.h"
+#include "library/FixedArityFunction.h"
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace {
+__extension__ using Wide = __int128;
+
+template<typename T>
+struct Element;
+
+template<>
+struct Element<double> {
+    static constexpr std::string_view name = "f64vector";
+    static double fromNumber(const Number& num) { return static_cast<double>(num); }
+};
+
+template<>
+struct Element<int64_t> {
+    static constexpr std::string_view name = "s64vector";
+    static int64_t fromNumber(const Number& num) {
+        if (unlikely(!num.is<int64_t>())) {
+            throw LispError("s64vector elements must be exact 64-bit integers, found ", num);
+        }
+        return num.as<int64_t>();
+    }
+};
+
+template<typename T>
+using VectorPtr = GCPtr<NumericVector<T>>;
+
+template<typename T>
+Datum vectorDatum(std::vector<T> elements) {
+    return Datum{Atom{makeGC<NumericVector<T>>(std::move(elements))}};
+}
+
+void checkArity(ArgSpan args, size_t arity) {
+    if (args.size() != arity) {
+        throw ArityError(arity, args.size());
+    }
+}
+
+size_t checkedIndex(const Number& index, size_t size) {
+    if (!index.isExact()) {
+        throw TypeError("exact integer", stringConcat(index));
+    } else if (!index.is<int64_t>() || index.as<int64_t>() < 0 ||
+               static_cast<uint64_t>(index.as<int64_t>()) >= size) {
+        throw LispError("Index out of range: ", index);
+    }
+    return static_cast<size_t>(index.as<int64_t>());
+}
+
+// Indices are almost always fixnums, which are checked without making a Number
+size_t checkedIndex(const Datum& index, size_t size) {
+    if (likely(index.isFixnum())) {
+        if (const int64_t i = index.fixnumValue(); i >= 0 && static_cast<uint64_t>(i) < size) {
+            return static_cast<size_t>(i);
+        }
+    }
+    return checkedIndex(index.getAtomicValueE<Number>(), size);
+}
+
+// A bound of a range of elements, in [0, size]
+size_t checkedBound(const Datum& bound, size_t size) {
+    return bound.isFixnum() && bound.fixnumValue() == static_cast<int64_t>(size)
+               ? size
+               : checkedIndex(bound, size);
+}
+
+// The range [start, end) given by the optional arguments from args[first]
+std::pair<size_t, size_t> checkedRange(ArgSpan args, size_t first, size_t size) {
+    const size_t start = args.size() > first ? checkedBound(args[first], size) : 0;
+    const size_t end = args.size() > first + 1 ? checkedBound(args[first + 1], size) : size;
+    if (unlikely(start > end)) {
+        throw LispError("Invalid range: [", start, ", ", end, ")");
+    }
+    return {start, end};
+}
+
+// A length given as an argument: a non-negative exact integer
+size_t checkedLength(const Datum& length) {
+    const Number num = length.getAtomicValueE<Number>();
+    if (unlikely(!num.is<int64_t>() || num.as<int64_t>() < 0)) {
+        throw LispError("Invalid vector length: ", num);
+    }
+    return static_cast<size_t>(num.as<int64_t>());
+}
+
+void checkArity(ArgSpan args, size_t minArity, size_t maxArity) {
+    if (args.size() < minArity || args.size() > maxArity) {
+        throw ArityError(args.size() < minArity ? minArity : maxArity, args.size());
+    }
+}
+
+GCPtr<Vector> vectorArg(const Datum& datum) {
+    return datum.getAtomicValueE<GCPtr<Vector>>();
+}
+
+Datum vectorDatum(std::vector<Datum> elements) {
+    return Datum{Atom{makeGC<Vector>(std::move(elements))}};
+}
+
+// Call f with the numeric vector in datum, of either element type
+template<typename F>
+Datum withVector(const Datum& datum, F f) {
+    if (auto f64 = datum.getAtomicValue<VectorPtr<double>>()) {
+        return f(*f64);
+    } else if (auto s64 = datum.getAtomicValue<VectorPtr<int64_t>>()) {
+        return f(*s64);
+    }
+    throw TypeError("f64vector or s64vector", datum.typeName());
+}
+
+// The elements of a second operand, which must match the first in type and length
+template<typename T>
+const std::vector<T>& matchingElements(const Datum& datum, const std::vector<T>& first) {
+    const std::vector<T>& elements =
+        datum.getAtomicValueE<VectorPtr<T>>()->elements;
+    if (unlikely(elements.size() != first.size())) {
+        throw LispError("Vector lengths differ: ", first.size(), " and ", elements.size());
+    }
+    return elements;
+}
+
+Number wideNumber(Wide value) {
+    if (value >= std::numeric_limits<int64_t>::min() && value <= std::numeric_limits<int64_t>::max()) {
+        return Number{static_cast<long>(value)};
+    }
+    const BigInt high{static_cast<int64_t>(value >> 64)};
+    return Number{(high << 64) + BigInt{static_cast<uint64_t>(value)}};
+}
+
+// The loops below are kept free of branches and calls so that they vectorize.
+// Overflow of integer elements is accumulated, and checked after the loop
+
+void addElements(const double* a, const double* b, double* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = a[i] + b[i];
+    }
+}
+
+void addElements(const int64_t* a, const int64_t* b, int64_t* out, size_t n) {
+    // A sum overflows when its sign differs from the signs of both operands
+    uint64_t overflow = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const uint64_t x = static_cast<uint64_t>(a[i]);
+        const uint64_t y = static_cast<uint64_t>(b[i]);
+        const uint64_t sum = x + y;
+        out[i] = static_cast<int64_t>(sum);
+        overflow |= (x ^ sum) & (y ^ sum);
+    }
+    if (unlikely(overflow >> 63)) {
+        throw LispError("s64vector element overflow");
+    }
+}
+
+void scaleElements(const double* a, double k, double* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = a[i] * k;
+    }
+}
+
+void scaleElements(const int64_t* a, int64_t k, int64_t* out, size_t n) {
+    bool overflow = false;
+    for (size_t i = 0; i < n; ++i) {
+        overflow |= __builtin_mul_overflow(a[i], k, &out[i]);
+    }
+    if (unlikely(overflow)) {
+        throw LispError("s64vector element overflow");
+    }
+}
+
+// Floating point sums are accumulated in four independent partial sums, as
+// the compiler may not reassociate them into vector lanes itself
+Number sumElements(const double* a, size_t n) {
+    double partial[4] = {};
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        for (size_t j = 0; j < 4; ++j) {
+            partial[j] += a[i + j];
+        }
+    }
+    for (; i < n; ++i) {
+        partial[0] += a[i];
+    }
+    return Number{(partial[0] + partial[1]) + (partial[2] + partial[3])};
+}
+
+// No sum of fewer than 2^64 elements overflows 128 bits
+Number sumElements(const int64_t* a, size_t n) {
+    Wide total = 0;
+    for (size_t i = 0; i < n; ++i) {
+        total += a[i];
+    }
+    return wideNumber(total);
+}
+
+Number dotElements(const double* a, const double* b, size_t n) {
+    double partial[4] = {};
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        for (size_t j = 0; j < 4; ++j) {
+            partial[j] += a[i + j] * b[i + j];
+        }
+    }
+    for (; i < n; ++i) {
+        partial[0] += a[i] * b[i];
+    }
+    return Number{(partial[0] + partial[1]) + (partial[2] + partial[3])};
+}
+
+// Each product fits in 128 bits, but their sum may not, in which case the
+// sum is recomputed exactly
+Number dotElements(const int64_t* a, const int64_t* b, size_t n) {
+    Wide total = 0;
+    bool overflow = false;
+    for (size_t i = 0; i < n; ++i) {
+        overflow |= __builtin_add_overflow(total, Wide{a[i]} * b[i], &total);
+    }
+    if (likely(!overflow)) {
+        return wideNumber(total);
+    }
+    Number exact{0L};
+    for (size_t i = 0; i < n; ++i) {
+        exact += wideNumber(Wide{a[i]} * b[i]);
+    }
+    return exact;
+}
+
+template<typename T, typename Compare>
+Number extremeElement(const std::vector<T>& elements, Compare better) {
+    if (unlikely(elements.empty())) {
+        throw LispError("Extreme of an empty ", Element<T>::name);
+    }
+    T extreme = elements.front();
+    for (const T element : elements) {
+        extreme = better(element, extreme) ? element : extreme;
+    }
+    return Number{extreme};
+}
+}
+
+Datum VectorMethods::vector(ArgSpan args, Evaluator&) {
+    return vectorDatum(std::vector<Datum>(args.begin(), args.end()));
+}
+
+Datum VectorMethods::makeVector(ArgSpan args, Evaluator&) {
+    checkArity(args, 1, 2);
+    const Datum fill = args.size() == 2 ? args[1] : Datum{};
+    return vectorDatum(std::vector<Datum>(checkedLength(args[0]), fill));
+}
+
+Number VectorMethods::vectorLength(GCPtr<Vector> vec) {
+    return Number{vec->elements.size()};
+}
+
+Datum VectorMethods::vectorRef(ArgSpan args, Evaluator&) {
+    checkArity(args, 2);
+    const std::vector<Datum>& elements = vectorArg(args[0])->elements;
+    return elements[checkedIndex(args[1], elements.size())];
+}
+
+Datum VectorMethods::vectorSet(ArgSpan args, Evaluator&) {
+    checkArity(args, 3);
+    std::vector<Datum>& elements = vectorArg(args[0])->elements;
+    elements[checkedIndex(args[1], elements.size())] = args[2];
+    return Datum{};
+}
+
+Datum VectorMethods::vectorFill(ArgSpan args, Evaluator&) {
+    checkArity(args, 2, 4);
+    std::vector<Datum>& elements = vectorArg(args[0])->elements;
+    const auto [start, end] = checkedRange(args, 2, elements.size());
+    std::fill(elements.begin() + static_cast<ptrdiff_t>(start),
+              elements.begin() + static_cast<ptrdiff_t>(end), args[1]);
+    return Datum{};
+}
+
+// A new vector of the given length, no shorter than vec, starting with its
+// elements; the rest are unspecified
+Datum VectorMethods::vectorGrow(ArgSpan args, Evaluator&) {
+    checkArity(args, 2);
+    const std::vector<Datum>& elements = vectorArg(args[0])->elements;
+    const size_t length = checkedLength(args[1]);
+    if (unlikely(length < elements.size())) {
+        throw LispError("vector-grow cannot shrink a vector of length ", elements.size(),
+                        " to ", length);
+    }
+    std::vector<Datum> grown;
+    grown.reserve(length);
+    grown.insert(grown.end(), elements.begin(), elements.end());
+    grown.resize(length);
+    return vectorDatum(std::move(grown));
+}
+
+Datum VectorMethods::subvector(ArgSpan args, Evaluator&) {
+    checkArity(args, 3);
+    const std::vector<Datum>& elements = vectorArg(args[0])->elements;
+    const auto [start, end] = checkedRange(args, 1, elements.size());
+    return vectorDatum(std::vector<Datum>(elements.begin() + static_cast<ptrdiff_t>(start),
+                                          elements.begin() + static_cast<ptrdiff_t>(end)));
+}
+
+Datum VectorMethods::vectorToList(ArgSpan args, Evaluator&) {
+    checkArity(args, 1, 3);
+    const std::vector<Datum>& elements = vectorArg(args[0])->elements;
+    const auto [start, end] = checkedRange(args, 1, elements.size());
+    Datum list{SExprPtr{nullptr}};
+    for (size_t i = end; i > start; --i) {
+        list = Datum{makeGC<SExpr>(elements[i - 1], list)};
+    }
+    return list;
+}
+
+Datum VectorMethods::listToVector(ArgSpan args, Evaluator&) {
+    checkArity(args, 1);
+    if (args[0].isAtomic()) {
+        throw TypeError("list", args[0].typeName());
+    }
+    std::vector<Datum> elements;
+    for (const SExpr* cell = args[0].getSExpr(); cell != nullptr; cell = cell->cdr.getSExpr()) {
+        elements.push_back(cell->car);
+    }
+    return vectorDatum(std::move(elements));
+}
+
+template<typename T>
+Datum VectorMethods::make(ArgSpan args, Evaluator&) {
+    std::vector<T> elements;
+    elements.reserve(args.size());
+    for (const Datum& arg : args) {
+        elements.push_back(Element<T>::fromNumber(arg.getAtomicValueE<Number>()));
+    }
+    return vectorDatum(std::move(elements));
+}
+
+template<typename T>
+Datum VectorMethods::makeFilled(ArgSpan args, Evaluator&) {
+    if (args.size() != 1 && args.size() != 2) {
+        throw ArityError(2, args.size());
+    }
+    const Number size = args[0].getAtomicValueE<Number>();
+    if (unlikely(!size.is<int64_t>() || size.as<int64_t>() < 0)) {
+        throw LispError("Invalid ", Element<T>::name, " length: ", size);
+    }
+    const T fill = args.size() == 2 ? Element<T>::fromNumber(args[1].getAtomicValueE<Number>()) : T{};
+    return vectorDatum(std::vector<T>(static_cast<size_t>(size.as<int64_t>()), fill));
+}
+
+template<typename T>
+Number VectorMethods::length(GCPtr<NumericVector<T>> vec) {
+    return Number{vec->elements.size()};
+}
+
+template<typename T>
+Number VectorMethods::ref(GCPtr<NumericVector<T>> vec, Number index) {
+    return Number{vec->elements[checkedIndex(index, vec->elements.size())]};
+}
+
+template<typename T>
+Datum VectorMethods::set(ArgSpan args, Evaluator&) {
+    checkArity(args, 3);
+    std::vector<T>& elements = args[0].getAtomicValueE<VectorPtr<T>>()->elements;
+    const size_t index = checkedIndex(args[1], elements.size());
+    elements[index] = Element<T>::fromNumber(args[2].getAtomicValueE<Number>());
+    return Datum{};
+}
+
+template<typename T>
+Datum VectorMethods::fromList(ArgSpan args, Evaluator&) {
+    checkArity(args, 1);
+    if (args[0].isAtomic()) {
+        throw TypeError("list", args[0].typeName());
+    }
+    std::vector<T> elements;
+    for (const SExpr* cell = args[0].getSExpr(); cell != nullptr; cell = cell->cdr.getSExpr()) {
+        elements.push_back(Element<T>::fromNumber(cell->car.getAtomicValueE<Number>()));
+    }
+    return vectorDatum(std::move(elements));
+}
+
+template<typename T>
+Datum VectorMethods::toList(ArgSpan args, Evaluator&) {
+    checkArity(args, 1);
+    const std::vector<T>& elements = args[0].getAtomicValueE<VectorPtr<T>>()->elements;
+    Datum list{SExprPtr{nullptr}};
+    for (auto it = elements.rbegin(); it != elements.rend(); ++it) {
+        list = Datum{makeGC<SExpr>(Datum{Atom{Number{*it}}}, list)};
+    }
+    return list;
+}
+
+Datum VectorMethods::add(ArgSpan args, Evaluator&) {
+    checkArity(args, 2);
+    return withVector(args[0], [&](const auto& vec) {
+        const auto& a = vec->elements;
+        const auto& b = matchingElements(args[1], a);
+        std::remove_const_t<std::remove_reference_t<decltype(a)>> out(a.size());
+        addElements(a.data(), b.data(), out.data(), a.size());
+        return vectorDatum(std::move(out));
+    });
+}
+
+Datum VectorMethods::scale(ArgSpan args, Evaluator&) {
+    checkArity(args, 2);
+    return withVector(args[0], [&](const auto& vec) {
+        using T = typename std::decay_t<decltype(*vec)>::value_type;
+        const std::vector<T>& a = vec->elements;
+        const T k = Element<T>::fromNumber(args[1].getAtomicValueE<Number>());
+        std::vector<T> out(a.size());
+        scaleElements(a.data(), k, out.data(), a.size());
+        return vectorDatum(std::move(out));
+    });
+}
+
+Datum VectorMethods::dot(ArgSpan args, Evaluator&) {
+    checkArity(args, 2);
+    return withVector(args[0], [&](const auto& vec) {
+        const auto& a = vec->elements;
+        const auto& b = matchingElements(args[1], a);
+        return Datum{Atom{dotElements(a.data(), b.data(), a.size())}};
+    });
+}
+
+Datum VectorMethods::sum(ArgSpan args, Evaluator&) {
+    checkArity(args, 1);
+    return withVector(args[0], [](const auto& vec) {
+        return Datum{Atom{sumElements(vec->elements.data(), vec->elements.size())}};
+    });
+}
+
+Datum VectorMethods::min(ArgSpan args, Evaluator&) {
+    checkArity(args, 1);
+    return withVector(args[0], [](const auto& vec) {
+        return Datum{Atom{extremeElement(vec->elements, std::less<>{})}};
+    });
+}
+
+Datum VectorMethods::max(ArgSpan args, Evaluator&) {
+    checkArity(args, 1);
+    return withVector(args[0], [](const auto& vec) {
+        return Datum{Atom{extremeElement(vec->elements, std::greater<>{})}};
+    });
+}
+
+Datum VectorMethods::mapInPlace(ArgSpan args, Evaluator& ev) {
+    checkArity(args, 2);
+    const Datum& proc = args[0];
+    return withVector(args[1], [&](const auto& vec) {
+        using T = typename std::decay_t<decltype(*vec)>::value_type;
+        std::vector<T>& elements = vec->elements;
+        for (size_t i = 0; i < elements.size(); ++i) {
+            const Datum arg{Atom{Number{elements[i]}}};
+            const Datum result = ev.apply(proc, ArgSpan{&arg, 1});
+            elements[i] = Element<T>::fromNumber(result.getAtomicValueE<Number>());
+        }
+        return Datum{Atom{vec}};
+    });
+}
+
+template<typename T>
+void VectorMethods::insertTyped(SymbolTable& st) {
+    const std::string name{Element<T>::name};
+    st.emplace(Symbol{name}, &make<T>);
+    st.emplace(Symbol{"make-" + name}, &makeFilled<T>);
+    FixedArityFunction<&length<T>>::insert(st, name + "-length");
+    FixedArityFunction<&ref<T>>::insert(st, name + "-ref");
+    st.emplace(Symbol{name + "-set!"}, &set<T>);
+    st.emplace(Symbol{"list->" + name}, &fromList<T>);
+    st.emplace(Symbol{name + "->list"}, &toList<T>);
+}
+
+void VectorMethods::insertIntoScope(SymbolTable& st) {
+    st.emplace(Symbol{"vector"}, &VectorMethods::vector);
+    st.emplace(Symbol{"make-vector"}, &VectorMethods::makeVector);
+    FixedArityFunction<&VectorMethods::vectorLength>::insert(st, "vector-length");
+    st.emplace(Symbol{"vector-ref"}, &VectorMethods::vectorRef);
+    st.emplace(Symbol{"vector-set!"}, &VectorMethods::vectorSet);
+    st.emplace(Symbol{"vector-fill!"}, &VectorMethods::vectorFill);
+    st.emplace(Symbol{"vector-grow"}, &VectorMethods::vectorGrow);
+    st.emplace(Symbol{"subvector"}, &VectorMethods::subvector);
+    st.emplace(Symbol{"vector->list"}, &VectorMethods::vectorToList);
+    st.emplace(Symbol{"list->vector"}, &VectorMethods::listToVector);
+
+    insertTyped<double>(st);
+    insertTyped<int64_t>(st);
+
+    st.emplace(Symbol{"vector-add"}, &VectorMethods::add);
+    st.emplace(Symbol{"vector-scale"}, &VectorMethods::scale);
+    st.emplace(Symbol{"dot"}, &VectorMethods::dot);
+    st.emplace(Symbol{"sum"}, &VectorMethods::sum);
+    st.emplace(Symbol{"vector-min"}, &VectorMethods::min);
+    st.emplace(Symbol{"vector-max"}, &VectorMethods::max);
+    st.emplace(Symbol{"vector-map!"}, &VectorMethods::mapInPlace);
+}
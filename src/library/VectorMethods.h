@@ -0,0 +1,48 @@
+// (c) Sam Donow 2018
+#pragma once
+#include "data/Data.h"
+
+/// Builtins on vectors: the vectors of any data of R7RS, and the homogeneous
+/// numeric vectors, f64vectors and s64vectors. Those named for one numeric
+/// element type are templates over it; the bulk operations accept either type
+class VectorMethods {
+    static BuiltInFunc vector;
+    static BuiltInFunc makeVector;
+    static Number vectorLength(GCPtr<Vector> vec);
+    static BuiltInFunc vectorRef;
+    static BuiltInFunc vectorSet;
+    static BuiltInFunc vectorFill;
+    static BuiltInFunc vectorGrow;
+    static BuiltInFunc subvector;
+    static BuiltInFunc vectorToList;
+    static BuiltInFunc listToVector;
+
+    template<typename T>
+    static Datum make(ArgSpan args, Evaluator& ev);
+    template<typename T>
+    static Datum makeFilled(ArgSpan args, Evaluator& ev);
+    template<typename T>
+    static Number length(GCPtr<NumericVector<T>> vec);
+    template<typename T>
+    static Number ref(GCPtr<NumericVector<T>> vec, Number index);
+    template<typename T>
+    static Datum set(ArgSpan args, Evaluator& ev);
+    template<typename T>
+    static Datum fromList(ArgSpan args, Evaluator& ev);
+    template<typename T>
+    static Datum toList(ArgSpan args, Evaluator& ev);
+
+    static BuiltInFunc add;
+    static BuiltInFunc scale;
+    static BuiltInFunc dot;
+    static BuiltInFunc sum;
+    static BuiltInFunc min;
+    static BuiltInFunc max;
+    static BuiltInFunc mapInPlace;
+
+    template<typename T>
+    static void insertTyped(SymbolTable& st);
+
+  public:
+    static void insertIntoScope(SymbolTable& st);
+};
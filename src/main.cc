@@ -1,9 +1,11 @@
 // (c) Sam Donow 2017
 #include "core/Evaluator.h"
 #include "core/Lexer.h"
-#include "core/Parser.h"
+#include "core/Loader.h"
+#include "core/StreamParser.h"
 
 #include <iostream>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <stdio.h>
@@ -23,7 +25,10 @@ std::pair<string_view, bool> getline() {
     if (line != nullptr && *line != '\0') {
         add_history(line);
     }
-    return {line, line == nullptr};
+    if (line == nullptr) {
+        return {{}, true};
+    }
+    return {line, false};
 }
 
 int main(int argc, char** argv) {
@@ -33,43 +38,99 @@ int main(int argc, char** argv) {
     rl_bind_key('\t', rl_insert);
     int opt;
     bool debugPrintTokens = false;
-    while ((opt = getopt(argc, argv, "t")) != -1) {
+    bool interpretOnly = false;
+    bool printGCStats = false;
+    while ((opt = getopt(argc, argv, "tign:")) != -1) {
         switch (opt) {
             case 't':
                 debugPrintTokens = true;
                 break;
+            case 'i':
+                interpretOnly = true;
+                break;
+            case 'g':
+                printGCStats = true;
+                break;
+            case 'n':
+                Heap::get().setNurserySize(stoul(optarg));
+                break;
         }
     }
-    Lexer lex;
-    Parser parser;
     Evaluator evaluator;
-    string bufferedInput;
-    vector<Token> tokens;
-    do {
+    evaluator.setBytecodeEnabled(!interpretOnly);
+    // Files given on the command line are run in order, instead of the REPL
+    if (optind < argc) {
         try {
-            auto [inputLine, eof] = getline();
-            if (eof) {
-                exit(0);
-            }
-            while (!inputLine.empty()) {
-                auto && [ token, modInput ] = lex.next(inputLine);
-                tokens.emplace_back(move(token));
-                inputLine = modInput;
+            for (int i = optind; i < argc; ++i) {
+                Loader::loadFile(argv[i], evaluator.getGlobalScope(), evaluator);
             }
+        } catch (const LispError& err) {
+            cerr << "error: " << err.what() << endl;
+            return 1;
+        }
+        if (printGCStats) {
+            cerr << Heap::get().stats() << endl;
+        }
+        return 0;
+    }
+    Lexer lex;
+    StreamParser parser;
+    // Each line is parsed, and the forms it completes evaluated; after an
+    // error, the rest of the line and any form it was within are discarded,
+    // and reading carries on with the next line
+    const auto runLine = [&](string_view line) {
+        try {
             if (debugPrintTokens) {
-                for (const Token& token : tokens) {
+                for (const Token& token : lex.getTokens(line)) {
                     cout << token << ", ";
                 }
                 cout << endl;
             }
-            auto expr = parser.parse(tokens);
-            while (expr) {
-                auto result = evaluator.eval(*expr);
-                cout << result << endl;
-                expr = parser.parse(tokens);
+            parser.feed(line);
+            parser.feed("\n");
+            while (optional<Datum> form = parser.next()) {
+                cout << evaluator.computeArg(*form, evaluator.getGlobalScope()) << endl;
             }
         } catch (const LispError& err) {
             cout << "error: " << err.what() << endl;
+            parser.reset();
+        }
+    };
+    // Input piped in is read in large pieces rather than by readline, and
+    // without prompts
+    if (!isatty(STDIN_FILENO)) {
+        string pending;
+        char buffer[1 << 16];
+        ssize_t size;
+        while ((size = read(STDIN_FILENO, buffer, sizeof(buffer))) > 0) {
+            pending.append(buffer, static_cast<size_t>(size));
+            size_t start = 0;
+            for (size_t end; (end = pending.find('\n', start)) != string::npos; start = end + 1) {
+                runLine(string_view{pending}.substr(start, end - start));
+            }
+            pending.erase(0, start);
+        }
+        if (!pending.empty()) {
+            runLine(pending);
+        }
+        try {
+            parser.finish();
+        } catch (const LispError& err) {
+            cout << "error: " << err.what() << endl;
+        }
+        if (printGCStats) {
+            cerr << Heap::get().stats() << endl;
+        }
+        return 0;
+    }
+    do {
+        auto [inputLine, eof] = getline();
+        if (eof) {
+            if (printGCStats) {
+                cerr << Heap::get().stats() << endl;
+            }
+            exit(0);
         }
+        runLine(inputLine);
     } while (true);
 }
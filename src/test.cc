@@ -6,6 +6,7 @@
 #include "test/NumberTest.h"
 #include "test/RationalTest.h"
 #include "test/SmallVectorTest.h"
+#include "test/StreamParserTest.h"
 
 #include <algorithm>
 #include <string>
@@ -2,6 +2,12 @@
 #pragma once
 #include "test/TestSuite.h"
 #include "data/BigInt.h"
+#include "data/Error.h"
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <utility>
 
 struct BigIntTester : Tester<BigIntTester> {
 
@@ -25,5 +31,184 @@ struct BigIntTester : Tester<BigIntTester> {
                      BigInt{std::numeric_limits<int32_t>::max()}) / BigInt{2},
                      BigInt{std::numeric_limits<int32_t>::max()});
 
+        // Carries and borrows across digits, and signs
+        const BigInt twoTo32{uint64_t{1} << 32};
+        TS_ASSERT_EQ(BigInt{std::numeric_limits<uint32_t>::max()} + BigInt{1}, twoTo32);
+        TS_ASSERT_EQ(twoTo32 - BigInt{1}, BigInt{std::numeric_limits<uint32_t>::max()});
+        TS_ASSERT_EQ(BigInt{1} - twoTo32, -BigInt{std::numeric_limits<uint32_t>::max()});
+        TS_ASSERT_EQ(twoTo32 * twoTo32 - BigInt{1} + BigInt{1}, twoTo32 * twoTo32);
+        TS_ASSERT_EQ(BigInt{-3} + BigInt{-4}, BigInt{-7});
+        TS_ASSERT(BigInt{-5} < BigInt{-3});
+        TS_ASSERT(twoTo32 > BigInt{std::numeric_limits<uint32_t>::max()});
+        TS_ASSERT(BigInt{uint64_t{3} << 32} > BigInt{(uint64_t{2} << 32) + 5});
+        TS_ASSERT_EQ(*(twoTo32 * BigInt{5} - twoTo32).toInt64(), int64_t{4} << 32);
+        TS_ASSERT(!(twoTo32 * twoTo32).toInt64());
+
+        // Karatsuba and Toom-3 (forced with low thresholds) agree with the
+        // schoolbook algorithm, for balanced and unbalanced operands
+        BigInt x{uint32_t{0x9e3779b9}};
+        BigInt y{uint32_t{0x7f4a7c15}};
+        for (size_t i = 1; i < 40; ++i) {
+            x = x * twoTo32 + BigInt{static_cast<uint32_t>(i * 0x85ebca6b)};
+            if (i % 3 == 0) {
+                y = y * twoTo32 + BigInt{static_cast<uint32_t>(i * 0xc2b2ae35)};
+            }
+        }
+        const BigInt z = y * y * x;
+        constexpr size_t never = std::numeric_limits<size_t>::max();
+        BigInt::setMulThresholds(never, never);
+        const BigInt products[] = {x * x, x * y, y * z, z * x, -x * z};
+        const BigInt square = (x + BigInt{1}) * (x + BigInt{1});
+        BigInt::setMulThresholds(4, never);
+        TS_ASSERT(x * x == products[0] && x * y == products[1] && y * z == products[2] &&
+                  z * x == products[3] && -x * z == products[4]);
+        BigInt::setMulThresholds(4, 9);
+        TS_ASSERT(x * x == products[0] && x * y == products[1] && y * z == products[2] &&
+                  z * x == products[3] && -x * z == products[4]);
+        TS_ASSERT_EQ(x * x + x + x + BigInt{1}, square);
+        BigInt::setMulThresholds(BigInt::defaultKaratsubaThreshold, BigInt::defaultToom3Threshold);
+
+        // Every supported set of kernels agrees with the one digit at a time
+        // kernels, for odd and even lengths and long carry and borrow chains
+        const BigInt odd = x * twoTo32 + BigInt{7u};
+        const BigInt ones = twoTo32 * twoTo32 * twoTo32 * odd - BigInt{1u};
+        const BigInt::Kernels defaultKernels = BigInt::activeKernels();
+        TS_ASSERT(BigInt::setKernels(BigInt::Kernels::Digit32));
+        const BigInt kernelResults[] = {x * odd, odd * y, z * odd, ones * ones, ones * y,
+                                        odd + x, ones + BigInt{1u}, odd - x, x - ones,
+                                        -ones - odd};
+        for (BigInt::Kernels kind : {BigInt::Kernels::Word64, BigInt::Kernels::Adx}) {
+            if (!BigInt::setKernels(kind)) {
+                continue;
+            }
+            const BigInt results[] = {x * odd, odd * y, z * odd, ones * ones, ones * y,
+                                      odd + x, ones + BigInt{1u}, odd - x, x - ones,
+                                      -ones - odd};
+            TS_ASSERT(std::equal(std::begin(results), std::end(results),
+                                 std::begin(kernelResults)));
+        }
+        TS_ASSERT(BigInt::setKernels(defaultKernels));
+
+        // Compound operators work in place, including on themselves, and the
+        // rvalue overloads agree with the lvalue ones
+        BigInt acc = x;
+        acc += acc;
+        TS_ASSERT_EQ(acc, x * BigInt{2});
+        acc -= x * BigInt{3};
+        TS_ASSERT_EQ(acc, -x);
+        acc += y;
+        TS_ASSERT_EQ(acc, y - x);
+        acc *= BigInt{-7};
+        TS_ASSERT_EQ(acc, (x - y) * BigInt{7});
+        acc *= acc;
+        TS_ASSERT_EQ(acc, (x - y) * (x - y) * BigInt{49});
+        acc -= acc;
+        TS_ASSERT_EQ(acc, BigInt{0});
+        TS_ASSERT(!(acc < BigInt{0}));
+        acc = BigInt{3};
+        acc *= x;
+        TS_ASSERT_EQ(acc, x * BigInt{3});
+        TS_ASSERT_EQ(BigInt{x} + y, x + y);
+        TS_ASSERT_EQ(x + BigInt{y}, x + y);
+        TS_ASSERT_EQ(BigInt{x} - y, x - y);
+        TS_ASSERT_EQ(y - BigInt{x}, y - x);
+        TS_ASSERT_EQ(BigInt{y} - BigInt{x}, y - x);
+        TS_ASSERT_EQ(-BigInt{x} * BigInt{y}, -(x * y));
+        TS_ASSERT_EQ(BigInt{x} * BigInt{0}, BigInt{0});
+
+        // Long division, by single digits and by longer divisors, including
+        // the rare case in which the quotient digit estimate must be corrected
+        const BigInt rem = y - BigInt{12345};
+        TS_ASSERT((x * y + rem) / y == x && (x * y + rem) % y == rem);
+        TS_ASSERT((z * x + rem) / x == z && (z * x + rem) % x == rem);
+        TS_ASSERT((-(x * y + rem)) / y == -x && (-(x * y + rem)) % y == -rem);
+        TS_ASSERT((x * y + rem) / -y == -x && (x * y + rem) % -y == rem);
+        TS_ASSERT_EQ((x * BigInt{7u} + BigInt{3u}) % BigInt{7u}, BigInt{3u});
+        TS_ASSERT((x * BigInt{7u} + BigInt{3u}) / BigInt{7u} == x);
+        TS_ASSERT(y / x == BigInt{0} && y % x == y);
+        const BigInt addBack = BigInt{uint64_t{0x7fffffff80000000}} * twoTo32 * twoTo32;
+        const BigInt addBackDivisor = BigInt{uint64_t{1} << 63} * twoTo32 + BigInt{1u};
+        TS_ASSERT(addBack / addBackDivisor == BigInt{uint32_t{0xfffffffe}});
+        TS_ASSERT(addBack % addBackDivisor ==
+                  BigInt{uint64_t{0x7fffffffffffffff}} * twoTo32 + BigInt{2u});
+        bool threw = false;
+        try {
+            static_cast<void>(x / BigInt{0});
+        } catch (const LispError&) {
+            threw = true;
+        }
+        TS_ASSERT(threw);
+
+        // Decimal conversion, chunk by chunk for small values and by dividing
+        // and conquering with the cached powers of 10^9 for large ones
+        const BigInt twoTo96 = twoTo32 * twoTo32 * twoTo32;
+        TS_ASSERT_REP(twoTo96, "79228162514264337593543950336");
+        TS_ASSERT_EQ(BigInt::fromString("-79228162514264337593543950336"), -twoTo96);
+        TS_ASSERT_EQ(BigInt::fromString("+000"), BigInt{0});
+        TS_ASSERT_EQ(BigInt::fromString("-0").toString(), "0");
+        BigInt power{1u};
+        for (size_t i = 0; i < 300; ++i) {
+            power = power * BigInt{1'000'000'000u};
+        }
+        TS_ASSERT_EQ(power.toString(), "1" + std::string(2700, '0'));
+        TS_ASSERT_EQ(BigInt::fromString("1" + std::string(2700, '0')), power);
+        TS_ASSERT_EQ((-(power + BigInt{1u})).toString(), "-1" + std::string(2699, '0') + "1");
+        std::string digits;
+        for (size_t i = 0; i < 600; ++i) {
+            digits += "1234567890";
+        }
+        TS_ASSERT_EQ(BigInt::fromString(digits).toString(), digits);
+        const BigInt big = z * z * z * z * x;
+        TS_ASSERT(BigInt::fromString(big.toString()) == big);
+        threw = false;
+        try {
+            static_cast<void>(BigInt::fromString("12a"));
+        } catch (const LispError&) {
+            threw = true;
+        }
+        TS_ASSERT(threw);
+
+        // Shifts, two's complement bitwise operators, square roots and modular
+        // powers
+        TS_ASSERT_EQ(x << 37, x * twoTo32 * BigInt{32u});
+        TS_ASSERT_EQ((x << 37) >> 37, x);
+        TS_ASSERT_EQ(-x >> 40, -((x - BigInt{1u}) >> 40) - BigInt{1u});
+        TS_ASSERT_EQ((x & y) + (x | y), x + y);
+        TS_ASSERT_EQ(x ^ -y, (x | -y) - (x & -y));
+        TS_ASSERT_EQ(-x & -y, -((x - BigInt{1u}) | (y - BigInt{1u})) - BigInt{1u});
+        TS_ASSERT_EQ((x * x).sqrt(), x);
+        TS_ASSERT_EQ((x * x - BigInt{1u}).sqrt(), x - BigInt{1u});
+        TS_ASSERT_EQ(x.bitLength(), (x >> 1).bitLength() + 1);
+        const BigInt oddModulus = z | BigInt{1u};
+        BigInt power3{1u};
+        for (size_t i = 0; i < 100; ++i) {
+            power3 = power3 * x % oddModulus;
+        }
+        TS_ASSERT_EQ(BigInt::modPow(x, BigInt{100u}, oddModulus), power3);
+        TS_ASSERT_EQ(BigInt::modPow(-x, BigInt{101u}, oddModulus),
+                     oddModulus - power3 * x % oddModulus);
+
+        // Lehmer's GCD and the binary GCD agree with Euclid's algorithm,
+        // including on consecutive Fibonacci numbers, its worst case
+        auto euclid = [](BigInt a, BigInt b) {
+            a = a.abs();
+            b = b.abs();
+            while (b != BigInt{0}) {
+                a = std::exchange(b, a % b);
+            }
+            return a;
+        };
+        const BigInt factor = y * BigInt{12345u};
+        TS_ASSERT_EQ(BigInt::gcd(x * factor, z * factor), euclid(x * factor, z * factor));
+        TS_ASSERT_EQ(BigInt::gcd(-x * factor, y * factor), euclid(x * factor, y * factor));
+        TS_ASSERT_EQ(BigInt::gcd(x, BigInt{0}), x);
+        TS_ASSERT_EQ(BigInt::gcd(BigInt{uint64_t{12} << 40}, BigInt{uint64_t{18} << 35}),
+                     BigInt{uint64_t{6} << 35});
+        BigInt fib{1u};
+        BigInt fibNext{1u};
+        for (size_t i = 0; i < 500; ++i) {
+            fib = std::exchange(fibNext, fib + fibNext);
+        }
+        TS_ASSERT_EQ(BigInt::gcd(fibNext * factor, fib * factor), factor);
     }
 };
@@ -2,18 +2,26 @@
 #pragma once
 
 #include "core/Lexer.h"
+#include "core/Loader.h"
 #include "core/Parser.h"
 #include "core/Evaluator.h"
 
 #include "test/TestSuite.h"
 
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
 class EvalTester : public Tester<EvalTester> {
-    Datum eval(std::string_view programText) {
+    Datum evalWith(std::string_view programText, bool bytecode) {
         Lexer lex;
         Parser parser;
         Evaluator ev;
-        std::vector<Token> tokens = lex.getTokens(programText);
-        auto expr = parser.parse(tokens);
+        ev.setBytecodeEnabled(bytecode);
+        const std::vector<Token> tokens = lex.getTokens(programText);
+        size_t pos = 0;
+        auto expr = parser.parse(tokens, pos);
         if (!expr) {
             return {};
         }
@@ -23,11 +31,20 @@ class EvalTester : public Tester<EvalTester> {
             if (!evaluated) {
                 return {};
             }
-            expr = parser.parse(tokens);
+            expr = parser.parse(tokens, pos);
         }
         return *evaluated;
     }
 
+    // Evaluate with the compiler and VM, checking that the tree-walking
+    // evaluator agrees on the result
+    Datum eval(std::string_view programText) {
+        Datum compiled = evalWith(programText, true);
+        Datum interpreted = evalWith(programText, false);
+        TS_ASSERT_EQ(stringConcat(compiled), stringConcat(interpreted));
+        return compiled;
+    }
+
     Number evNum(std::string_view programText) {
         Datum val = eval(programText);
         std::optional<Number> num = val.getAtomicValue<Number>();
@@ -89,6 +106,9 @@ class EvalTester : public Tester<EvalTester> {
         TS_ASSERT_REP(eval("(cons 1 '())"), "'(1)");
         TS_ASSERT_EQ(evNum("(cdr (cons 1 2))"), 2L);
         TS_ASSERT_EQ(evNum("(car (cons 1 2))"), 1L);
+        TS_ASSERT_REP(eval("(cons 1 2)"), "'(1 . 2)");
+        TS_ASSERT_REP(eval("(cons (list 1) (cons 2 3))"), "'('(1) 2 . 3)");
+        TS_ASSERT_REP(eval("(cons 1 (vector 2 '()))"), "'(1 . #(2 '()))");
 
         TS_ASSERT_EQ(eval("(= 1 (- 2 1) (* 1 1) (+ 0.5 0.5))"), Datum{Atom{true}});
         TS_ASSERT_EQ(eval("(< 1 2 3 (+ 4 5) (* 5 5))"), Datum{Atom{true}});
@@ -107,8 +127,25 @@ class EvalTester : public Tester<EvalTester> {
         TS_ASSERT_EQ(evNum("(remainder -7 3)"), -1L);
         TS_ASSERT_EQ(evNum("(modulo -7 3)"), 2L);
         TS_ASSERT_EQ(evNum("(modulo 7 -3)"), -2L);
+        TS_ASSERT_EQ(evNum("(modulo -4 2)"), 0L);
+        TS_ASSERT_EQ(evNum("(define big (* 4294967296 4294967296 4294967296))\n"
+                           "(quotient (+ (* big 12345) 678) big)"), 12345L);
+        TS_ASSERT_EQ(evNum("(define big (* 4294967296 4294967296 4294967296))\n"
+                           "(modulo (- 678 (* big 12345)) big)"), 678L);
+        TS_ASSERT_REP(eval("(* 4294967296 4294967296 -4294967296)"),
+                      "-79228162514264337593543950336");
 
         TS_ASSERT_EQ(evNum("(/ 2)"), Rational<BigInt>(BigInt{1}, BigInt{2}));
+        // Exact literals of any size, and rationals
+        TS_ASSERT_EQ(evNum("(- 100000000000000000001 100000000000000000000)"), 1L);
+        TS_ASSERT_REP(eval("(+ -123456789012345678901234567890 0)"),
+                      "-123456789012345678901234567890");
+        TS_ASSERT_REP(eval("(- -9223372036854775808 1)"), "-9223372036854775809");
+        TS_ASSERT_EQ(evNum("(+ -2/4)"), Rational<BigInt>(BigInt{-1}, BigInt{2}));
+        TS_ASSERT_EQ(eval("(= (+ 1/3 2/3) 1)"), Datum::True());
+        TS_ASSERT_EQ(evNum("(+ 4/2)"), 2L);
+        TS_ASSERT_EQ(evNum("(+ 1.5e2 -2.5e-1)"), 149.75);
+        TS_ASSERT_EQ(eval("(exact? 2.0)"), Datum::False());
         TS_ASSERT_EQ(eval("(= (/ 2 3) (/ 4 6))"), Datum::True());
         TS_ASSERT_EQ(eval("(= (+ (/ 2 3) 1) (/ 5 3))"), Datum::True());
 
@@ -119,7 +156,249 @@ class EvalTester : public Tester<EvalTester> {
         TS_ASSERT_EQ(evNum("(abs 5.5)"), 5.5);
         TS_ASSERT_EQ(evNum("(abs -5.5)"), 5.5);
 
+        // Powers, roots and bits, on fixnums and on bignums
+        TS_ASSERT_EQ(evNum("(expt 3 4)"), 81L);
+        TS_ASSERT_EQ(evNum("(expt 7 0)"), 1L);
+        TS_ASSERT_REP(eval("(expt 2 100)"), "1267650600228229401496703205376");
+        TS_ASSERT_REP(eval("(expt -3 41)"), "-36472996377170786403");
+        TS_ASSERT_REP(eval("(expt 2/3 3)"), "8/27");
+        TS_ASSERT_REP(eval("(expt 2 -2)"), "1/4");
+        TS_ASSERT_EQ(evNum("(expt -1 -3)"), -1L);
+        TS_ASSERT_EQ(evNum("(expt 2/3 -1)"), Rational<BigInt>(BigInt{3}, BigInt{2}));
+        TS_ASSERT_EQ(evNum("(expt 4 0.5)"), 2.0);
+        TS_ASSERT_EQ(evNum("(expt 2.0 3)"), 8.0);
+        TS_ASSERT_EQ(evNum("(modular-expt 4 13 497)"), 445L);
+        TS_ASSERT_EQ(evNum("(modular-expt -4 13 497)"), 52L);
+        TS_ASSERT_EQ(evNum("(modular-expt 2 62 9223372036854775783)"), 4611686018427387904L);
+        // Fermat: a^(p - 1) = 1 mod p for the primes 2^63 - 25 and 2^127 - 1, and
+        // an even modulus, which is not reduced by Montgomery multiplication
+        TS_ASSERT_EQ(evNum("(modular-expt 5 9223372036854775782 9223372036854775783)"), 1L);
+        TS_ASSERT_EQ(evNum("(define p (- (expt 2 127) 1))\n"
+                           "(modular-expt 12345 (- p 1) p)"), 1L);
+        TS_ASSERT_EQ(eval("(define m (expt 2 100))\n"
+                           "(= (modular-expt 3 1001 m) (modulo (expt 3 1001) m))"), Datum::True());
+        TS_ASSERT_REP(eval("(exact-integer-sqrt 17)"), "'(4 1)");
+        TS_ASSERT_REP(eval("(exact-integer-sqrt 9223372036854775807)"), "'(3037000499 5928526806)");
+        TS_ASSERT_REP(eval("(exact-integer-sqrt (+ (expt 10 40) 1))"), "'(100000000000000000000 1)");
+        TS_ASSERT_EQ(evNum("(bitwise-and 12 10)"), 8L);
+        TS_ASSERT_EQ(evNum("(bitwise-or 12 10)"), 14L);
+        TS_ASSERT_EQ(evNum("(bitwise-xor 12 -10)"), -6L);
+        TS_ASSERT_EQ(eval("(= (bitwise-and (- (expt 2 100)) (+ (expt 2 101) 7)) (expt 2 101))"),
+                     Datum::True());
+        TS_ASSERT_EQ(evNum("(arithmetic-shift 1 10)"), 1024L);
+        TS_ASSERT_EQ(evNum("(arithmetic-shift -7 -1)"), -4L);
+        TS_ASSERT_EQ(eval("(= (arithmetic-shift 3 100) (* 3 (expt 2 100)))"), Datum::True());
+        TS_ASSERT_EQ(evNum("(arithmetic-shift (- (expt 2 100)) -99)"), -2L);
+
+        // Numeric vectors
+        TS_ASSERT_REP(eval("(f64vector 1 2.5 -3)"), "#f64(1 2.5 -3)");
+        TS_ASSERT_REP(eval("(make-s64vector 3 7)"), "#s64(7 7 7)");
+        TS_ASSERT_REP(eval("(list->s64vector '(1 2 3))"), "#s64(1 2 3)");
+        TS_ASSERT_REP(eval("(f64vector->list (f64vector 0.5 1.5))"), "'(0.5 1.5)");
+        TS_ASSERT_EQ(evNum("(define v (make-f64vector 4))\n"
+                           "(f64vector-set! v 2 3.5)\n"
+                           "(+ (f64vector-ref v 2) (f64vector-length v))"), 7.5);
+        TS_ASSERT_REP(eval("(vector-add (s64vector 1 2 3) (s64vector 10 20 30))"), "#s64(11 22 33)");
+        TS_ASSERT_REP(eval("(vector-scale (f64vector 1 2 3) 0.5)"), "#f64(0.5 1 1.5)");
+        TS_ASSERT_EQ(evNum("(dot (f64vector 1 2 3 4 5) (f64vector 5 4 3 2 1))"), 35.0);
+        TS_ASSERT_EQ(evNum("(sum (list->f64vector '(1 2 3 4 5 6 7)))"), 28.0);
+        TS_ASSERT_EQ(evNum("(vector-min (s64vector 4 -2 9))"), -2L);
+        TS_ASSERT_EQ(evNum("(vector-max (f64vector 4 -2 9))"), 9.0);
+        // Integer sums and dot products are exact, beyond 64 bits
+        TS_ASSERT_EQ(eval("(= (sum (s64vector 9223372036854775807 9223372036854775807))\n"
+                          "   (* 2 9223372036854775807))"), Datum::True());
+        TS_ASSERT_EQ(eval("(define big (make-s64vector 4 -9223372036854775808))\n"
+                          "(= (dot big big) (* 4 (expt 2 126)))"), Datum::True());
+        bool threw = false;
+        try {
+            eval("(vector-add (s64vector 9223372036854775807) (s64vector 1))");
+        } catch (const LispError&) {
+            threw = true;
+        }
+        TS_ASSERT(threw);
+        TS_ASSERT_REP(eval("(vector-map! (lambda (x) (* x x)) (s64vector 1 2 3))"), "#s64(1 4 9)");
+        TS_ASSERT_EQ(eval("(eq? (f64vector 1 2) (f64vector 1 2))"), Datum::False());
+        TS_ASSERT_EQ(eval("(define v (s64vector 1 2))\n(eq? v v)"), Datum::True());
+        TS_ASSERT_EQ(eval("(equal? (f64vector 1 2) (f64vector 1 2))"), Datum::True());
+        TS_ASSERT_EQ(eval("(eq? (f64vector 1 2) (s64vector 1 2))"), Datum::False());
+
+        // Vectors
+        TS_ASSERT_REP(eval("(vector 1 \"two\" '(3))"), "#(1 two '(3))");
+        TS_ASSERT_EQ(evNum("(define v (make-vector 100 0))\n"
+                           "(define (fill i) (if (< i 100) (begin (vector-set! v i (* i i)) (fill (+ i 1))) 0))\n"
+                           "(fill 0)\n"
+                           "(+ (vector-ref v 99) (vector-length v))"), 9901L);
+        TS_ASSERT_REP(eval("(define v (vector 1 2 3 4))\n"
+                           "(begin (vector-fill! v 0 1 3) v)"), "#(1 0 0 4)");
+        TS_ASSERT_REP(eval("(subvector (vector 1 2 3 4) 1 4)"), "#(2 3 4)");
+        TS_ASSERT_REP(eval("(vector->list (vector-grow (vector 1 2) 3) 0 2)"), "'(1 2)");
+        TS_ASSERT_EQ(evNum("(vector-length (vector-grow (vector 1 2) 5))"), 5L);
+        TS_ASSERT_REP(eval("(list->vector '(a b c))"), "#(a b c)");
+        TS_ASSERT_EQ(eval("(eq? (vector 1 \"a\") (vector 1 \"a\"))"), Datum::False());
+        TS_ASSERT_EQ(eval("(define v (vector 0))\n(vector-set! v 0 v)\n"
+                          "(define w (vector 0))\n(vector-set! w 0 w)\n"
+                          "(eq? v w)"), Datum::False());
+        TS_ASSERT_EQ(eval("(eq? (vector 1 2) (vector 1 2 3))"), Datum::False());
+        threw = false;
+        try {
+            eval("(vector-ref (vector 1 2) 2)");
+        } catch (const LispError&) {
+            threw = true;
+        }
+        TS_ASSERT(threw);
+        // Indices must be exact integers; only those are out of range
+        const auto indexError = [&](std::string_view program) {
+            try {
+                eval(program);
+            } catch (const LispError& err) {
+                return std::string{err.what()};
+            }
+            return std::string{};
+        };
+        TS_ASSERT_EQ(indexError("(vector-ref (vector 1 2) 1.5)"),
+                     "TypeError: expected exact integer found, 1.5");
+        TS_ASSERT_EQ(indexError("(s64vector-set! (s64vector 1 2) 1/2 0)"),
+                     "TypeError: expected exact integer found, 1/2");
+        TS_ASSERT_EQ(indexError("(subvector (vector 1 2) 0 (expt 2 70))"),
+                     "Index out of range: 1180591620717411303424");
+
+        // Equivalence and hash tables
+        TS_ASSERT_EQ(eval("(eqv? 2 2.0)"), Datum::False());
+        TS_ASSERT_EQ(eval("(eq? 2 2.0)"), Datum::False());
+        TS_ASSERT_EQ(eval("(eq? \"a\" \"a\")"), Datum::False());
+        TS_ASSERT_EQ(eval("(define s \"a\")\n(eq? s s)"), Datum::True());
+        TS_ASSERT_EQ(evNum("(case 2.0 ((2) 1) (else 0))"), 0L);
+        TS_ASSERT_EQ(evNum("(case (expt 2 70) ((1180591620717411303424) 1) (else 0))"), 1L);
+        TS_ASSERT_EQ(eval("(eqv? (expt 2 100) (expt 2 100))"), Datum::True());
+        TS_ASSERT_EQ(eval("(eqv? (list 1) (list 1))"), Datum::False());
+        TS_ASSERT_EQ(eval("(equal? (list 1 (vector 2 \"x\")) (list 1 (vector 2 \"x\")))"),
+                     Datum::True());
+        TS_ASSERT_EQ(eval("(equal? (list 1 2) (list 1 2 3))"), Datum::False());
+        // Structures nested deeply along the car, in lists and vectors
+        const std::string nest = "(define (nest n acc) (if (= n 0) acc (nest (- n 1) (list (vector acc)))))\n";
+        TS_ASSERT_EQ(eval(nest + "(equal? (nest 100000 1) (nest 100000 1))"), Datum::True());
+        TS_ASSERT_EQ(eval(nest + "(equal? (nest 100000 1) (nest 100000 2))"), Datum::False());
+        TS_ASSERT_EQ(evNum("(define t (make-equal-hash-table))\n"
+                           "(hash-table-set! t (list 1 2) 10)\n"
+                           "(hash-table-set! t (expt 2 80) 20)\n"
+                           "(hash-table-set! t 1/2 30)\n"
+                           "(+ (hash-table-ref t (list 1 2)) (hash-table-ref t (expt 2 80))\n"
+                           "   (hash-table-ref/default t (/ 2 4) 0) (hash-table-ref/default t 0.5 0))"),
+                     60L);
+        TS_ASSERT_EQ(evNum("(define t (make-strong-eqv-hash-table))\n"
+                           "(define (fill i) (if (< i 1000) (begin (hash-table-set! t i (* i i)) (fill (+ i 1))) 0))\n"
+                           "(fill 0)\n"
+                           "(define (drop i) (if (< i 1000) (begin (hash-table-delete! t i) (drop (+ i 2))) 0))\n"
+                           "(drop 0)\n"
+                           "(+ (hash-table-count t) (hash-table-ref t 999 (lambda () 0))\n"
+                           "   (hash-table-ref t 998 (lambda () 1)))"), 998502L);
+        TS_ASSERT_EQ(evNum("(define t (make-string-hash-table))\n"
+                           "(hash-table-update!/default t \"a\" (lambda (x) (+ x 1)) 0)\n"
+                           "(hash-table-update! t \"a\" (lambda (x) (* x 5)))\n"
+                           "(hash-table-update! t \"b\" (lambda (x) (+ x 1)) (lambda () 2))\n"
+                           "(hash-table-ref t \"a\" (lambda () 0) (lambda (x) (+ x (hash-table-ref t \"b\"))))"),
+                     8L);
+        TS_ASSERT_EQ(evNum("(define t (make-equal-hash-table))\n"
+                           "(hash-table-set! t (quote a) 1)\n"
+                           "(hash-table-set! t (quote b) 2)\n"
+                           "(define total (vector 0))\n"
+                           "(hash-table-walk t (lambda (k v) (vector-set! total 0 (+ v (vector-ref total 0)))))\n"
+                           "(vector-ref total 0)"), 3L);
+
+        // List primitives
+        TS_ASSERT_REP(eval("(list 'a '(b) 'c)"), "'(a '(b) c)");
+        TS_ASSERT_REP(eval("(map + '(1 2 3) '(10 20))"), "'(11 22)");
+        TS_ASSERT_REP(eval("(map (lambda (x) (* x x)) (list 1 2 3))"), "'(1 4 9)");
+        TS_ASSERT_REP(eval("(append '(1) '() (list 2 3) '(4))"), "'(1 2 3 4)");
+        TS_ASSERT_EQ(evNum("(cdr (cdr (append '(1) (list 2) 3)))"), 3L);
+        TS_ASSERT_REP(eval("(reverse '(1 2 3))"), "'(3 2 1)");
+        TS_ASSERT_REP(eval("(list-tail '(1 2 3) 2)"), "'(3)");
+        TS_ASSERT_REP(eval("(fold-left (lambda (acc x) (cons x acc)) '() '(1 2))"), "'(2 1)");
+        TS_ASSERT_REP(eval("(fold-right cons '() '(1 2))"), "'(1 2)");
+        TS_ASSERT_EQ(evNum("(fold-left (lambda (acc x y) (+ acc (* x y))) 0 '(1 2 3) '(4 5 6))"), 32L);
+        TS_ASSERT_EQ(evNum("(fold-right (lambda (x acc) (- x acc)) 0 '(1 2 3))"), 2L);
+        TS_ASSERT_EQ(evNum("(reduce - 0 '(1 2 3 4))"), 2L);
+        TS_ASSERT_EQ(evNum("(reduce + 7 '())"), 7L);
+        TS_ASSERT_EQ(evNum("(define total (vector 0))\n"
+                           "(for-each (lambda (x) (vector-set! total 0 (+ x (vector-ref total 0)))) '(1 2 3))\n"
+                           "(vector-ref total 0)"), 6L);
+        // Long lists are walked without recursing
+        TS_ASSERT_EQ(evNum("(define (build n acc) (if (= n 0) acc (build (- n 1) (cons n acc))))\n"
+                           "(define l (map (lambda (x) (* 2 x)) (build 100000 '())))\n"
+                           "(+ (length (append l l)) (car (reverse l)))"), 400000L);
+        threw = false;
+        try {
+            eval("(list-tail '(1 2) 3)");
+        } catch (const LispError&) {
+            threw = true;
+        }
+        TS_ASSERT(threw);
+
+        // Sorting, by the builtin comparisons and by procedures
+        TS_ASSERT_REP(eval("(sort (list 3 1 2 (expt 2 70) -5) <)"), "'(-5 1 2 3 1180591620717411303424)");
+        TS_ASSERT_REP(eval("(sort (vector 1.5 3 1/2) >)"), "#(3 1.5 1/2)");
+        TS_ASSERT_REP(eval("(sort (list \"pear\" \"apple\" \"fig\") string<?)"), "'(apple fig pear)");
+        // Stable: pairs with equal keys keep their order
+        TS_ASSERT_REP(eval("(map cdr (merge-sort (list (cons 2 1) (cons 1 2) (cons 2 3) (cons 1 4))\n"
+                           "                     (lambda (a b) (< (car a) (car b)))))"), "'(2 4 1 3)");
+        TS_ASSERT_REP(eval("(define v (vector 5 4 3 2 1))\n"
+                           "(begin (sort! v (lambda (a b) (< a b))) v)"), "#(1 2 3 4 5)");
+        TS_ASSERT_EQ(evNum("(define l (list 3 1 2))\n"
+                           "(define s (sort! l <))\n"
+                           "(+ (car s) (length l))"), 2L);
+        // A procedure that is not an ordering still gives a permutation
+        const std::string inconsistent = "(define calls (vector 0))\n"
+                                         "(define (flip a b)\n"
+                                         "  (vector-set! calls 0 (+ (vector-ref calls 0) 1))\n"
+                                         "  (= (remainder (vector-ref calls 0) 2) 1))\n"
+                                         "(define l (list 9 3 14 1 12 5 7 20 2 11 8 16 4 19 6 13 10 18 15 17))\n";
+        TS_ASSERT_EQ(evNum(inconsistent + "(define s (sort l flip))\n"
+                                          "(+ (length s) (fold-left + 0 s))"), 230L);
+        TS_ASSERT_EQ(evNum(inconsistent + "(define s (sort (list->vector l) flip))\n"
+                                          "(fold-left + (vector-length s) (vector->list s))"), 230L);
+        threw = false;
+        try {
+            eval("(sort (list 1 \"a\") <)");
+        } catch (const LispError&) {
+            threw = true;
+        }
+        TS_ASSERT(threw);
+
+        // Loading files, and source text, a form at a time
+        const std::string path = "/tmp/lispi-load-" + std::to_string(getpid()) + ".scm";
+        std::ofstream{path} << "(define (square x) (* x x))\n"
+                               "square\n"
+                               "(define y '(1 2))\n"
+                               "(square 7)\n";
+        TS_ASSERT_EQ(evNum("(load \"" + path + "\")"), 49L);
+        TS_ASSERT_EQ(evNum("(load \"" + path + "\")\n"
+                           "(+ (square 3) (car y))"), 10L);
+        std::remove(path.c_str());
+        threw = false;
+        try {
+            eval("(load \"" + path + "\")");
+        } catch (const LispError&) {
+            threw = true;
+        }
+        TS_ASSERT(threw);
+        {
+            // Forms before an incomplete one have already been evaluated
+            Evaluator ev;
+            threw = false;
+            try {
+                Loader::loadText("(define x 5)\n(car", ev.getGlobalScope(), ev);
+            } catch (const LispError&) {
+                threw = true;
+            }
+            TS_ASSERT(threw);
+            TS_ASSERT_EQ(Loader::loadText("(+ x 1)", ev.getGlobalScope(), ev), Datum{Atom{Number{6L}}});
+            // Atoms at top level are forms too
+            TS_ASSERT_EQ(Loader::loadText("(define z 5)\nz", ev.getGlobalScope(), ev),
+                         Datum{Atom{Number{5L}}});
+        }
+
         TS_ASSERT_EQ(evNum(R"#((string-length "123"))#"), 3L);
+        TS_ASSERT_EQ(evNum(R"#((string-length "a\"b\\c\n"))#"), 6L);
         TS_ASSERT_EQ(eval(R"#((string=? "abcde" "efghi"))#"), Datum::False());
         TS_ASSERT_EQ(eval(R"#((string-ci=? "aBcDe" "AbCdE"))#"), Datum::True());
 
@@ -127,9 +406,151 @@ class EvalTester : public Tester<EvalTester> {
         TS_ASSERT_EQ(evNum("(case (- 5 3) ((0 1 2) 0) (else 5))"), 0L);
         TS_ASSERT_EQ(evNum("(case (* 7 5) ((0 1) 0) ((2 3) 1) (else 2))"), 2L);
 
+        TS_ASSERT_EQ(evNum("(define (f x) (car (cdr x)))\n"
+                           "(f '(1 2 3))"), 2L);
+        TS_ASSERT_EQ(evNum("(define x (+ 2 3))\n"
+                           "(define (f y) (* x y))\n"
+                           "(f 4)"), 20L);
+        TS_ASSERT_EQ(evNum("(define (adder n) (lambda (x) (+ x n)))\n"
+                           "((adder 3) 4)"), 7L);
+        TS_ASSERT_EQ(evNum("(define (compose f g) (lambda (x) (f (g x))))\n"
+                           "((compose (lambda (x) (* x 2)) (lambda (x) (+ x 1))) 5)"), 12L);
+        TS_ASSERT_EQ(evNum("(define (apply2 f x y) (f x y))\n"
+                           "(apply2 + 3 4)"), 7L);
+        TS_ASSERT_EQ(evNum("(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))\n"
+                           "(fib 15)"), 610L);
+        TS_ASSERT_EQ(evNum("(define (f n) (cond ((= n 0) 10) ((= n 1) 11) (else 12)))\n"
+                           "(+ (f 0) (f 1) (f 2))"), 33L);
+        TS_ASSERT_EQ(evNum("(define (f n) (case n ((0 1) 1) ((2) (+ n 1)) (else (* n 2))))\n"
+                           "(+ (f 0) (f 2) (f 5))"), 14L);
+        TS_ASSERT_EQ(evNum("(define (f x) (begin (+ x 1) (and x (or #f (* x 3)))))\n"
+                           "(f 2)"), 6L);
+        TS_ASSERT_REP(eval("(define (f) (quote sym))\n(f)"), "sym");
+        TS_ASSERT_REP(eval("(define (f a b) (cons a b))\n(f 1 (list 2 3))"), "'(1 2 3)");
+        TS_ASSERT_EQ(eval("(>= 3 3 2)"), Datum::True());
+        TS_ASSERT_EQ(eval("(< 1 3 2)"), Datum::False());
+        TS_ASSERT_EQ(eval("(eq? (quote abc) (car (list (quote abc))))"), Datum::True());
+        TS_ASSERT_EQ(eval("(eq? (quote abc) (quote abd))"), Datum::False());
+        TS_ASSERT_EQ(evNum("(case (car (quote (b))) ((a) 1) ((b c) 2) (else 3))"), 2L);
+        TS_ASSERT(Symbol{"car"} == Symbol{std::string{"car"}});
+        TS_ASSERT(&+Symbol{"car"} == &+Symbol{"car"});
+        TS_ASSERT(Symbol{"car"} != Symbol{"cdr"});
+
+        // Lexical addressing
+        TS_ASSERT_EQ(evNum("(define (f a) (lambda (b) (lambda (c) (+ a b c))))\n"
+                           "(((f 1) 2) 3)"), 6L);
+        TS_ASSERT_EQ(evNum("(define x 10)\n"
+                           "(define (f x) (lambda () x))\n"
+                           "((f 3))"), 3L);
+        TS_ASSERT_EQ(evNum("(define (f x) (g x))\n"
+                           "(define (g x) (* x 2))\n"
+                           "(f 4)"), 8L);
+        TS_ASSERT_EQ(evNum("(define (g) 1)\n"
+                           "(define (f) (g))\n"
+                           "(f)\n"
+                           "(define (g) 2)\n"
+                           "(f)"), 2L);
+        TS_ASSERT_EQ(evNum("(define x 1)\n"
+                           "(define (f) x)\n"
+                           "(f)\n"
+                           "(define x 2)\n"
+                           "(f)"), 2L);
+        TS_ASSERT_EQ(evNum("(define (f) 1)\n"
+                           "(define g f)\n"
+                           "(define f 5)\n"
+                           "(+ (g) f)"), 6L);
+        TS_ASSERT_EQ(evNum("(define (f x) (define y (* x 2)) (+ x y))\n"
+                           "(f 3)"), 9L);
+        TS_ASSERT_EQ(evNum("(define (f x) (define y (+ x 1)) (lambda () y))\n"
+                           "((f 1))"), 2L);
+        TS_ASSERT_EQ(evNum("(define (sum n)\n"
+                           "  (define (loop i acc) (if (= i 0) acc (loop (- i 1) (+ acc i))))\n"
+                           "  (loop n 0))\n"
+                           "(sum 100)"), 5050L);
+
         // Without tail call elimination, this would almost certainly smash the stack and
         // fail
         TS_ASSERT_EQ(evNum("(define (count acc) (if (= acc 1000000) acc (count (+ acc 1))))\n"
                            "(count 0)"), 1000000L);
+        // Mutual recursion through tail calls in the VM
+        TS_ASSERT_EQ(eval("(define (ev? n) (if (= n 0) #t (od? (- n 1))))\n"
+                          "(define (od? n) (if (= n 0) #f (ev? (- n 1))))\n"
+                          "(ev? 10001)"), Datum::False());
+
+        // Integers at the edges of the fixnum range, and beyond it (boxed)
+        TS_ASSERT_EQ(evNum("(- 140737488355327 140737488355326)"), 1L);
+        TS_ASSERT_EQ(eval("(eq? -140737488355328 (- 0 140737488355328))"), Datum::True());
+        TS_ASSERT_EQ(eval("(eq? 281474976710656 281474976710656)"), Datum::True());
+        TS_ASSERT_EQ(eval("(eq? 1.5 (/ 3.0 2))"), Datum::True());
+        TS_ASSERT_EQ(eval("(< -5 -3)"), Datum::True());
+        TS_ASSERT_EQ(evNum("(define big (* 4294967296 4294967296))\n"
+                           "(- (+ big 7) big)"), 7L);
+        TS_ASSERT_REP(eval(R"#((car (list "str" 1)))#"), "str");
+
+        // Garbage collection: closures and their environments form cycles,
+        // which must all be freed once the evaluators are gone
+        Heap::get().collect();
+        const size_t heapSize = Heap::get().size();
+        TS_ASSERT_EQ(evNum("(define (make n) (define (self) n) self)\n"
+                           "(define (loop i) (if (= i 0) 0 (begin (make i) (loop (- i 1)))))\n"
+                           "(loop 1000)"), 0L);
+        Heap::get().collect();
+        TS_ASSERT_EQ(Heap::get().size(), heapSize);
+        TS_ASSERT_EQ(evNum("(define v (make-vector 2 0))\n"
+                           "(vector-set! v 0 v)\n"
+                           "(vector-length v)"), 2L);
+        Heap::get().collect();
+        TS_ASSERT_EQ(Heap::get().size(), heapSize);
+        // Pairs that survive minor collections are promoted; young pairs stored
+        // into a promoted one must survive later minor collections
+        const size_t minorCollections = Heap::get().stats().minorCollections;
+        TS_ASSERT_EQ(evNum("(define keep (list 1 2))\n"
+                           "(define (churn i) (if (= i 0) 0 (begin (list i i i) (churn (- i 1)))))\n"
+                           "(churn 5000)\n"
+                           "(set-cdr! keep (list 3 4))\n"
+                           "(churn 5000)\n"
+                           "(set-car! (cdr keep) 5)\n"
+                           "(+ (car (cdr keep)) (car (cdr (cdr keep))))"), 9L);
+        TS_ASSERT(Heap::get().stats().minorCollections > minorCollections);
+        // Dropping a long list must not recurse once per pair
+        TS_ASSERT_EQ(evNum("(define (build n acc) (if (= n 0) acc (build (- n 1) (cons n acc))))\n"
+                           "(car (build 50000 '()))"), 1L);
+
+        // Nesting is only limited by memory, in the parser and the printer
+        const size_t depth = 100000;
+        const std::string nested = std::string(depth, '(') + "x" + std::string(depth, ')');
+        const std::vector<Token> nestedTokens = Lexer{}.getTokens(nested);
+        size_t pos = 0;
+        std::optional<SExprPtr> deep = Parser{}.parse(nestedTokens, pos);
+        TS_ASSERT(deep && pos == nestedTokens.size());
+        std::string expected;
+        for (size_t i = 0; i < depth; ++i) {
+            expected += "'(";
+        }
+        expected += "x" + std::string(depth, ')');
+        TS_ASSERT_EQ(stringConcat(**deep), expected);
+        const std::string quotes = std::string(depth, '\'') + "x";
+        const std::vector<Token> quoteTokens = Lexer{}.getTokens(quotes);
+        pos = 0;
+        deep = Parser{}.parse(quoteTokens, pos);
+        TS_ASSERT(deep && pos == quoteTokens.size());
+        expected.clear();
+        for (size_t i = 0; i < depth; ++i) {
+            expected += "'(quote ";
+        }
+        expected += "x" + std::string(depth, ')');
+        TS_ASSERT_EQ(stringConcat(**deep), expected);
+        TS_ASSERT_EQ((*deep)->size(), 2UL);
+        deep = std::nullopt;
+        expected = std::string(depth * 2, '#');
+        for (size_t i = 0; i < depth; ++i) {
+            expected[2 * i + 1] = '(';
+        }
+        expected += "x" + std::string(depth, ')');
+        TS_ASSERT_REP(eval("(define (nest n acc) (if (= n 0) acc (nest (- n 1) (vector acc))))\n"
+                           "(nest 100000 'x)"), expected);
+        TS_ASSERT_REP(eval("(define v (vector 1 (list 2 0)))\n"
+                           "(set-car! (cdr (vector-ref v 1)) v)\n"
+                           "(begin v)"), "#(1 '(2 #[circular]))");
     }
 };
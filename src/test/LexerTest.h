@@ -3,8 +3,9 @@
 #include "test/TestSuite.h"
 #include "core/Lexer.h"
 
-#include <vector>
+#include <string>
 #include <string_view>
+#include <vector>
 class LexerTester : public Tester<LexerTester> {
     void runLexTest(std::string_view programText,
                     std::vector<Token> expectedTokens) {
@@ -58,9 +59,42 @@ class LexerTester : public Tester<LexerTester> {
                                {TokenType::Number, "-1"},
                                {TokenType::Paren, ")"}});
 
+        runLexTest("(1/3 -2.5e-3 .5 123456789012345678901234567890 1/ e5 1e +)",
+                   {{TokenType::Paren, "("},
+                    {TokenType::Number, "1/3"},
+                    {TokenType::Number, "-2.5e-3"},
+                    {TokenType::Number, ".5"},
+                    {TokenType::Number, "123456789012345678901234567890"},
+                    {TokenType::Symbol, "1/"},
+                    {TokenType::Symbol, "e5"},
+                    {TokenType::Symbol, "1e"},
+                    {TokenType::Symbol, "+"},
+                    {TokenType::Paren, ")"}});
+
         runLexTest("(string-length \"123\")", {{TokenType::Paren, "("},
                                                {TokenType::Symbol, "string-length"},
                                                {TokenType::String, "123"},
                                                {TokenType::Paren, ")"}});
+        runLexTest("(\"a\\\"b\\\\\" \"c)",
+                   {{TokenType::Paren, "("},
+                    {TokenType::String, "a\\\"b\\\\"},
+                    {TokenType::Error, "\"c)"}});
+
+        // The blocked scanners agree with the scalar one, on runs of each kind
+        // of character that end at every position within a block
+        std::string text;
+        for (size_t i = 0; i < 80; ++i) {
+            text += "(" + std::string(i, 'x') + std::string(i % 37, ' ') + "\"" +
+                    std::string(i, 'y') + "\\\"z\" " + std::to_string(i) + ")\n";
+        }
+        const Lexer::Scanner defaultScanner = Lexer::activeScanner();
+        TS_ASSERT(Lexer::setScanner(Lexer::Scanner::Scalar));
+        const std::vector<Token> expectedTokens = Lexer{}.getTokens(text);
+        for (Lexer::Scanner kind : {Lexer::Scanner::Sse2, Lexer::Scanner::Avx2}) {
+            if (Lexer::setScanner(kind)) {
+                TS_ASSERT(Lexer{}.getTokens(text) == expectedTokens);
+            }
+        }
+        TS_ASSERT(Lexer::setScanner(defaultScanner));
     }
 };
@@ -15,6 +15,26 @@ struct NumberTester : Tester<NumberTester> {
         TS_ASSERT_NEQ(Number{0.9}, Number{1.1});
         TS_ASSERT_EQ(N(5) - N(3), N(2));
         TS_ASSERT_EQ(N(-5) * N(20), N(-100));
+
+        // Overflow of the int64_t fast path promotes to BigInt, and BigInt
+        // results that fit are demoted again
+        constexpr long maxLong = std::numeric_limits<long>::max();
+        constexpr long minLong = std::numeric_limits<long>::min();
+        TS_ASSERT((Number{maxLong} + N(1)).is<BigInt>());
+        TS_ASSERT_EQ(Number{maxLong} + N(1), Number{BigInt{uint64_t{1} << 63}});
+        TS_ASSERT_EQ(Number{maxLong} + N(1) - N(1), Number{maxLong});
+        TS_ASSERT((Number{maxLong} + N(1) - N(1)).is<long>());
+        TS_ASSERT_EQ(-Number{minLong}, Number{maxLong} + N(1));
+        TS_ASSERT_EQ((Number{minLong} - N(1)) + N(1), Number{minLong});
+        TS_ASSERT_EQ(Number{4294967296L} * Number{4294967296L} - Number{maxLong},
+                     Number{maxLong} + N(2));
+        TS_ASSERT((Number{4294967296L} * Number{4294967296L}).is<BigInt>());
+        TS_ASSERT_EQ(Number{minLong}.abs(), Number{maxLong} + N(1));
+        TS_ASSERT_EQ(N(-7).quotient(N(2)), N(-3));
+        TS_ASSERT_EQ(N(-7) % N(2), N(-1));
+        TS_ASSERT_EQ(Number{minLong}.quotient(N(-1)), Number{maxLong} + N(1));
+        TS_ASSERT(N(-5) < N(-3));
+        TS_ASSERT(N(3) > Number{2.5});
     }
 #undef N
 };
@@ -1,5 +1,6 @@
 // (c) Sam Donow 2018
 #include "test/TestSuite.h"
+#include "data/BigInt.h"
 #include "data/Rational.h"
 #pragma once
 
@@ -18,6 +19,29 @@ struct RationalTester : Tester<RationalTester> {
         TS_ASSERT_EQ(R(1, 4) / R(1, 3), R(3, 4));
         TS_ASSERT_REP(R(23, 46), "1/2");
         TS_ASSERT_REP(R(-7, 4), "-7/4");
+        TS_ASSERT_EQ(R(1, 6) + R(1, 10), R(4, 15));
+        TS_ASSERT_EQ(R(3, 4) - R(3, 4), R(0));
+        TS_ASSERT_EQ(R(4, 9) * R(3, 8), R(1, 6));
+        TS_ASSERT(R(-1, 2) < R(1, 3) && R(1, 3) < R(1, 2) && R(-1, 2) < R(-1, 3));
+
+        // Harmonic numbers agree whether reduced eagerly or lazily
+        using BR = Rational<BigInt>;
+        auto harmonic = [](size_t n) {
+            BR sum{};
+            for (size_t k = 1; k <= n; ++k) {
+                sum += BR{BigInt{1u}, BigInt{static_cast<uint32_t>(k)}};
+            }
+            return sum;
+        };
+        const BR eager = harmonic(200);
+        BR::setLazyLimit(16);
+        const BR lazy = harmonic(200);
+        TS_ASSERT_REP(harmonic(3), "11/6");
+        TS_ASSERT_REP(BR(BigInt{1}, BigInt{2}) + BR(BigInt{1}, BigInt{2}), "1/1");
+        BR::setLazyLimit(0);
+        TS_ASSERT(lazy == eager);
+        TS_ASSERT(lazy.numerator() == eager.numerator() &&
+                  lazy.denominator() == eager.denominator());
     }
 };
 
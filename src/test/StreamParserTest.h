@@ -0,0 +1,100 @@
+// (c) Sam Donow 2018
+#pragma once
+#include "test/TestSuite.h"
+#include "core/StreamParser.h"
+
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+class StreamParserTester : public Tester<StreamParserTester> {
+    // The forms read from text fed in pieces of the given size, printed one
+    // per line
+    static std::string parseInPieces(std::string_view text, size_t pieceSize) {
+        StreamParser parser;
+        std::stringstream forms;
+        for (size_t i = 0; i < text.size(); i += pieceSize) {
+            parser.feed(text.substr(i, pieceSize));
+            while (auto expr = parser.next()) {
+                forms << *expr << "\n";
+            }
+        }
+        parser.finish();
+        while (auto expr = parser.next()) {
+            forms << *expr << "\n";
+        }
+        return forms.str();
+    }
+
+  public:
+    void run() {
+        initialize();
+        const std::string_view program = "(define (f x)\n  (string-append \"a b\" x))\n"
+                                         "atom '(1 ''two) (f 123456789012345678901234567890)";
+        const std::string whole = parseInPieces(program, program.size());
+        TS_ASSERT_EQ(whole, "'(define '(f x) '(string-append a b x))\n"
+                            "atom\n"
+                            "'(quote '(1 '(quote '(quote two))))\n"
+                            "'(f 123456789012345678901234567890)\n");
+        // Tokens and forms split across pieces read the same
+        for (size_t pieceSize : {1, 2, 3, 7}) {
+            TS_ASSERT_EQ(parseInPieces(program, pieceSize), whole);
+        }
+
+        // Every datum at top level is a form
+        TS_ASSERT_EQ(parseInPieces("12345 v \"str\" 'x ()", 2), "12345\nv\nstr\n'(quote x)\n'()\n");
+
+        // A string spanning many pieces, fed a line at a time, with escapes
+        // split across pieces. Each piece is only scanned for the end of the
+        // string, so this takes time linear in its length
+        std::string body;
+        for (size_t i = 0; i < 20000; ++i) {
+            body += "line " + std::to_string(i) + " \\\"quoted\\\"\n";
+        }
+        StreamParser lines;
+        lines.feed("(f \"");
+        for (size_t start = 0, end; (end = body.find('\n', start)) != std::string::npos;
+             start = end + 1) {
+            lines.feed(std::string_view{body}.substr(start, end + 1 - start));
+        }
+        lines.feed("\\");
+        TS_ASSERT(!lines.next());
+        lines.feed("\"\" sym");
+        lines.feed("bol)");
+        std::optional<Datum> form = lines.next();
+        TS_ASSERT(form.has_value());
+        std::string expectedBody;
+        for (size_t i = 0; i < 20000; ++i) {
+            expectedBody += "line " + std::to_string(i) + " \"quoted\"\n";
+        }
+        const SExpr* args = form->getSExpr()->cdr.getSExpr();
+        TS_ASSERT(args->car.getAtom().get<std::string>() == expectedBody + "\"");
+        TS_ASSERT_EQ(stringConcat(args->cdr.getSExpr()->car), "symbol");
+
+        StreamParser parser;
+        parser.feed("(+ 1");
+        TS_ASSERT(parser.inForm());
+        TS_ASSERT(!parser.next());
+        parser.feed(" 2)");
+        TS_ASSERT(!parser.inForm());
+        TS_ASSERT(parser.next().has_value());
+
+        bool threw = false;
+        try {
+            parser.feed("(car \"abc");
+            parser.finish();
+        } catch (const LispError&) {
+            threw = true;
+        }
+        TS_ASSERT(threw);
+        TS_ASSERT(!parser.inForm());
+        threw = false;
+        try {
+            parser.feed("1)");
+        } catch (const LispError&) {
+            threw = true;
+        }
+        TS_ASSERT(threw);
+    }
+};
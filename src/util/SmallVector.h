@@ -125,8 +125,8 @@ class SmallVector {
     }
 
     void moveUp(size_t pos, size_t count) {
-        for (size_t i = size() - 1; i >= pos + count; --i) {
-            bufStart[i] = std::move(bufStart[i - count]);
+        for (size_t i = size(); i > pos + count; --i) {
+            bufStart[i - 1] = std::move(bufStart[i - 1 - count]);
         }
     }
 
@@ -0,0 +1,46 @@
+// (c) Sam Donow 2018
+#pragma once
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+/// A non-owning view of a contiguous sequence, in the spirit of the proposed
+/// std::span; it is only as valid as the storage it points into
+template<typename T>
+class Span {
+    T* first = nullptr;
+    size_t count = 0;
+
+  public:
+    Span() = default;
+    Span(T* f, size_t c) : first(f), count(c) {}
+
+    template<typename U>
+    Span(std::vector<U>& vec) : first(vec.data()), count(vec.size()) {}
+
+    template<typename U>
+    Span(const std::vector<U>& vec) : first(vec.data()), count(vec.size()) {}
+
+    T& operator[](size_t pos) const noexcept { return first[pos]; }
+
+    T& at(size_t pos) const {
+        if (pos < count) {
+            return first[pos];
+        } else {
+            throw std::out_of_range("Out of range");
+        }
+    }
+
+    T* begin() const noexcept { return first; }
+    T* end() const noexcept { return first + count; }
+
+    T& front() const noexcept { return *first; }
+    T& back() const noexcept { return first[count - 1]; }
+
+    size_t size() const noexcept { return count; }
+    bool empty() const noexcept { return count == 0; }
+
+    Span subspan(size_t offset) const noexcept {
+        return {first + offset, count - offset};
+    }
+};
@@ -1,5 +1,6 @@
 // (c) Sam Donow 2017
 #pragma once
+#include <cstdint>
 #include <limits>
 #include <string>
 #include <sstream>
@@ -98,6 +99,21 @@ IntegralT binSearch(SearchFunction search) {
     return low;
 }
 
+// Scramble the bits of a 64-bit value (the finalizer of MurmurHash3), so that
+// every bit of the input affects every bit of the result
+constexpr uint64_t hashMix(uint64_t x) noexcept {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccd;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53;
+    return x ^ (x >> 33);
+}
+
+// Fold a value into the hash of a sequence
+constexpr uint64_t hashCombine(uint64_t seed, uint64_t value) noexcept {
+    return hashMix(seed ^ (value + 0x9e3779b97f4a7c15 + (seed << 6) + (seed >> 2)));
+}
+
 // Utilities for interacting with an index sequence in a lisp car/cdr
 // type way
 template<size_t I, size_t...>